@@ -42,6 +42,13 @@ public:
     virtual bool discover( const std::string& entryPoint ) = 0;
     virtual bool reload() = 0;
     virtual bool reload( const std::string& entryPoint ) = 0;
+    // Checks a single known folder for modifications, without browsing the
+    // folders it already contains.
+    virtual bool refresh( const std::string& folder ) = 0;
+    // Requests the ongoing operation to stop at the next folder boundary. The
+    // flag stays set until it gets explicitly cleared.
+    virtual void setInterrupted( bool interrupted ) = 0;
+    virtual bool isMrlSupported( const std::string& mrl ) const = 0;
 };
 
 }
@@ -45,6 +45,9 @@ namespace fs
         /// Returns a list of absolute path to this folder subdirectories
         virtual const std::vector<std::shared_ptr<IDirectory>>& dirs() const = 0;
         virtual std::shared_ptr<IDevice> device() const = 0;
+        /// Returns the directory modification date, which changes when an
+        /// entry is added, removed or renamed. 0 when it can't be known.
+        virtual unsigned int lastModificationDate() const = 0;
     };
 }
 
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace medialibrary
@@ -40,6 +41,9 @@ namespace fs
         virtual const std::string& extension() const = 0;
         virtual unsigned int lastModificationDate() const = 0;
         virtual unsigned int size() const = 0;
+        /// Returns a number identifying the file on its device, which is
+        /// preserved when the file is moved or renamed, or 0 if unknown
+        virtual uint64_t inode() const = 0;
     };
 }
 
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -65,5 +66,22 @@ public:
      * - A 'removable' state, being true if the device can be removed, false otherwise.
      */
     virtual std::vector<std::tuple<std::string, std::string, bool>> devices() const = 0;
+    /**
+     * @brief start Starts monitoring the devices, and reports their changes
+     * through the provided callback, from a lister owned thread.
+     * While monitoring, devices() can return the last known devices instead
+     * of listing them again.
+     * @return false if the lister can't monitor the devices.
+     */
+    virtual bool start( IDeviceListerCb* cb )
+    {
+        (void)cb;
+        return false;
+    }
+    /**
+     * @brief stop Stops monitoring the devices. No callback will be invoked
+     * once this returns.
+     */
+    virtual void stop() {}
 };
 }
@@ -39,6 +39,23 @@ class ILabel
         virtual int64_t id() const = 0;
         virtual const std::string& name() const = 0;
         virtual std::vector<MediaPtr> files() = 0;
+        /**
+         * @brief addMedia Links this label to all the provided media at once
+         *
+         * This is done in a single transaction, and each media search index
+         * is only updated once, which makes it suitable for bulk labelling.
+         * Media that already have this label are left untouched.
+         * Nothing is linked if any of the media is null or wasn't inserted in
+         * database.
+         */
+        virtual bool addMedia( const std::vector<MediaPtr>& media ) = 0;
+        /**
+         * @brief removeMedia Unlinks this label from all the provided media
+         *
+         * Nothing is unlinked if any of the media is null or wasn't inserted
+         * in database.
+         */
+        virtual bool removeMedia( const std::vector<MediaPtr>& media ) = 0;
 };
 
 }
@@ -52,6 +52,23 @@ struct SearchAggregate
     std::vector<PlaylistPtr> playlists;
 };
 
+struct MediaSearchCount
+{
+    uint32_t episodes;
+    uint32_t movies;
+    uint32_t others;
+    uint32_t tracks;
+};
+
+struct SearchCount
+{
+    uint32_t albums;
+    uint32_t artists;
+    uint32_t genres;
+    MediaSearchCount media;
+    uint32_t playlists;
+};
+
 enum class SortingCriteria
 {
     /*
@@ -85,6 +102,22 @@ enum class InitializeResult
     DbReset,
 };
 
+enum class ParsingPriority
+{
+    //< The default priority, tasks are processed in the discovery order
+    Background,
+    //< The media is currently displayed, for instance because the user
+    // browses its folder
+    Visible,
+    //< The user is waiting for this media, for instance to play it
+    Interactive,
+};
+
+/**
+ * The discovery related callbacks (discovery, reload & entry point
+ * notifications) may be invoked from different threads, but never
+ * concurrently.
+ */
 class IMediaLibraryCb
 {
 public:
@@ -305,6 +338,29 @@ class IMediaLibrary
         virtual std::vector<GenrePtr> searchGenre( const std::string& genre ) const = 0;
         virtual std::vector<ArtistPtr> searchArtists( const std::string& name ) const = 0;
         virtual SearchAggregate search( const std::string& pattern ) const = 0;
+        /**
+         * Paginated versions of the above.
+         * Each category is paged independently: @p offset matching entities
+         * are skipped, and at most @p limit are returned. A limit of 0 means
+         * no limit.
+         */
+        virtual MediaSearchAggregate searchMedia( const std::string& pattern,
+                                                  uint32_t offset, uint32_t limit ) const = 0;
+        virtual std::vector<PlaylistPtr> searchPlaylists( const std::string& name,
+                                                          uint32_t offset, uint32_t limit ) const = 0;
+        virtual std::vector<AlbumPtr> searchAlbums( const std::string& pattern,
+                                                    uint32_t offset, uint32_t limit ) const = 0;
+        virtual std::vector<GenrePtr> searchGenre( const std::string& genre,
+                                                   uint32_t offset, uint32_t limit ) const = 0;
+        virtual std::vector<ArtistPtr> searchArtists( const std::string& name,
+                                                      uint32_t offset, uint32_t limit ) const = 0;
+        virtual SearchAggregate search( const std::string& pattern,
+                                        uint32_t offset, uint32_t limit ) const = 0;
+        /**
+         * @brief searchCount Returns the total number of matches in each
+         *                    search category, without fetching the entities
+         */
+        virtual SearchCount searchCount( const std::string& pattern ) const = 0;
 
         /**
          * @brief discover Launch a discovery on the provided entry point.
@@ -315,6 +371,36 @@ class IMediaLibrary
          */
         virtual void discover( const std::string& entryPoint ) = 0;
         virtual void setDiscoverNetworkEnabled( bool enable ) = 0;
+        /**
+         * @brief setDiscoveryThreads Sets the number of threads used to browse
+         * the filesystem during discovery & reload.
+         * The database is still updated from a single thread, in the same order,
+         * regardless of this setting.
+         * Network shares are always browsed with at least 4 threads, as their
+         * listing time is dominated by the network latency.
+         * @param nbThreads The number of threads. 1 (the default) browses the
+         *                  filesystem from the discoverer thread only.
+         * \note This must be called before start()
+         */
+        virtual void setDiscoveryThreads( unsigned int nbThreads ) = 0;
+        /**
+         * @brief setMetadataExtractionThreads Sets the number of medias being
+         * parsed by VLC concurrently, each of them using its own libvlc instance.
+         * @param nbThreads The number of threads. 0 (the default) uses half the
+         *                  CPU cores, up to 4.
+         * \note This must be called before start()
+         */
+        virtual void setMetadataExtractionThreads( unsigned int nbThreads ) = 0;
+        /**
+         * @brief setFsWatcherEnabled Enables the monitoring of the discovered
+         * local folders.
+         * When enabled, modified folders are refreshed shortly after the change
+         * occurs, without requiring a call to reload(). Should the platform not
+         * support filesystem notifications, all folders are periodically reloaded.
+         * This is disabled by default.
+         * \note This must be called before start()
+         */
+        virtual void setFsWatcherEnabled( bool enabled ) = 0;
         virtual std::vector<FolderPtr> entryPoints() const = 0;
         virtual FolderPtr folder( const std::string& mrl ) const = 0;
         virtual void removeEntryPoint( const std::string& entryPoint ) = 0;
@@ -348,6 +434,35 @@ class IMediaLibrary
          * interrupted by pauseBackgroundOperations().
          */
         virtual void resumeBackgroundOperations() = 0;
+        /**
+         * @brief setBackgroundBudget Limits the resources used by the discovery
+         * and the parser threads.
+         * @param nbOperationsPerSec The number of filesystem operations (folder
+         *                           listings & entries) per second
+         * @param nbBytesPerSec The number of bytes read from the storage per second
+         * A value of 0 (the default) doesn't enforce any limit.
+         */
+        virtual void setBackgroundBudget( uint32_t nbOperationsPerSec, uint64_t nbBytesPerSec ) = 0;
+        /**
+         * @brief setPlaybackActive Informs the media library that a playback
+         * is running.
+         * While active, the background budget drops to a few operations per
+         * second, so that the discovery and the parser don't compete with the
+         * player for the disk. Unlike pauseBackgroundOperations(), this also
+         * throttles a task which is already running.
+         */
+        virtual void setPlaybackActive( bool active ) = 0;
+        /**
+         * @brief prioritizeParsing Moves the pending parser tasks of a media,
+         * or of all the medias in a folder, to another priority lane.
+         * The prioritized tasks run before any background task, and aren't
+         * throttled by the background budget. Their priority is kept for all
+         * the remaining parser steps.
+         * @param mrl A media mrl, or a folder mrl ending with a '/'
+         * @param priority The new priority. Background restores the default order.
+         * @return true if any pending task matched the mrl
+         */
+        virtual bool prioritizeParsing( const std::string& mrl, ParsingPriority priority ) = 0;
         virtual void reload() = 0;
         virtual void reload( const std::string& entryPoint ) = 0;
         /**
@@ -387,6 +502,17 @@ class IMediaLibrary
         virtual std::vector<MediaPtr> findDuplicatesByInfohash() const = 0;
         virtual bool copyMetadata( int64_t sourceId, int64_t destId ) const = 0;
         virtual bool removeOrphanTransportFiles() const = 0;
+        /**
+         * @brief searchP2PMedia Search P2P media by infohash prefix, by title, or
+         *                       by the name of the transport file they come from
+         * @param pattern The pattern to search, at least 3 characters long
+         * @param isLive 1 for live media only, 0 for non live media only, -1 for both
+         * @param parentId Only return the children of this transport file, 0 for all
+         * @param offset The number of matching media to skip
+         * @param limit The maximum number of media to return, 0 for no limit
+         */
+        virtual std::vector<MediaPtr> searchP2PMedia( const std::string& pattern, int isLive, int64_t parentId,
+                                                      uint32_t offset, uint32_t limit ) const = 0;
         ///ace
 };
 
@@ -443,13 +443,24 @@ std::shared_ptr<Album> Album::createUnknownAlbum( MediaLibraryPtr ml, const Arti
     return album;
 }
 
-std::vector<AlbumPtr> Album::search( MediaLibraryPtr ml, const std::string& pattern )
+std::vector<AlbumPtr> Album::search( MediaLibraryPtr ml, const std::string& pattern,
+                                     uint32_t offset, uint32_t limit )
 {
     static const std::string req = "SELECT * FROM " + policy::AlbumTable::Name + " WHERE id_album IN "
+            "(SELECT rowid FROM " + policy::AlbumTable::Name + "Fts WHERE " +
+            policy::AlbumTable::Name + "Fts MATCH '*' || ? || '*')"
+            "AND is_present != 0 "
+            "ORDER BY title, id_album LIMIT ? OFFSET ?";
+    return fetchAll<IAlbum>( ml, req, pattern, sqlite::Tools::limit( limit ), offset );
+}
+
+uint32_t Album::searchCount( MediaLibraryPtr ml, const std::string& pattern )
+{
+    static const std::string req = "SELECT COUNT(*) FROM " + policy::AlbumTable::Name + " WHERE id_album IN "
             "(SELECT rowid FROM " + policy::AlbumTable::Name + "Fts WHERE " +
             policy::AlbumTable::Name + "Fts MATCH '*' || ? || '*')"
             "AND is_present != 0";
-    return fetchAll<IAlbum>( ml, req, pattern );
+    return sqlite::Tools::fetchCount( ml, req, pattern );
 }
 
 std::vector<AlbumPtr> Album::fromArtist( MediaLibraryPtr ml, int64_t artistId, SortingCriteria sort, bool desc )
@@ -105,9 +105,13 @@ class Album : public IAlbum, public DatabaseHelpers<Album, policy::AlbumTable>
         ///
         /// \brief search search for an album, through its albumartist or title
         /// \param pattern A pattern representing the title, or the name of the main artist
+        /// \param offset The number of matching albums to skip
+        /// \param limit The maximum number of albums to return, 0 for no limit
         /// \return
         ///
-        static std::vector<AlbumPtr> search( MediaLibraryPtr ml, const std::string& pattern );
+        static std::vector<AlbumPtr> search( MediaLibraryPtr ml, const std::string& pattern,
+                                             uint32_t offset, uint32_t limit );
+        static uint32_t searchCount( MediaLibraryPtr ml, const std::string& pattern );
         static std::vector<AlbumPtr> fromArtist( MediaLibraryPtr ml, int64_t artistId, SortingCriteria sort, bool desc );
         static std::vector<AlbumPtr> fromGenre( MediaLibraryPtr ml, int64_t genreId, SortingCriteria sort, bool desc );
         static std::vector<AlbumPtr> listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc );
@@ -360,12 +360,22 @@ std::shared_ptr<Artist> Artist::create( MediaLibraryPtr ml, const std::string& n
     return artist;
 }
 
-std::vector<ArtistPtr> Artist::search( MediaLibraryPtr ml, const std::string& name )
+std::vector<ArtistPtr> Artist::search( MediaLibraryPtr ml, const std::string& name,
+                                       uint32_t offset, uint32_t limit )
 {
     static const std::string req = "SELECT * FROM " + policy::ArtistTable::Name + " WHERE id_artist IN "
+            "(SELECT rowid FROM " + policy::ArtistTable::Name + "Fts WHERE name MATCH '*' || ? || '*')"
+            "AND is_present != 0 "
+            "ORDER BY name, id_artist LIMIT ? OFFSET ?";
+    return fetchAll<IArtist>( ml, req, name, sqlite::Tools::limit( limit ), offset );
+}
+
+uint32_t Artist::searchCount( MediaLibraryPtr ml, const std::string& name )
+{
+    static const std::string req = "SELECT COUNT(*) FROM " + policy::ArtistTable::Name + " WHERE id_artist IN "
             "(SELECT rowid FROM " + policy::ArtistTable::Name + "Fts WHERE name MATCH '*' || ? || '*')"
             "AND is_present != 0";
-    return fetchAll<IArtist>( ml, req, name );
+    return sqlite::Tools::fetchCount( ml, req, name );
 }
 
 std::vector<ArtistPtr> Artist::listAll( MediaLibraryPtr ml, bool includeAll,
@@ -70,7 +70,9 @@ public:
     static void createTriggers( sqlite::Connection* dbConnection, uint32_t dbModelVersion );
     static bool createDefaultArtists( sqlite::Connection* dbConnection );
     static std::shared_ptr<Artist> create( MediaLibraryPtr ml, const std::string& name );
-    static std::vector<ArtistPtr> search( MediaLibraryPtr ml, const std::string& name );
+    static std::vector<ArtistPtr> search( MediaLibraryPtr ml, const std::string& name,
+                                          uint32_t offset, uint32_t limit );
+    static uint32_t searchCount( MediaLibraryPtr ml, const std::string& name );
     static std::vector<ArtistPtr> listAll( MediaLibraryPtr ml, bool includeAll,
                                            SortingCriteria sort, bool desc );
 
@@ -29,6 +29,8 @@
 #include "Media.h"
 #include "Folder.h"
 #include "Playlist.h"
+#include "utils/Directory.h"
+#include "utils/Filename.h"
 
 namespace medialibrary
 {
@@ -50,7 +52,9 @@ File::File( MediaLibraryPtr ml, sqlite::Row& row )
         >> m_folderId
         >> m_isPresent
         >> m_isRemovable
-        >> m_isExternal;
+        >> m_isExternal
+        >> m_inode
+        >> m_contentHash;
 }
 
 File::File( MediaLibraryPtr ml, int64_t mediaId, int64_t playlistId, Type type, const fs::IFile& file, int64_t folderId, bool isRemovable )
@@ -66,6 +70,9 @@ File::File( MediaLibraryPtr ml, int64_t mediaId, int64_t playlistId, Type type,
     , m_isPresent( true )
     , m_isRemovable( isRemovable )
     , m_isExternal( false )
+    , m_inode( static_cast<int64_t>( file.inode() ) )
+    // Without an inode, moves can only be detected through the content
+    , m_contentHash( m_inode == 0 ? contentHash( file ) : 0 )
 {
     assert( ( mediaId == 0 && playlistId != 0 ) || ( mediaId != 0 && playlistId == 0 ) );
 }
@@ -83,6 +90,8 @@ File::File(MediaLibraryPtr ml, int64_t mediaId, int64_t playlistId, IFile::Type
     , m_isPresent( true )
     , m_isRemovable( false )
     , m_isExternal( true )
+    , m_inode( 0 )
+    , m_contentHash( 0 )
     , m_fullPath( mrl )
 {
     assert( ( mediaId == 0 && playlistId != 0 ) || ( mediaId != 0 && playlistId == 0 ) );
@@ -124,6 +133,54 @@ void File::setMrl( const std::string& mrl )
     m_mrl = mrl;
 }
 
+bool File::move( const fs::IFile& fileFs, int64_t folderId )
+{
+    // The device doesn't change, so neither does the way the mrl is stored
+    auto mrl = m_isRemovable == true ? fileFs.name() : fileFs.mrl();
+    auto inode = static_cast<int64_t>( fileFs.inode() );
+    static const std::string req = "UPDATE " + policy::FileTable::Name + " SET "
+            "mrl = ?, folder_id = ?, inode = ? WHERE id_file = ?";
+    if ( sqlite::Tools::executeUpdate( m_ml->getConn(), req, mrl, folderId,
+                                       inode, m_id ) == false )
+        return false;
+    m_mrl = std::move( mrl );
+    m_folderId = folderId;
+    m_inode = inode;
+    m_fullPath = fileFs.mrl();
+    return true;
+}
+
+int64_t File::inode() const
+{
+    return m_inode;
+}
+
+bool File::setInode( int64_t inode )
+{
+    if ( m_inode == inode )
+        return true;
+    static const std::string req = "UPDATE " + policy::FileTable::Name + " SET "
+            "inode = ? WHERE id_file = ?";
+    if ( sqlite::Tools::executeUpdate( m_ml->getConn(), req, inode, m_id ) == false )
+        return false;
+    m_inode = inode;
+    return true;
+}
+
+int64_t File::contentHash() const
+{
+    return m_contentHash;
+}
+
+int64_t File::contentHash( const fs::IFile& fileFs )
+{
+    // Only the local files can be read
+    if ( utils::file::schemeIs( "file://", fileFs.mrl() ) == false )
+        return 0;
+    return static_cast<int64_t>( utils::fs::contentHash(
+                                     utils::file::toLocalPath( fileFs.mrl() ) ) );
+}
+
 IFile::Type File::type() const
 {
     return m_type;
@@ -191,6 +248,8 @@ void File::createTable( sqlite::Connection* dbConnection )
             "is_present BOOLEAN NOT NULL DEFAULT 1,"
             "is_removable BOOLEAN NOT NULL,"
             "is_external BOOLEAN NOT NULL,"
+            "inode INTEGER NOT NULL DEFAULT 0,"
+            "content_hash INTEGER NOT NULL DEFAULT 0,"
             "FOREIGN KEY (media_id) REFERENCES " + policy::MediaTable::Name
             + "(id_media) ON DELETE CASCADE,"
             "FOREIGN KEY (playlist_id) REFERENCES " + policy::PlaylistTable::Name
@@ -214,9 +273,12 @@ void File::createTriggers(sqlite::Connection* dbConnection)
             policy::FileTable::Name + "(media_id)";
     std::string folderIndexReq = "CREATE INDEX IF NOT EXISTS file_folder_id_index ON " +
             policy::FileTable::Name + "(folder_id)";
+    std::string sizeDateIndexReq = "CREATE INDEX IF NOT EXISTS file_size_date_index ON " +
+            policy::FileTable::Name + "(size, last_modification_date)";
     sqlite::Tools::executeRequest( dbConnection, triggerReq );
     sqlite::Tools::executeRequest( dbConnection, mediaIndexReq );
     sqlite::Tools::executeRequest( dbConnection, folderIndexReq );
+    sqlite::Tools::executeRequest( dbConnection, sizeDateIndexReq );
 }
 
 std::shared_ptr<File> File::createFromMedia( MediaLibraryPtr ml, int64_t mediaId, Type type, const fs::IFile& fileFs,
@@ -228,10 +290,12 @@ std::shared_ptr<File> File::createFromMedia( MediaLibraryPtr ml, int64_t mediaId
     assert( mediaId > 0 );
     auto self = std::make_shared<File>( ml, mediaId, 0, type, fileFs, folderId, isRemovable );
     static const std::string req = "INSERT INTO " + policy::FileTable::Name +
-            "(media_id, mrl, type, folder_id, last_modification_date, size, is_removable, is_external) VALUES(?, ?, ?, ?, ?, ?, ?, 0)";
+            "(media_id, mrl, type, folder_id, last_modification_date, size, is_removable, is_external,"
+            " inode, content_hash) VALUES(?, ?, ?, ?, ?, ?, ?, 0, ?, ?)";
 
     if ( insert( ml, self, req, mediaId, self->m_mrl, type, sqlite::ForeignKey( folderId ),
-                         self->m_lastModificationDate, self->m_size, isRemovable ) == false )
+                         self->m_lastModificationDate, self->m_size, isRemovable,
+                         self->m_inode, self->m_contentHash ) == false )
         return nullptr;
     self->m_fullPath = fileFs.mrl();
     return self;
@@ -274,10 +338,12 @@ std::shared_ptr<File> File::createFromPlaylist( MediaLibraryPtr ml, int64_t play
     const auto type = IFile::Type::Playlist;
     auto self = std::make_shared<File>( ml, 0, playlistId, type , fileFs, folderId, isRemovable );
     static const std::string req = "INSERT INTO " + policy::FileTable::Name +
-            "(playlist_id, mrl, type, folder_id, last_modification_date, size, is_removable, is_external) VALUES(?, ?, ?, ?, ?, ?, ?, 0)";
+            "(playlist_id, mrl, type, folder_id, last_modification_date, size, is_removable, is_external,"
+            " inode, content_hash) VALUES(?, ?, ?, ?, ?, ?, ?, 0, ?, ?)";
 
     if ( insert( ml, self, req, playlistId, self->m_mrl, type, sqlite::ForeignKey( folderId ),
-                 self->m_lastModificationDate, self->m_size, isRemovable ) == false )
+                 self->m_lastModificationDate, self->m_size, isRemovable,
+                 self->m_inode, self->m_contentHash ) == false )
         return nullptr;
     self->m_fullPath = fileFs.mrl();
     return self;
@@ -325,5 +391,16 @@ std::shared_ptr<File> File::fromExternalMrl( MediaLibraryPtr ml, const std::stri
     return file;
 }
 
+bool File::exists( MediaLibraryPtr ml, int64_t deviceId, unsigned int size,
+                   unsigned int lastModificationDate, int64_t inode )
+{
+    static const std::string req = "SELECT COUNT(*) FROM " + policy::FileTable::Name + " f"
+            " INNER JOIN " + policy::FolderTable::Name + " fo ON fo.id_folder = f.folder_id"
+            " WHERE f.size = ? AND f.last_modification_date = ? AND fo.device_id = ?"
+            " AND (f.inode = ? OR f.inode = 0 OR ? = 0)";
+    return sqlite::Tools::fetchCount( ml, req, size, lastModificationDate, deviceId,
+                                      inode, inode ) > 0;
+}
+
 
 }
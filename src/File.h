@@ -62,6 +62,21 @@ public:
      */
     const std::string& rawMrl() const;
     void setMrl( const std::string& mrl );
+    ///
+    /// \brief move Updates the file location after it was moved to another
+    /// folder of the same device, or renamed.
+    ///
+    bool move( const fs::IFile& fileFs, int64_t folderId );
+    ///
+    /// \brief inode Returns the file inode, or 0 if it is unknown
+    ///
+    int64_t inode() const;
+    bool setInode( int64_t inode );
+    ///
+    /// \brief contentHash Returns a hash of the file content, only computed
+    /// for the files without an inode, or 0
+    ///
+    int64_t contentHash() const;
     virtual Type type() const override;
     virtual unsigned int lastModificationDate() const override;
     virtual unsigned int size() const override;
@@ -105,6 +120,20 @@ public:
      */
     static std::shared_ptr<File> fromExternalMrl( MediaLibraryPtr ml, const std::string& mrl );
 
+    /**
+     * @brief exists Checks if a file with the provided size and modification date
+     * is known on the provided device
+     * This is used to guess if a new file could be a moved one.
+     */
+    static bool exists( MediaLibraryPtr ml, int64_t deviceId, unsigned int size,
+                        unsigned int lastModificationDate, int64_t inode );
+
+    /**
+     * @brief contentHash Hashes the beginning and the end of a file content
+     * @return The hash, or 0 if the file can't be read
+     */
+    static int64_t contentHash( const fs::IFile& fileFs );
+
 private:
     MediaLibraryPtr m_ml;
 
@@ -121,6 +150,8 @@ private:
     bool m_isPresent;
     bool m_isRemovable;
     bool m_isExternal;
+    int64_t m_inode;
+    int64_t m_contentHash;
 
     // Contains the full path as a MRL
     mutable Cache<std::string> m_fullPath;
@@ -56,7 +56,9 @@ Folder::Folder( MediaLibraryPtr ml, sqlite::Row& row )
         >> m_isBlacklisted
         >> m_deviceId
         >> dummy
-        >> m_isRemovable;
+        >> m_isRemovable
+        >> m_lastModificationDate
+        >> m_nbSubfolders;
 }
 
 Folder::Folder(MediaLibraryPtr ml, const std::string& path, int64_t parent, int64_t deviceId, bool isRemovable )
@@ -67,6 +69,8 @@ Folder::Folder(MediaLibraryPtr ml, const std::string& path, int64_t parent, int6
     , m_isBlacklisted( false )
     , m_deviceId( deviceId )
     , m_isRemovable( isRemovable )
+    , m_lastModificationDate( 0 )
+    , m_nbSubfolders( 0 )
 {
 }
 
@@ -81,6 +85,8 @@ void Folder::createTable( sqlite::Connection* connection)
             "device_id UNSIGNED INTEGER,"
             "is_present BOOLEAN NOT NULL DEFAULT 1,"
             "is_removable BOOLEAN NOT NULL,"
+            "last_modification_date UNSIGNED INTEGER NOT NULL DEFAULT 0,"
+            "nb_subfolders UNSIGNED INTEGER NOT NULL DEFAULT 0,"
             "FOREIGN KEY (parent_id) REFERENCES " + policy::FolderTable::Name +
             "(id_folder) ON DELETE CASCADE,"
             "FOREIGN KEY (device_id) REFERENCES " + policy::DeviceTable::Name +
@@ -367,6 +373,30 @@ bool Folder::isRootFolder() const
     return m_parent == 0;
 }
 
+unsigned int Folder::lastModificationDate() const
+{
+    return m_lastModificationDate;
+}
+
+uint32_t Folder::nbSubfolders() const
+{
+    return m_nbSubfolders;
+}
+
+bool Folder::setModificationInfo( unsigned int lastModificationDate, uint32_t nbSubfolders )
+{
+    if ( m_lastModificationDate == lastModificationDate && m_nbSubfolders == nbSubfolders )
+        return true;
+    static const std::string req = "UPDATE " + policy::FolderTable::Name + " SET "
+            "last_modification_date = ?, nb_subfolders = ? WHERE id_folder = ?";
+    if ( sqlite::Tools::executeUpdate( m_ml->getConn(), req, lastModificationDate,
+                                       nbSubfolders, m_id ) == false )
+        return false;
+    m_lastModificationDate = lastModificationDate;
+    m_nbSubfolders = nbSubfolders;
+    return true;
+}
+
 std::vector<std::shared_ptr<Folder>> Folder::fetchRootFolders( MediaLibraryPtr ml )
 {
     static const std::string req = "SELECT * FROM " + policy::FolderTable::Name +
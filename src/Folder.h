@@ -81,6 +81,17 @@ public:
     virtual bool isPresent() const override;
     virtual bool isBanned() const override;
     bool isRootFolder() const;
+    ///
+    /// \brief lastModificationDate Returns the folder modification date, as
+    /// observed the last time its content was listed, or 0 if unknown.
+    ///
+    unsigned int lastModificationDate() const;
+    ///
+    /// \brief nbSubfolders Returns the number of subfolders found on the
+    /// filesystem the last time this folder content was listed.
+    ///
+    uint32_t nbSubfolders() const;
+    bool setModificationInfo( unsigned int lastModificationDate, uint32_t nbSubfolders );
 
     enum class BannedType
     {
@@ -102,6 +113,8 @@ private:
     bool m_isBlacklisted;
     int64_t m_deviceId;
     bool m_isRemovable;
+    unsigned int m_lastModificationDate;
+    uint32_t m_nbSubfolders;
 
     mutable Cache<std::string> m_deviceMountpoint;
     mutable Cache<std::shared_ptr<Device>> m_device;
@@ -170,11 +170,20 @@ std::shared_ptr<Genre> Genre::fromName( MediaLibraryPtr ml, const std::string& n
     return fetch( ml, req, name );
 }
 
-std::vector<GenrePtr> Genre::search( MediaLibraryPtr ml, const std::string& name )
+std::vector<GenrePtr> Genre::search( MediaLibraryPtr ml, const std::string& name,
+                                     uint32_t offset, uint32_t limit )
 {
     static const std::string req = "SELECT * FROM " + policy::GenreTable::Name + " WHERE id_genre IN "
-            "(SELECT rowid FROM " + policy::GenreTable::Name + "Fts WHERE name MATCH '*' || ? || '*')";
-    return fetchAll<IGenre>( ml, req, name );
+            "(SELECT rowid FROM " + policy::GenreTable::Name + "Fts WHERE name MATCH '*' || ? || '*') "
+            "ORDER BY name, id_genre LIMIT ? OFFSET ?";
+    return fetchAll<IGenre>( ml, req, name, sqlite::Tools::limit( limit ), offset );
+}
+
+uint32_t Genre::searchCount( MediaLibraryPtr ml, const std::string& name )
+{
+    static const std::string req = "SELECT COUNT(*) FROM " + policy::GenreTable::Name + "Fts "
+            "WHERE name MATCH '*' || ? || '*'";
+    return sqlite::Tools::fetchCount( ml, req, name );
 }
 
 std::vector<GenrePtr> Genre::listAll( MediaLibraryPtr ml, SortingCriteria, bool desc )
@@ -58,7 +58,9 @@ public:
     static void createTriggers( sqlite::Connection* dbConn );
     static std::shared_ptr<Genre> create( MediaLibraryPtr ml, const std::string& name );
     static std::shared_ptr<Genre> fromName( MediaLibraryPtr ml, const std::string& name );
-    static std::vector<GenrePtr> search( MediaLibraryPtr ml, const std::string& name );
+    static std::vector<GenrePtr> search( MediaLibraryPtr ml, const std::string& name,
+                                         uint32_t offset, uint32_t limit );
+    static uint32_t searchCount( MediaLibraryPtr ml, const std::string& name );
     static std::vector<GenrePtr> listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc );
 
 private:
@@ -31,6 +31,7 @@
 #include "Label.h"
 #include "Media.h"
 #include "database/SqliteTools.h"
+#include "logging/Logger.h"
 
 namespace medialibrary
 {
@@ -39,6 +40,21 @@ const std::string policy::LabelTable::Name = "Label";
 const std::string policy::LabelTable::PrimaryKeyColumn = "id_label";
 int64_t Label::* const policy::LabelTable::PrimaryKey = &Label::m_id;
 
+namespace
+{
+
+bool areInserted( const std::vector<MediaPtr>& media )
+{
+    for ( const auto& m : media )
+    {
+        if ( m == nullptr || m->id() == 0 )
+            return false;
+    }
+    return true;
+}
+
+}
+
 Label::Label(MediaLibraryPtr ml, sqlite::Row& row )
     : m_ml( ml )
 {
@@ -71,6 +87,68 @@ std::vector<MediaPtr> Label::files()
     return Media::fetchAll<IMedia>( m_ml, req, m_id );
 }
 
+bool Label::addMedia( const std::vector<MediaPtr>& media )
+{
+    if ( m_id == 0 )
+    {
+        LOG_ERROR( "Can't link media to a label not inserted in database" );
+        return false;
+    }
+    if ( areInserted( media ) == false )
+    {
+        LOG_ERROR( "All media need to be inserted in database before being linked to a label" );
+        return false;
+    }
+    try
+    {
+        return sqlite::Tools::withRetries( 3, [this]( const std::vector<MediaPtr>& media ) {
+            auto t = m_ml->getConn()->newTransaction();
+            // Each inserted relation updates its media FTS document once,
+            // through the insert_label_fts trigger
+            const char* req = "INSERT OR IGNORE INTO LabelFileRelation VALUES(?, ?)";
+            for ( const auto& m : media )
+                sqlite::Tools::executeInsert( m_ml->getConn(), req, m_id, m->id() );
+            t->commit();
+            return true;
+        }, media );
+    }
+    catch ( const sqlite::errors::Generic& ex )
+    {
+        LOG_ERROR( "Failed to add label to media: ", ex.what() );
+        return false;
+    }
+}
+
+bool Label::removeMedia( const std::vector<MediaPtr>& media )
+{
+    if ( m_id == 0 )
+    {
+        LOG_ERROR( "Can't unlink media from a label not inserted in database" );
+        return false;
+    }
+    if ( areInserted( media ) == false )
+    {
+        LOG_ERROR( "All media need to be inserted in database before being unlinked from a label" );
+        return false;
+    }
+    try
+    {
+        return sqlite::Tools::withRetries( 3, [this]( const std::vector<MediaPtr>& media ) {
+            auto t = m_ml->getConn()->newTransaction();
+            const char* req = "DELETE FROM LabelFileRelation WHERE label_id = ? AND media_id = ?";
+            for ( const auto& m : media )
+                sqlite::Tools::executeDelete( m_ml->getConn(), req, m_id, m->id() );
+            t->commit();
+            return true;
+        }, media );
+    }
+    catch ( const sqlite::errors::Generic& ex )
+    {
+        LOG_ERROR( "Failed to remove label from media: ", ex.what() );
+        return false;
+    }
+}
+
 LabelPtr Label::create( MediaLibraryPtr ml, const std::string& name )
 {
     auto self = std::make_shared<Label>( ml, name );
@@ -99,13 +177,45 @@ void Label::createTable( sqlite::Connection* dbConnection )
 
 void Label::createTriggers( sqlite::Connection* dbConnection )
 {
-    const std::string ftsTrigger = "CREATE TRIGGER IF NOT EXISTS delete_label_fts "
-            "BEFORE DELETE ON " + policy::LabelTable::Name +
+    // LabelFileRelation's primary key already acts as the label -> media
+    // posting list, this index provides the reverse media -> labels lookup
+    // used to rebuild a media's FTS document.
+    const std::string indexReq = "CREATE INDEX IF NOT EXISTS index_label_media_id "
+            "ON LabelFileRelation(media_id)";
+    // The FTS labels column is always rebuilt from the relation table, so
+    // overlapping label names (ie. "otter" & "sea otter") can't corrupt it.
+    // This also covers label deletion, through the ON DELETE CASCADE
+    static const std::string ftsLabels = "(SELECT IFNULL(GROUP_CONCAT(l.name, ' '), '') FROM "
+            + policy::LabelTable::Name + " l "
+            "INNER JOIN LabelFileRelation lfr ON lfr.label_id = l.id_label "
+            "WHERE lfr.media_id = ";
+    const std::string ftsInsertTrigger = "CREATE TRIGGER IF NOT EXISTS insert_label_fts "
+            "AFTER INSERT ON LabelFileRelation"
             " BEGIN"
-            " UPDATE " + policy::MediaTable::Name + "Fts SET labels = TRIM(REPLACE(labels, old.name, ''))"
-            " WHERE labels MATCH old.name;"
+            " UPDATE " + policy::MediaTable::Name + "Fts SET labels = " +
+                ftsLabels + "new.media_id)"
+            " WHERE rowid = new.media_id;"
             " END";
-    sqlite::Tools::executeRequest( dbConnection, ftsTrigger );
+    const std::string ftsDeleteTrigger = "CREATE TRIGGER IF NOT EXISTS delete_label_fts "
+            "AFTER DELETE ON LabelFileRelation"
+            " BEGIN"
+            " UPDATE " + policy::MediaTable::Name + "Fts SET labels = " +
+                ftsLabels + "old.media_id)"
+            " WHERE rowid = old.media_id;"
+            " END";
+    sqlite::Tools::executeRequest( dbConnection, indexReq );
+    sqlite::Tools::executeRequest( dbConnection, ftsInsertTrigger );
+    sqlite::Tools::executeRequest( dbConnection, ftsDeleteTrigger );
+}
+
+void Label::rebuildFts( sqlite::Connection* dbConnection )
+{
+    const std::string req = "UPDATE " + policy::MediaTable::Name + "Fts "
+            "SET labels = (SELECT IFNULL(GROUP_CONCAT(l.name, ' '), '') FROM "
+            + policy::LabelTable::Name + " l "
+            "INNER JOIN LabelFileRelation lfr ON lfr.label_id = l.id_label "
+            "WHERE lfr.media_id = " + policy::MediaTable::Name + "Fts.rowid)";
+    sqlite::Tools::executeUpdate( dbConnection, req );
 }
 
 }
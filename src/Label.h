@@ -55,10 +55,16 @@ class Label : public ILabel, public DatabaseHelpers<Label, policy::LabelTable>
         virtual int64_t id() const override;
         virtual const std::string& name() const override;
         virtual std::vector<MediaPtr> files() override;
+        virtual bool addMedia( const std::vector<MediaPtr>& media ) override;
+        virtual bool removeMedia( const std::vector<MediaPtr>& media ) override;
 
         static LabelPtr create( MediaLibraryPtr ml, const std::string& name );
         static void createTable( sqlite::Connection* dbConnection );
         static void createTriggers( sqlite::Connection* dbConnection );
+        /**
+         * @brief rebuildFts Recomputes all media FTS labels from LabelFileRelation
+         */
+        static void rebuildFts( sqlite::Connection* dbConnection );
 
     private:
         MediaLibraryPtr m_ml;
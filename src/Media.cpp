@@ -555,6 +555,34 @@ void Media::setTitleBuffered( const std::string& title )
     m_changed = true;
 }
 
+bool Media::setFileName( const std::string& fileName )
+{
+    static const std::string req = "UPDATE " + policy::MediaTable::Name + " SET filename = ?, title = ? "
+            "WHERE id_media = ?";
+    if ( m_filename == fileName )
+        return true;
+    // The title defaults to the file name, and the parser may only strip its
+    // extension when no better title is found. In both cases, keep following it
+    auto title = m_title;
+    if ( m_title == m_filename )
+        title = fileName;
+    else if ( m_title == utils::file::stripExtension( m_filename ) )
+        title = utils::file::stripExtension( fileName );
+    try
+    {
+        if ( sqlite::Tools::executeUpdate( m_ml->getConn(), req, fileName, title, m_id ) == false )
+            return false;
+    }
+    catch ( const sqlite::errors::Generic& ex )
+    {
+        LOG_ERROR( "Failed to set media file name: ", ex.what() );
+        return false;
+    }
+    m_filename = fileName;
+    m_title = std::move( title );
+    return true;
+}
+
 void Media::createTable( sqlite::Connection* connection )
 {
     std::string req = "CREATE TABLE IF NOT EXISTS " + policy::MediaTable::Name + "("
@@ -668,13 +696,10 @@ bool Media::addLabel( LabelPtr label )
         return sqlite::Tools::withRetries( 3, [this]( LabelPtr label ) {
             auto t = m_ml->getConn()->newTransaction();
 
+            // MediaFts.labels is kept up to date by the insert_label_fts trigger
             const char* req = "INSERT INTO LabelFileRelation VALUES(?, ?)";
             if ( sqlite::Tools::executeInsert( m_ml->getConn(), req, label->id(), m_id ) == 0 )
                 return false;
-            const std::string reqFts = "UPDATE " + policy::MediaTable::Name + "Fts "
-                "SET labels = labels || ' ' || ? WHERE rowid = ?";
-            if ( sqlite::Tools::executeUpdate( m_ml->getConn(), reqFts, label->name(), m_id ) == false )
-                return false;
             t->commit();
             return true;
         }, std::move( label ) );
@@ -698,13 +723,10 @@ bool Media::removeLabel( LabelPtr label )
         return sqlite::Tools::withRetries( 3, [this]( LabelPtr label ) {
             auto t = m_ml->getConn()->newTransaction();
 
+            // MediaFts.labels is kept up to date by the delete_label_fts trigger
             const char* req = "DELETE FROM LabelFileRelation WHERE label_id = ? AND media_id = ?";
             if ( sqlite::Tools::executeDelete( m_ml->getConn(), req, label->id(), m_id ) == false )
                 return false;
-            const std::string reqFts = "UPDATE " + policy::MediaTable::Name + "Fts "
-                    "SET labels = TRIM(REPLACE(labels, ?, '')) WHERE rowid = ?";
-            if ( sqlite::Tools::executeUpdate( m_ml->getConn(), reqFts, label->name(), m_id ) == false )
-                return false;
             t->commit();
             return true;
         }, std::move( label ) );
@@ -717,13 +739,26 @@ bool Media::removeLabel( LabelPtr label )
 }
 
 
-std::vector<MediaPtr> Media::search( MediaLibraryPtr ml, const std::string& title )
+std::vector<MediaPtr> Media::search( MediaLibraryPtr ml, const std::string& title,
+                                     SubType subType, uint32_t offset, uint32_t limit )
 {
+    // subtype is NULL until the media gets saved, which stands for SubType::Unknown
     static const std::string req = "SELECT * FROM " + policy::MediaTable::Name + " WHERE"
             " id_media IN (SELECT rowid FROM " + policy::MediaTable::Name + "Fts"
             " WHERE " + policy::MediaTable::Name + "Fts MATCH '*' || ? || '*')"
-            "AND is_present = 1";
-    return Media::fetchAll<IMedia>( ml, req, title );
+            " AND is_present = 1 AND IFNULL(subtype, 0) = ?"
+            " ORDER BY title, id_media LIMIT ? OFFSET ?";
+    return Media::fetchAll<IMedia>( ml, req, title, subType,
+                                    sqlite::Tools::limit( limit ), offset );
+}
+
+uint32_t Media::searchCount( MediaLibraryPtr ml, const std::string& title, SubType subType )
+{
+    static const std::string req = "SELECT COUNT(*) FROM " + policy::MediaTable::Name + " WHERE"
+            " id_media IN (SELECT rowid FROM " + policy::MediaTable::Name + "Fts"
+            " WHERE " + policy::MediaTable::Name + "Fts MATCH '*' || ? || '*')"
+            " AND is_present = 1 AND IFNULL(subtype, 0) = ?";
+    return sqlite::Tools::fetchCount( ml, req, title, subType );
 }
 
 std::vector<MediaPtr> Media::fetchHistory( MediaLibraryPtr ml )
@@ -956,6 +991,41 @@ std::vector<MediaPtr> Media::findDuplicatesByInfohash( MediaLibraryPtr ml )
     return fetchAll<IMedia>( ml, req );
 }
 
+std::vector<MediaPtr> Media::searchP2P( MediaLibraryPtr ml, const std::string& pattern, int isLive,
+                                        int64_t parentId, uint32_t offset, uint32_t limit )
+{
+    // Each candidate source gets its own sub-request so that all of them can
+    // use an index: index_p2p_infohash for infohash prefixes (the LIKE
+    // optimization applies since the column is NOCASE and the pattern is bound
+    // as a constant prefix), the FTS table for the media own title, and
+    // index_parent_media_id for the children of a matching transport file.
+    std::string req = "SELECT * FROM " + policy::MediaTable::Name + " WHERE id_media IN ("
+                "SELECT id_media FROM " + policy::MediaTable::Name +
+                    " WHERE p2p_infohash LIKE ? ESCAPE '\\'"
+                " UNION SELECT rowid FROM " + policy::MediaTable::Name + "Fts"
+                    " WHERE " + policy::MediaTable::Name + "Fts MATCH '*' || ? || '*'"
+                " UNION SELECT id_media FROM " + policy::MediaTable::Name +
+                    " WHERE parent_media_id IN (SELECT rowid FROM " + policy::MediaTable::Name + "Fts"
+                    " WHERE " + policy::MediaTable::Name + "Fts MATCH '*' || ? || '*')"
+            ") AND is_p2p != 0 AND is_present != 0";
+    // Use dummy "-1=?"/"0=?" conditions for the disabled filters, see listAll
+    req += (isLive == -1) ? " AND -1 = ?" : " AND p2p_is_live = ?";
+    req += (parentId == 0) ? " AND 0 = ?" : " AND parent_media_id = ?";
+    req += " ORDER BY title, id_media LIMIT ? OFFSET ?";
+
+    std::string infohashPrefix;
+    infohashPrefix.reserve( pattern.length() + 1 );
+    for ( auto c : pattern )
+    {
+        if ( c == '%' || c == '_' || c == '\\' )
+            infohashPrefix += '\\';
+        infohashPrefix += c;
+    }
+    infohashPrefix += '%';
+    return fetchAll<IMedia>( ml, req, infohashPrefix, pattern, pattern, isLive, parentId,
+                             sqlite::Tools::limit( limit ), offset );
+}
+
 bool Media::copyMetadata(MediaLibraryPtr ml, int64_t sourceId, int64_t destId)
 {
     MediaPtr source = fetch(ml, sourceId);
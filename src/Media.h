@@ -100,6 +100,11 @@ class Media : public IMedia, public DatabaseHelpers<Media, policy::MediaTable>
         /// until save() is called
         ///
         void setTitleBuffered( const std::string& title );
+        ///
+        /// \brief setFileName Updates the file name after the media file was renamed
+        /// The title is updated as well when it was still the default one.
+        ///
+        bool setFileName( const std::string& fileName );
         virtual AlbumTrackPtr albumTrack() const override;
         void setAlbumTrack( AlbumTrackPtr albumTrack );
         virtual int64_t duration() const override;
@@ -140,7 +145,9 @@ class Media : public IMedia, public DatabaseHelpers<Media, policy::MediaTable>
         void removeFile( File& file );
 
         static std::vector<MediaPtr> listAll(MediaLibraryPtr ml, Type type , SortingCriteria sort, bool desc, int is_p2p, int is_live, int is_parsed);
-        static std::vector<MediaPtr> search( MediaLibraryPtr ml, const std::string& title );
+        static std::vector<MediaPtr> search( MediaLibraryPtr ml, const std::string& title,
+                                             SubType subType, uint32_t offset, uint32_t limit );
+        static uint32_t searchCount( MediaLibraryPtr ml, const std::string& title, SubType subType );
         static std::vector<MediaPtr> fetchHistory( MediaLibraryPtr ml );
         static void clearHistory( MediaLibraryPtr ml );
         bool destroy() override;
@@ -162,6 +169,8 @@ class Media : public IMedia, public DatabaseHelpers<Media, policy::MediaTable>
         static std::vector<MediaPtr> findByInfohash(MediaLibraryPtr ml, const std::string& infohash, int fileIndex, SortingCriteria sort, bool desc);
         static std::vector<MediaPtr> findByParent(MediaLibraryPtr ml, int64_t parentId, SortingCriteria sort, bool desc);
         static std::vector<MediaPtr> findDuplicatesByInfohash(MediaLibraryPtr ml);
+        static std::vector<MediaPtr> searchP2P( MediaLibraryPtr ml, const std::string& pattern, int isLive,
+                                                int64_t parentId, uint32_t offset, uint32_t limit );
         static bool copyMetadata(MediaLibraryPtr ml, int64_t sourceId, int64_t destId);
         static std::vector<MediaPtr> listVideo(MediaLibraryPtr ml, int is_p2p, int is_live, SortingCriteria sort, bool desc);
         static std::vector<MediaPtr> listAudio(MediaLibraryPtr ml, int is_p2p, int is_live, SortingCriteria sort, bool desc);
@@ -35,6 +35,7 @@
 #include "Artist.h"
 #include "AudioTrack.h"
 #include "discoverer/DiscovererWorker.h"
+#include "discoverer/DiscoveryTask.h"
 #include "discoverer/probe/CrawlerProbe.h"
 #include "utils/ModificationsNotifier.h"
 #include "Device.h"
@@ -93,6 +94,8 @@ const char* const MediaLibrary::supportedExtensions[] = {
 
 const size_t MediaLibrary::NbSupportedExtensions = sizeof(supportedExtensions) / sizeof(supportedExtensions[0]);
 
+const unsigned int MediaLibrary::NbNetworkDiscoveryThreads = 4;
+
 MediaLibrary::MediaLibrary()
     : m_callback( nullptr )
     , m_verbosity( LogLevel::Error )
@@ -100,17 +103,27 @@ MediaLibrary::MediaLibrary()
     , m_initialized( false )
     , m_discovererIdle( true )
     , m_parserIdle( true )
+    , m_nbDiscoveryThreads( 1 )
+    , m_nbMetadataThreads( 0 )
+    , m_fsWatcherEnabled( false )
 {
     Log::setLogLevel( m_verbosity );
 }
 
 MediaLibrary::~MediaLibrary()
 {
+    // Don't keep the background threads throttled while they're stopping
+    m_governor.stop();
+    // The device lister would otherwise keep reporting device changes
+    if ( m_deviceLister != nullptr )
+        m_deviceLister->stop();
+    // Stop the parser first, since the discoverer might be waiting for it
+    // to drain its queue
+    if ( m_parser != nullptr )
+        m_parser->stop();
     // Explicitely stop the discoverer, to avoid it writting while tearing down.
     if ( m_discovererWorker != nullptr )
         m_discovererWorker->stop();
-    if ( m_parser != nullptr )
-        m_parser->stop();
     clearCache();
 }
 
@@ -160,6 +173,8 @@ void MediaLibrary::createAllTables()
     History::createTable( m_dbConnection.get() );
     Settings::createTable( m_dbConnection.get() );
     parser::Task::createTable( m_dbConnection.get() );
+    parser::ParseCache::createTable( m_dbConnection.get() );
+    DiscoveryTask::createTable( m_dbConnection.get() );
 }
 
 void MediaLibrary::createAllTriggers()
@@ -324,6 +339,10 @@ bool MediaLibrary::start()
 
     for ( auto& fsFactory : m_fsFactories )
         refreshDevices( *fsFactory );
+    // From now on, the devices changes are pushed by the lister, when it
+    // supports it, instead of being listed again on each refresh
+    if ( m_deviceLister->start( static_cast<IDeviceListerCb*>( this ) ) == true )
+        LOG_INFO( "Monitoring devices changes" );
     startDiscoverer();
     startParser();
     return true;
@@ -485,6 +504,13 @@ void MediaLibrary::addDiscoveredFile( std::shared_ptr<fs::IFile> fileFs,
     }
 }
 
+bool MediaLibrary::waitForParserCapacity( const std::atomic_bool* interrupted )
+{
+    if ( m_parser == nullptr )
+        return true;
+    return m_parser->waitForCapacity( interrupted );
+}
+
 bool MediaLibrary::deleteFolder( const Folder& folder )
 {
     LOG_INFO( "deleting folder ", folder.mrl() );
@@ -702,68 +728,105 @@ bool MediaLibrary::clearHistory()
 }
 
 MediaSearchAggregate MediaLibrary::searchMedia( const std::string& title ) const
+{
+    return searchMedia( title, 0, 0 );
+}
+
+MediaSearchAggregate MediaLibrary::searchMedia( const std::string& title,
+                                                uint32_t offset, uint32_t limit ) const
 {
     if ( validateSearchPattern( title ) == false )
         return {};
-    auto tmp = Media::search( this, title );
     MediaSearchAggregate res;
-    for ( auto& m : tmp )
-    {
-        switch ( m->subType() )
-        {
-        case IMedia::SubType::AlbumTrack:
-            res.tracks.emplace_back( std::move( m ) );
-            break;
-        case IMedia::SubType::Movie:
-            res.movies.emplace_back( std::move( m ) );
-            break;
-        case IMedia::SubType::ShowEpisode:
-            res.episodes.emplace_back( std::move( m ) );
-            break;
-        default:
-            res.others.emplace_back( std::move( m ) );
-            break;
-        }
-    }
+    res.episodes = Media::search( this, title, IMedia::SubType::ShowEpisode, offset, limit );
+    res.movies = Media::search( this, title, IMedia::SubType::Movie, offset, limit );
+    res.others = Media::search( this, title, IMedia::SubType::Unknown, offset, limit );
+    res.tracks = Media::search( this, title, IMedia::SubType::AlbumTrack, offset, limit );
     return res;
 }
 
 std::vector<PlaylistPtr> MediaLibrary::searchPlaylists( const std::string& name ) const
+{
+    return searchPlaylists( name, 0, 0 );
+}
+
+std::vector<PlaylistPtr> MediaLibrary::searchPlaylists( const std::string& name,
+                                                        uint32_t offset, uint32_t limit ) const
 {
     if ( validateSearchPattern( name ) == false )
         return {};
-    return Playlist::search( this, name );
+    return Playlist::search( this, name, offset, limit );
 }
 
 std::vector<AlbumPtr> MediaLibrary::searchAlbums( const std::string& pattern ) const
+{
+    return searchAlbums( pattern, 0, 0 );
+}
+
+std::vector<AlbumPtr> MediaLibrary::searchAlbums( const std::string& pattern,
+                                                  uint32_t offset, uint32_t limit ) const
 {
     if ( validateSearchPattern( pattern ) == false )
         return {};
-    return Album::search( this, pattern );
+    return Album::search( this, pattern, offset, limit );
 }
 
 std::vector<GenrePtr> MediaLibrary::searchGenre( const std::string& genre ) const
+{
+    return searchGenre( genre, 0, 0 );
+}
+
+std::vector<GenrePtr> MediaLibrary::searchGenre( const std::string& genre,
+                                                 uint32_t offset, uint32_t limit ) const
 {
     if ( validateSearchPattern( genre ) == false )
         return {};
-    return Genre::search( this, genre );
+    return Genre::search( this, genre, offset, limit );
 }
 
-std::vector<ArtistPtr> MediaLibrary::searchArtists(const std::string& name ) const
+std::vector<ArtistPtr> MediaLibrary::searchArtists( const std::string& name ) const
+{
+    return searchArtists( name, 0, 0 );
+}
+
+std::vector<ArtistPtr> MediaLibrary::searchArtists( const std::string& name,
+                                                    uint32_t offset, uint32_t limit ) const
 {
     if ( validateSearchPattern( name ) == false )
         return {};
-    return Artist::search( this, name );
+    return Artist::search( this, name, offset, limit );
 }
 
 SearchAggregate MediaLibrary::search( const std::string& pattern ) const
+{
+    return search( pattern, 0, 0 );
+}
+
+SearchAggregate MediaLibrary::search( const std::string& pattern,
+                                      uint32_t offset, uint32_t limit ) const
 {
     SearchAggregate res;
-    res.albums = searchAlbums( pattern );
-    res.artists = searchArtists( pattern );
-    res.genres = searchGenre( pattern );
-    res.media = searchMedia( pattern );
-    res.playlists = searchPlaylists( pattern );
+    res.albums = searchAlbums( pattern, offset, limit );
+    res.artists = searchArtists( pattern, offset, limit );
+    res.genres = searchGenre( pattern, offset, limit );
+    res.media = searchMedia( pattern, offset, limit );
+    res.playlists = searchPlaylists( pattern, offset, limit );
+    return res;
+}
+
+SearchCount MediaLibrary::searchCount( const std::string& pattern ) const
+{
+    SearchCount res = {};
+    if ( validateSearchPattern( pattern ) == false )
+        return res;
+    res.albums = Album::searchCount( this, pattern );
+    res.artists = Artist::searchCount( this, pattern );
+    res.genres = Genre::searchCount( this, pattern );
+    res.media.episodes = Media::searchCount( this, pattern, IMedia::SubType::ShowEpisode );
+    res.media.movies = Media::searchCount( this, pattern, IMedia::SubType::Movie );
+    res.media.others = Media::searchCount( this, pattern, IMedia::SubType::Unknown );
+    res.media.tracks = Media::searchCount( this, pattern, IMedia::SubType::AlbumTrack );
+    res.playlists = Playlist::searchCount( this, pattern );
     return res;
 }
 
@@ -771,7 +834,7 @@ void MediaLibrary::startParser()
 {
     m_parser.reset( new Parser( this ) );
 
-    auto vlcService = std::unique_ptr<VLCMetadataService>( new VLCMetadataService );
+    auto vlcService = std::unique_ptr<VLCMetadataService>( new VLCMetadataService( m_nbMetadataThreads ) );
     auto metadataService = std::unique_ptr<MetadataParser>( new MetadataParser );
     auto thumbnailerService = std::unique_ptr<VLCThumbnailer>( new VLCThumbnailer );
     m_parser->addService( std::move( vlcService ) );
@@ -786,9 +849,19 @@ void MediaLibrary::startDiscoverer()
     for ( const auto& fsFactory : m_fsFactories )
     {
         auto probePtr = std::unique_ptr<prober::CrawlerProbe>( new prober::CrawlerProbe{} );
-        m_discovererWorker->addDiscoverer( std::unique_ptr<IDiscoverer>( new FsDiscoverer( fsFactory, this, m_callback,
-                                                                                           std::move ( probePtr ) ) ) );
+        // Keep several network listings in flight, since each of them
+        // mostly waits for the server to answer
+        auto nbThreads = m_nbDiscoveryThreads;
+        if ( fsFactory->isNetworkFileSystem() == true )
+            nbThreads = std::max( nbThreads, NbNetworkDiscoveryThreads );
+        m_discovererWorker->addDiscoverer( std::unique_ptr<IDiscoverer>( new FsDiscoverer( fsFactory, this,
+                                                                                           m_discovererWorker->callback(),
+                                                                                           std::move ( probePtr ),
+                                                                                           nbThreads ) ) );
     }
+    if ( m_fsWatcherEnabled == true )
+        m_discovererWorker->startWatcher();
+    m_discovererWorker->resume();
 }
 
 void MediaLibrary::startDeletionNotifier()
@@ -897,6 +970,29 @@ InitializeResult MediaLibrary::updateDatabaseModel( unsigned int previousVersion
                 migrateModel12to13();
                 previousVersion = 13;
             }
+            if ( previousVersion == 13 )
+            {
+                migrateModel13to14();
+                previousVersion = 14;
+            }
+            if ( previousVersion == 14 )
+            {
+                migrateModel14to15();
+                previousVersion = 15;
+            }
+            /**
+             * V16 adds the ParseCache & ParseCacheTrack tables. As for any new
+             * table, such as DiscoveryTask which didn't require a new model,
+             * they are created by createAllTables() before the migrations
+             * run, so there is intentionally nothing to migrate here.
+             */
+            if ( previousVersion == 15 )
+                previousVersion = 16;
+            if ( previousVersion == 16 )
+            {
+                migrateModel16to17();
+                previousVersion = 17;
+            }
             // To be continued in the future!
 
             if ( needRescan == true )
@@ -1101,6 +1197,63 @@ void MediaLibrary::migrateModel12to13()
     t->commit();
 }
 
+/*
+ * - MediaFts.labels used to be maintained through string concatenation and
+ *   REPLACE, which broke with overlapping label names. It is now rebuilt from
+ *   LabelFileRelation by triggers, so drop the old trigger, create the new
+ *   ones and recompute all labels once.
+ */
+void MediaLibrary::migrateModel13to14()
+{
+    auto t = getConn()->newTransaction();
+    const std::string req = "DROP TRIGGER IF EXISTS delete_label_fts";
+    sqlite::Tools::executeDelete( getConn(), req );
+    Label::createTriggers( getConn() );
+    Label::rebuildFts( getConn() );
+    t->commit();
+}
+
+/*
+ * - Folders now store their last known modification date & subfolder count,
+ *   so reloads can skip the folders which didn't change.
+ *   Existing folders default to 0, which forces them to be listed once.
+ */
+void MediaLibrary::migrateModel14to15()
+{
+    auto t = getConn()->newTransaction();
+    const std::string reqs[] = {
+        "ALTER TABLE " + policy::FolderTable::Name +
+            " ADD COLUMN last_modification_date UNSIGNED INTEGER NOT NULL DEFAULT 0",
+        "ALTER TABLE " + policy::FolderTable::Name +
+            " ADD COLUMN nb_subfolders UNSIGNED INTEGER NOT NULL DEFAULT 0",
+    };
+    for ( const auto& req : reqs )
+        sqlite::Tools::executeRequest( getConn(), req );
+    t->commit();
+}
+
+/*
+ * - Files now store their inode, or a hash of their content when they don't
+ *   have any, so that the moved files can be told apart from other files with
+ *   the same size and modification date.
+ *   The folders modification dates are reset, so that the next reload lists
+ *   every folder once, and stores the inodes of the existing files.
+ */
+void MediaLibrary::migrateModel16to17()
+{
+    auto t = getConn()->newTransaction();
+    const std::string reqs[] = {
+        "ALTER TABLE " + policy::FileTable::Name +
+            " ADD COLUMN inode INTEGER NOT NULL DEFAULT 0",
+        "ALTER TABLE " + policy::FileTable::Name +
+            " ADD COLUMN content_hash INTEGER NOT NULL DEFAULT 0",
+        "UPDATE " + policy::FolderTable::Name + " SET last_modification_date = 0",
+    };
+    for ( const auto& req : reqs )
+        sqlite::Tools::executeRequest( getConn(), req );
+    t->commit();
+}
+
 void MediaLibrary::reload()
 {
     if ( m_discovererWorker != nullptr )
@@ -1139,6 +1292,23 @@ void MediaLibrary::resumeBackgroundOperations()
         m_parser->resume();
 }
 
+void MediaLibrary::setBackgroundBudget( uint32_t nbOperationsPerSec, uint64_t nbBytesPerSec )
+{
+    m_governor.setBudget( nbOperationsPerSec, nbBytesPerSec );
+}
+
+void MediaLibrary::setPlaybackActive( bool active )
+{
+    m_governor.setPlaybackActive( active );
+}
+
+bool MediaLibrary::prioritizeParsing( const std::string& mrl, ParsingPriority priority )
+{
+    if ( m_parser == nullptr || mrl.empty() == true )
+        return false;
+    return m_parser->prioritize( mrl, priority );
+}
+
 void MediaLibrary::onDiscovererIdleChanged( bool idle )
 {
     bool expected = !idle;
@@ -1186,6 +1356,11 @@ std::shared_ptr<ModificationNotifier> MediaLibrary::getNotifier() const
     return m_modificationNotifier;
 }
 
+utils::Governor& MediaLibrary::governor()
+{
+    return m_governor;
+}
+
 IDeviceListerCb* MediaLibrary::setDeviceLister( DeviceListerPtr lister )
 {
     assert( m_initialized == false );
@@ -1227,6 +1402,24 @@ void MediaLibrary::setDiscoverNetworkEnabled( bool enabled )
     }
 }
 
+void MediaLibrary::setDiscoveryThreads( unsigned int nbThreads )
+{
+    assert( m_discovererWorker == nullptr );
+    m_nbDiscoveryThreads = nbThreads > 0 ? nbThreads : 1;
+}
+
+void MediaLibrary::setMetadataExtractionThreads( unsigned int nbThreads )
+{
+    assert( m_parser == nullptr );
+    m_nbMetadataThreads = nbThreads;
+}
+
+void MediaLibrary::setFsWatcherEnabled( bool enabled )
+{
+    assert( m_discovererWorker == nullptr );
+    m_fsWatcherEnabled = enabled;
+}
+
 std::vector<FolderPtr> MediaLibrary::entryPoints() const
 {
     static const std::string req = "SELECT * FROM " + policy::FolderTable::Name + " WHERE parent_id IS NULL"
@@ -1339,11 +1532,23 @@ bool MediaLibrary::onDevicePlugged( const std::string& uuid, const std::string&
             auto deviceFs = fsFactory->createDevice( uuid );
             if ( deviceFs != nullptr )
             {
+                // The device may already have been refreshed from the lister
                 LOG_INFO( "Device ", uuid, " changed presence state: 0 -> 1" );
-                assert( deviceFs->isPresent() == false );
                 deviceFs->setPresent( true );
                 if ( currentDevice != nullptr )
+                {
                     currentDevice->setPresent( true );
+                    // The device content may have changed while it was away
+                    if ( m_discovererWorker != nullptr )
+                    {
+                        for ( const auto& f : Folder::fetchRootFolders( this ) )
+                        {
+                            if ( f->deviceId() == currentDevice->id() )
+                                m_discovererWorker->reload( f->mrl(),
+                                        DiscovererWorker::Priority::Device );
+                        }
+                    }
+                }
             }
             else
                 refreshDevices( *fsFactory );
@@ -1356,7 +1561,6 @@ bool MediaLibrary::onDevicePlugged( const std::string& uuid, const std::string&
 void MediaLibrary::onDeviceUnplugged( const std::string& uuid )
 {
     auto device = Device::fromUuid( this, uuid );
-    assert( device->isRemovable() == true );
     if ( device == nullptr )
     {
         LOG_WARN( "Unknown device ", uuid, " was unplugged. Ignoring." );
@@ -1370,7 +1574,6 @@ void MediaLibrary::onDeviceUnplugged( const std::string& uuid )
             auto deviceFs = fsFactory->createDevice( uuid );
             if ( deviceFs != nullptr )
             {
-                assert( deviceFs->isPresent() == true );
                 LOG_INFO( "Device ", uuid, " changed presence state: 1 -> 0" );
                 deviceFs->setPresent( false );
                 device->setPresent( false );
@@ -1412,6 +1615,14 @@ bool MediaLibrary::removeOrphanTransportFiles() const
     //TODO: implement
     return false;
 }
+
+std::vector<MediaPtr> MediaLibrary::searchP2PMedia( const std::string& pattern, int isLive, int64_t parentId,
+                                                    uint32_t offset, uint32_t limit ) const
+{
+    if ( validateSearchPattern( pattern ) == false )
+        return {};
+    return Media::searchP2P( this, pattern, isLive, parentId, offset, limit );
+}
 ///ace
 
 } // namespace medialibrary
\ No newline at end of file
@@ -26,6 +26,7 @@
 #include "medialibrary/IMediaLibrary.h"
 #include "logging/Logger.h"
 #include "Settings.h"
+#include "utils/Governor.h"
 
 #include "medialibrary/IDeviceLister.h"
 
@@ -123,9 +124,25 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         virtual std::vector<GenrePtr> searchGenre( const std::string& genre ) const override;
         virtual std::vector<ArtistPtr> searchArtists( const std::string& name ) const override;
         virtual SearchAggregate search( const std::string& pattern ) const override;
+        virtual MediaSearchAggregate searchMedia( const std::string& title,
+                                                  uint32_t offset, uint32_t limit ) const override;
+        virtual std::vector<PlaylistPtr> searchPlaylists( const std::string& name,
+                                                          uint32_t offset, uint32_t limit ) const override;
+        virtual std::vector<AlbumPtr> searchAlbums( const std::string& pattern,
+                                                    uint32_t offset, uint32_t limit ) const override;
+        virtual std::vector<GenrePtr> searchGenre( const std::string& genre,
+                                                   uint32_t offset, uint32_t limit ) const override;
+        virtual std::vector<ArtistPtr> searchArtists( const std::string& name,
+                                                      uint32_t offset, uint32_t limit ) const override;
+        virtual SearchAggregate search( const std::string& pattern,
+                                        uint32_t offset, uint32_t limit ) const override;
+        virtual SearchCount searchCount( const std::string& pattern ) const override;
 
         virtual void discover( const std::string& entryPoint ) override;
         virtual void setDiscoverNetworkEnabled( bool enabled ) override;
+        virtual void setDiscoveryThreads( unsigned int nbThreads ) override;
+        virtual void setMetadataExtractionThreads( unsigned int nbThreads ) override;
+        virtual void setFsWatcherEnabled( bool enabled ) override;
         virtual std::vector<FolderPtr> entryPoints() const override;
         virtual FolderPtr folder( const std::string& mrl ) const override;
         virtual void removeEntryPoint( const std::string& entryPoint ) override;
@@ -141,12 +158,23 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
 
         virtual void pauseBackgroundOperations() override;
         virtual void resumeBackgroundOperations() override;
+        virtual void setBackgroundBudget( uint32_t nbOperationsPerSec, uint64_t nbBytesPerSec ) override;
+        virtual void setPlaybackActive( bool active ) override;
+        virtual bool prioritizeParsing( const std::string& mrl, ParsingPriority priority ) override;
         void onDiscovererIdleChanged( bool idle );
         void onParserIdleChanged( bool idle );
 
         sqlite::Connection* getConn() const;
         IMediaLibraryCb* getCb() const;
         std::shared_ptr<ModificationNotifier> getNotifier() const;
+        utils::Governor& governor();
+        ///
+        /// \brief waitForParserCapacity Blocks while the parser queue is full
+        /// This must not be called while holding a transaction, since the
+        /// parser needs to write to the database to drain its queue.
+        /// \return false if the wait was interrupted
+        ///
+        bool waitForParserCapacity( const std::atomic_bool* interrupted );
 
         virtual IDeviceListerCb* setDeviceLister( DeviceListerPtr lister ) override;
         std::shared_ptr<factory::IFileSystem> fsFactoryForMrl( const std::string& path ) const;
@@ -164,6 +192,8 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         virtual std::vector<MediaPtr> findDuplicatesByInfohash() const override;
         virtual bool copyMetadata( int64_t sourceId, int64_t destId ) const override;
         virtual bool removeOrphanTransportFiles() const override;
+        virtual std::vector<MediaPtr> searchP2PMedia( const std::string& pattern, int isLive, int64_t parentId,
+                                                      uint32_t offset, uint32_t limit ) const override;
         ///ace
 
     protected:
@@ -176,6 +206,10 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         virtual void startDiscoverer();
         virtual void startDeletionNotifier();
 
+    private:
+        // The minimum number of threads browsing network shares
+        static const unsigned int NbNetworkDiscoveryThreads;
+
     private:
         bool recreateDatabase( const std::string& dbPath );
         InitializeResult updateDatabaseModel( unsigned int previousVersion,
@@ -187,6 +221,9 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         void migrateModel9to10();
         void migrateModel10to11();
         void migrateModel12to13();
+        void migrateModel13to14();
+        void migrateModel14to15();
+        void migrateModel16to17();
         void createAllTables();
         void createAllTriggers();
         void registerEntityHooks();
@@ -210,6 +247,8 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         std::string m_thumbnailPath;
         IMediaLibraryCb* m_callback;
         DeviceListerPtr m_deviceLister;
+        // Shared by the discoverer & parser threads, so it must outlive them
+        utils::Governor m_governor;
 
         // Keep the parser as last field.
         // The parser holds a (raw) pointer to the media library. When MediaLibrary's destructor gets called
@@ -226,6 +265,9 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         bool m_initialized;
         std::atomic_bool m_discovererIdle;
         std::atomic_bool m_parserIdle;
+        unsigned int m_nbDiscoveryThreads;
+        unsigned int m_nbMetadataThreads;
+        bool m_fsWatcherEnabled;
 };
 
 }
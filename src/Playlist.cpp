@@ -260,11 +260,20 @@ void Playlist::createTriggers( sqlite::Connection* dbConn )
     sqlite::Tools::executeRequest( dbConn, vtriggerDelete );
 }
 
-std::vector<PlaylistPtr> Playlist::search( MediaLibraryPtr ml, const std::string& name )
+std::vector<PlaylistPtr> Playlist::search( MediaLibraryPtr ml, const std::string& name,
+                                           uint32_t offset, uint32_t limit )
 {
     static const std::string req = "SELECT * FROM " + policy::PlaylistTable::Name + " WHERE id_playlist IN "
-            "(SELECT rowid FROM " + policy::PlaylistTable::Name + "Fts WHERE name MATCH '*' || ? || '*')";
-    return fetchAll<IPlaylist>( ml, req, name );
+            "(SELECT rowid FROM " + policy::PlaylistTable::Name + "Fts WHERE name MATCH '*' || ? || '*') "
+            "ORDER BY name, id_playlist LIMIT ? OFFSET ?";
+    return fetchAll<IPlaylist>( ml, req, name, sqlite::Tools::limit( limit ), offset );
+}
+
+uint32_t Playlist::searchCount( MediaLibraryPtr ml, const std::string& name )
+{
+    static const std::string req = "SELECT COUNT(*) FROM " + policy::PlaylistTable::Name + "Fts "
+            "WHERE name MATCH '*' || ? || '*'";
+    return sqlite::Tools::fetchCount( ml, req, name );
 }
 
 std::vector<PlaylistPtr> Playlist::listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc )
@@ -69,7 +69,9 @@ public:
 
     static void createTable( sqlite::Connection* dbConn );
     static void createTriggers( sqlite::Connection* dbConn );
-    static std::vector<PlaylistPtr> search( MediaLibraryPtr ml, const std::string& name );
+    static std::vector<PlaylistPtr> search( MediaLibraryPtr ml, const std::string& name,
+                                            uint32_t offset, uint32_t limit );
+    static uint32_t searchCount( MediaLibraryPtr ml, const std::string& name );
     static std::vector<PlaylistPtr> listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc );
 
     /**
@@ -278,6 +278,37 @@ class Tools
             return res;
         }
 
+        /**
+         * Runs a request returning a single integer column, typically a
+         * COUNT(*), without instantiating any entity.
+         * Returns 0 when the request doesn't yield any row.
+         */
+        template <typename... Args>
+        static uint32_t fetchCount( MediaLibraryPtr ml, const std::string& req, Args&&... args )
+        {
+            auto dbConnection = ml->getConn();
+            Connection::ReadContext ctx;
+            if (Transaction::transactionInProgress() == false)
+                ctx = dbConnection->acquireReadContext();
+
+            Statement stmt( dbConnection->handle(), req );
+            stmt.execute( std::forward<Args>( args )... );
+            auto row = stmt.row();
+            uint32_t res = 0;
+            if ( row != nullptr )
+                row >> res;
+            return res;
+        }
+
+        /**
+         * Converts a number of items, where 0 means "no limit", to a value
+         * suitable to be bound to a LIMIT clause
+         */
+        static int64_t limit( uint32_t nbItems )
+        {
+            return nbItems != 0 ? static_cast<int64_t>( nbItems ) : -1;
+        }
+
         template <typename... Args>
         static void executeRequest( sqlite::Connection* dbConnection, const std::string& req, Args&&... args )
         {
@@ -26,19 +26,212 @@
 
 #include "DiscovererWorker.h"
 
+#include "DiscoveryTask.h"
+#include "FsWatcher.h"
 #include "logging/Logger.h"
 #include "Folder.h"
 #include "Media.h"
 #include "MediaLibrary.h"
 #include "utils/Filename.h"
+#include <algorithm>
 #include <cassert>
+#include <iterator>
 
 namespace medialibrary
 {
 
+namespace
+{
+
+// An empty entry point stands for all the known folders
+bool isSubfolder( const std::string& parent, const std::string& folder )
+{
+    return parent.empty() == true || folder.compare( 0, parent.length(), parent ) == 0;
+}
+
+// Forwards the notifications to the application callback, one at a time
+class SerializedCb : public IMediaLibraryCb
+{
+public:
+    explicit SerializedCb( MediaLibrary* ml )
+        : m_ml( ml )
+    {
+    }
+
+    virtual void onMediaAdded( std::vector<MediaPtr> media ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onMediaAdded( std::move( media ) );
+    }
+
+    virtual void onMediaUpdated( std::vector<MediaPtr> media ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onMediaUpdated( std::move( media ) );
+    }
+
+    virtual void onMediaDeleted( std::vector<int64_t> mediaIds ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onMediaDeleted( std::move( mediaIds ) );
+    }
+
+    virtual void onArtistsAdded( std::vector<ArtistPtr> artists ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onArtistsAdded( std::move( artists ) );
+    }
+
+    virtual void onArtistsModified( std::vector<ArtistPtr> artists ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onArtistsModified( std::move( artists ) );
+    }
+
+    virtual void onArtistsDeleted( std::vector<int64_t> artistsIds ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onArtistsDeleted( std::move( artistsIds ) );
+    }
+
+    virtual void onAlbumsAdded( std::vector<AlbumPtr> albums ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onAlbumsAdded( std::move( albums ) );
+    }
+
+    virtual void onAlbumsModified( std::vector<AlbumPtr> albums ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onAlbumsModified( std::move( albums ) );
+    }
+
+    virtual void onAlbumsDeleted( std::vector<int64_t> albumsIds ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onAlbumsDeleted( std::move( albumsIds ) );
+    }
+
+    virtual void onTracksAdded( std::vector<AlbumTrackPtr> tracks ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onTracksAdded( std::move( tracks ) );
+    }
+
+    virtual void onTracksDeleted( std::vector<int64_t> trackIds ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onTracksDeleted( std::move( trackIds ) );
+    }
+
+    virtual void onPlaylistsAdded( std::vector<PlaylistPtr> playlists ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onPlaylistsAdded( std::move( playlists ) );
+    }
+
+    virtual void onPlaylistsModified( std::vector<PlaylistPtr> playlists ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onPlaylistsModified( std::move( playlists ) );
+    }
+
+    virtual void onPlaylistsDeleted( std::vector<int64_t> playlistIds ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onPlaylistsDeleted( std::move( playlistIds ) );
+    }
+
+    virtual void onDiscoveryStarted( const std::string& entryPoint ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onDiscoveryStarted( entryPoint );
+    }
+
+    virtual void onDiscoveryProgress( const std::string& entryPoint ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onDiscoveryProgress( entryPoint );
+    }
+
+    virtual void onDiscoveryCompleted( const std::string& entryPoint ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onDiscoveryCompleted( entryPoint );
+    }
+
+    virtual void onReloadStarted( const std::string& entryPoint ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onReloadStarted( entryPoint );
+    }
+
+    virtual void onReloadCompleted( const std::string& entryPoint ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onReloadCompleted( entryPoint );
+    }
+
+    virtual void onEntryPointRemoved( const std::string& entryPoint, bool success ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onEntryPointRemoved( entryPoint, success );
+    }
+
+    virtual void onEntryPointBanned( const std::string& entryPoint, bool success ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onEntryPointBanned( entryPoint, success );
+    }
+
+    virtual void onEntryPointUnbanned( const std::string& entryPoint, bool success ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onEntryPointUnbanned( entryPoint, success );
+    }
+
+    virtual void onParsingStatsUpdated( uint32_t percent ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onParsingStatsUpdated( percent );
+    }
+
+    virtual void onBackgroundTasksIdleChanged( bool isIdle ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_ml->getCb()->onBackgroundTasksIdleChanged( isIdle );
+    }
+
+private:
+    MediaLibrary* m_ml;
+    compat::Mutex m_mutex;
+};
+
+}
+
+DiscovererWorker::Lane::Lane( DiscovererWorker* worker, std::unique_ptr<IDiscoverer> discoverer )
+    : worker( worker )
+    , discoverer( std::move( discoverer ) )
+    , runningPriority( Priority::Background )
+    , preemptible( false )
+    , busy( false )
+    , runningGlobalReload( false )
+    , interrupted( false )
+{
+}
+
+void DiscovererWorker::Lane::run()
+{
+    worker->run( *this );
+}
+
 DiscovererWorker::DiscovererWorker(MediaLibrary* ml )
-    : m_run( false )
+    : m_nbBusyLanes( 0 )
+    , m_globalReloadStarted( false )
+    , m_run( false )
     , m_ml( ml )
+    , m_cb( new SerializedCb( ml ) )
+    , m_watchesOutdated( false )
 {
 }
 
@@ -49,22 +242,39 @@ DiscovererWorker::~DiscovererWorker()
 
 void DiscovererWorker::addDiscoverer( std::unique_ptr<IDiscoverer> discoverer )
 {
-    m_discoverers.push_back( std::move( discoverer ) );
+    m_lanes.emplace_back( new Lane( this, std::move( discoverer ) ) );
+}
+
+IMediaLibraryCb* DiscovererWorker::callback() const
+{
+    return m_cb.get();
 }
 
 void DiscovererWorker::stop()
 {
+    // The watcher would otherwise keep queuing tasks
+    if ( m_watcher != nullptr )
+        m_watcher->stop();
     bool running = true;
     if ( m_run.compare_exchange_strong( running, false ) )
     {
         {
             std::unique_lock<compat::Mutex> lock( m_mutex );
-            while ( m_tasks.empty() == false )
-                m_tasks.pop();
+            for ( auto& l : m_lanes )
+            {
+                l->tasks.clear();
+                // Don't wait for the running task to complete
+                setInterrupted( *l, true );
+            }
         }
         m_cond.notify_all();
-        m_thread.join();
+        for ( auto& l : m_lanes )
+        {
+            if ( l->thread.get_id() != compat::Thread::id{} )
+                l->thread.join();
+        }
     }
+    m_watcher.reset();
 }
 
 bool DiscovererWorker::discover( const std::string& entryPoint )
@@ -72,7 +282,9 @@ bool DiscovererWorker::discover( const std::string& entryPoint )
     if ( entryPoint.length() == 0 )
         return false;
     LOG_INFO( "Adding ", entryPoint, " to the folder discovery list" );
-    enqueue( utils::file::toFolderPath( entryPoint ), Task::Type::Discover );
+    auto folderPath = utils::file::toFolderPath( entryPoint );
+    DiscoveryTask::add( m_ml, folderPath );
+    enqueue( folderPath, Task::Type::Discover );
     return true;
 }
 
@@ -81,14 +293,14 @@ void DiscovererWorker::remove( const std::string& entryPoint )
     enqueue( entryPoint, Task::Type::Remove );
 }
 
-void DiscovererWorker::reload()
+void DiscovererWorker::reload( Priority priority )
 {
-    enqueue( "", Task::Type::Reload );
+    enqueue( "", Task::Type::Reload, priority );
 }
 
-void DiscovererWorker::reload( const std::string& entryPoint )
+void DiscovererWorker::reload( const std::string& entryPoint, Priority priority )
 {
-    enqueue( utils::file::toFolderPath( entryPoint ), Task::Type::Reload );
+    enqueue( utils::file::toFolderPath( entryPoint ), Task::Type::Reload, priority );
 }
 
 void DiscovererWorker::ban( const std::string& entryPoint )
@@ -101,50 +313,219 @@ void DiscovererWorker::unban( const std::string& entryPoint )
     enqueue( utils::file::toFolderPath( entryPoint ), Task::Type::Unban );
 }
 
-void DiscovererWorker::enqueue( const std::string& entryPoint, Task::Type type )
+void DiscovererWorker::refresh( const std::string& folder, Priority priority )
+{
+    enqueue( utils::file::toFolderPath( folder ), Task::Type::Refresh, priority );
+}
+
+void DiscovererWorker::startWatcher()
+{
+    assert( m_watcher == nullptr );
+    m_watcher.reset( new FsWatcher( m_ml, this ) );
+}
+
+void DiscovererWorker::resume()
+{
+    auto tasks = DiscoveryTask::fetchAll<DiscoveryTask>( m_ml );
+    for ( const auto& t : tasks )
+    {
+        LOG_INFO( "Resuming the discovery of ", t->entryPoint() );
+        enqueue( t->entryPoint(), Task::Type::Discover );
+    }
+}
+
+void DiscovererWorker::enqueue( const std::string& entryPoint, Task::Type type,
+                                Priority priority )
 {
     std::unique_lock<compat::Mutex> lock( m_mutex );
 
+    assert( m_lanes.empty() == false );
+    if ( m_lanes.empty() == true )
+        return;
     LOG_INFO( "Queuing entrypoint ", entryPoint, " of type ",
-              static_cast<typename std::underlying_type<Task::Type>::type>( type ) );
-    m_tasks.emplace( entryPoint, type );
-    if ( m_thread.get_id() == compat::Thread::id{} )
+              static_cast<typename std::underlying_type<Task::Type>::type>( type ),
+              " with priority ",
+              static_cast<typename std::underlying_type<Priority>::type>( priority ) );
+    // Each discoverer reloads the folders it handles
+    if ( type == Task::Type::Reload && entryPoint.empty() == true )
+    {
+        for ( auto& l : m_lanes )
+            enqueue( *l, Task( entryPoint, type, priority ) );
+    }
+    else
+        enqueue( laneForMrl( entryPoint ), Task( entryPoint, type, priority ) );
+    m_cond.notify_all();
+}
+
+void DiscovererWorker::enqueue( Lane& lane, Task task )
+{
+    auto priority = task.priority;
+    if ( coalesce( lane.tasks, task ) == true )
+        LOG_INFO( "Entrypoint ", task.entryPoint, " is already covered by a queued task" );
+    else
+        insert( lane.tasks, std::move( task ), false );
+    if ( lane.thread.get_id() == compat::Thread::id{} )
     {
         m_run = true;
-        m_thread = compat::Thread( &DiscovererWorker::run, this );
+        setInterrupted( lane, false );
+        lane.thread = compat::Thread( &Lane::run, &lane );
+        return;
+    }
+    if ( lane.preemptible == true && priority > lane.runningPriority &&
+         lane.interrupted == false )
+    {
+        LOG_INFO( "Interrupting the running task in favor of a more important one" );
+        setInterrupted( lane, true );
     }
-    // Since we just added an element, let's not check for size == 0 :)
-    else if ( m_tasks.size() == 1 )
-        m_cond.notify_all();
 }
 
-void DiscovererWorker::run()
+DiscovererWorker::Lane& DiscovererWorker::laneForMrl( const std::string& mrl )
+{
+    for ( auto& l : m_lanes )
+    {
+        if ( l->discoverer->isMrlSupported( mrl ) == true )
+            return *l;
+    }
+    return *m_lanes.front();
+}
+
+bool DiscovererWorker::coalesce( std::deque<Task>& tasks, Task& task )
+{
+    // A task is covered by an identical one, and a reload covers the reloads
+    // of its subfolders. It doesn't cover their refreshes though, as it
+    // still skips the folders whose modification date didn't change.
+    auto covers = []( const Task& t, const Task& other ) {
+        if ( t.type == other.type && t.entryPoint == other.entryPoint )
+            return true;
+        return t.type == Task::Type::Reload && other.type == Task::Type::Reload &&
+                isSubfolder( t.entryPoint, other.entryPoint );
+    };
+    // Don't merge tasks across a task which changes the set of known folders,
+    // as this would change the outcome
+    auto first = std::find_if( tasks.rbegin(), tasks.rend(), []( const Task& t ) {
+        return t.type == Task::Type::Remove || t.type == Task::Type::Ban ||
+                t.type == Task::Type::Unban;
+    }).base();
+    for ( auto it = first; it != end( tasks ); ++it )
+    {
+        if ( covers( *it, task ) == false )
+            continue;
+        if ( it->priority >= task.priority )
+        {
+            merge( *it, task );
+            return true;
+        }
+        if ( it->type == task.type && it->entryPoint == task.entryPoint )
+        {
+            auto t = std::move( *it );
+            tasks.erase( it );
+            t.priority = task.priority;
+            merge( t, task );
+            insert( tasks, std::move( t ), false );
+            return true;
+        }
+    }
+    // Drop the less important reloads this one covers. The resumed ones need
+    // to run in order to notify their completion.
+    if ( task.type == Task::Type::Reload )
+    {
+        auto it = std::stable_partition( first, end( tasks ), [&task, &covers]( const Task& t ) {
+            return t.resumed == true || t.priority > task.priority || covers( task, t ) == false;
+        });
+        for ( auto mergedIt = it; mergedIt != end( tasks ); ++mergedIt )
+            merge( task, *mergedIt );
+        tasks.erase( it, end( tasks ) );
+    }
+    return false;
+}
+
+void DiscovererWorker::merge( Task& task, Task& mergedTask )
+{
+    // The global reload completion is tracked across the lanes
+    if ( mergedTask.entryPoint.empty() == false )
+        task.merged.push_back( mergedTask.entryPoint );
+    std::move( begin( mergedTask.merged ), end( mergedTask.merged ),
+               std::back_inserter( task.merged ) );
+    mergedTask.merged.clear();
+}
+
+void DiscovererWorker::insert( std::deque<Task>& tasks, Task task, bool front )
+{
+    auto it = std::find_if( begin( tasks ), end( tasks ), [&task, front]( const Task& t ) {
+        return front == true ? t.priority <= task.priority : t.priority < task.priority;
+    });
+    tasks.insert( it, std::move( task ) );
+}
+
+void DiscovererWorker::setInterrupted( Lane& lane, bool interrupted )
+{
+    lane.interrupted = interrupted;
+    lane.discoverer->setInterrupted( interrupted );
+}
+
+void DiscovererWorker::setBusy( Lane& lane, bool busy )
+{
+    if ( lane.busy == busy )
+        return;
+    lane.busy = busy;
+    if ( busy == true )
+    {
+        if ( m_nbBusyLanes++ == 0 )
+            m_ml->onDiscovererIdleChanged( false );
+    }
+    else if ( --m_nbBusyLanes == 0 )
+        m_ml->onDiscovererIdleChanged( true );
+}
+
+bool DiscovererWorker::hasGlobalReload() const
+{
+    for ( const auto& l : m_lanes )
+    {
+        if ( l->runningGlobalReload == true )
+            return true;
+        auto it = std::find_if( begin( l->tasks ), end( l->tasks ), []( const Task& t ) {
+            return t.type == Task::Type::Reload && t.entryPoint.empty() == true;
+        });
+        if ( it != end( l->tasks ) )
+            return true;
+    }
+    return false;
+}
+
+void DiscovererWorker::run( Lane& lane )
 {
     LOG_INFO( "Entering DiscovererWorker thread" );
-    m_ml->onDiscovererIdleChanged( false );
+    utils::Governor::setBackgroundPriority();
     while ( m_run == true )
     {
         Task task;
         {
             std::unique_lock<compat::Mutex> lock( m_mutex );
-            if ( m_tasks.size() == 0 )
+            if ( lane.tasks.empty() == true )
             {
-                m_ml->onDiscovererIdleChanged( true );
-                m_cond.wait( lock, [this]() { return m_tasks.size() > 0 || m_run == false; } );
+                setBusy( lane, false );
+                m_cond.wait( lock, [this, &lane]() {
+                    return lane.tasks.empty() == false || m_run == false;
+                });
                 if ( m_run == false )
                     break;
-                m_ml->onDiscovererIdleChanged( false );
             }
-            task = m_tasks.front();
-            m_tasks.pop();
+            setBusy( lane, true );
+            task = std::move( lane.tasks.front() );
+            lane.tasks.pop_front();
+            lane.runningPriority = task.priority;
+            lane.preemptible = task.type == Task::Type::Discover ||
+                    task.type == Task::Type::Reload ||
+                    task.type == Task::Type::Refresh;
         }
+        auto completed = true;
         switch ( task.type )
         {
         case Task::Type::Discover:
-            runDiscover( task.entryPoint );
+            completed = runDiscover( lane, task );
             break;
         case Task::Type::Reload:
-            runReload( task.entryPoint );
+            completed = runReload( lane, task );
             break;
         case Task::Type::Remove:
             runRemove( task.entryPoint );
@@ -153,36 +534,131 @@ void DiscovererWorker::run()
             runBan( task.entryPoint );
             break;
         case Task::Type::Unban:
-            runUnban( task.entryPoint );
+            runUnban( lane, task.entryPoint );
+            break;
+        case Task::Type::Refresh:
+            completed = runRefresh( lane, task );
             break;
         default:
             assert(false);
         }
+        bool idle;
+        bool globalReloadCompleted = false;
+        auto watchesOutdated = false;
+        std::set<std::string> refreshedFolders;
+        {
+            std::unique_lock<compat::Mutex> lock( m_mutex );
+            lane.preemptible = false;
+            if ( m_run == false )
+                break;
+            if ( task.type == Task::Type::Refresh )
+                m_refreshedFolders.insert( task.entryPoint );
+            else
+                m_watchesOutdated = true;
+            if ( lane.interrupted == true )
+            {
+                setInterrupted( lane, false );
+                // Run the preempted task again once the more important ones
+                // are done. The folders it already checked will be skipped.
+                if ( completed == false )
+                {
+                    task.resumed = true;
+                    insert( lane.tasks, std::move( task ), true );
+                }
+            }
+            if ( lane.runningGlobalReload == true )
+            {
+                lane.runningGlobalReload = false;
+                if ( hasGlobalReload() == false )
+                {
+                    m_globalReloadStarted = false;
+                    globalReloadCompleted = true;
+                }
+            }
+            idle = lane.tasks.empty() == true && m_nbBusyLanes == 1;
+            if ( idle == true )
+            {
+                watchesOutdated = m_watchesOutdated;
+                refreshedFolders = std::move( m_refreshedFolders );
+                m_watchesOutdated = false;
+                m_refreshedFolders.clear();
+            }
+        }
+        if ( globalReloadCompleted == true )
+            m_cb->onReloadCompleted( "" );
+        // Wait for the last pending task to refresh the watches. A full
+        // synchronization requires fetching all the folders, while a refresh
+        // only adds the folders it discovered.
+        if ( m_watcher != nullptr && idle == true )
+        {
+            if ( watchesOutdated == true )
+                m_watcher->update();
+            else
+            {
+                for ( const auto& mrl : refreshedFolders )
+                    m_watcher->update( mrl );
+            }
+        }
     }
     LOG_INFO( "Exiting DiscovererWorker thread" );
-    m_ml->onDiscovererIdleChanged( true );
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    setBusy( lane, false );
 }
 
-void DiscovererWorker::runReload( const std::string& entryPoint )
+bool DiscovererWorker::runReload( Lane& lane, const Task& task )
 {
-    m_ml->getCb()->onReloadStarted( entryPoint );
-    for ( auto& d : m_discoverers )
+    const auto& entryPoint = task.entryPoint;
+    auto notifyStart = task.resumed == false;
+    if ( entryPoint.empty() == true )
     {
-        try
-        {
-            if ( entryPoint.empty() == true )
-                d->reload();
-            else
-                d->reload( entryPoint );
-        }
-        catch(std::exception& ex)
-        {
-            LOG_ERROR( "Fatal error while reloading: ", ex.what() );
-        }
-        if ( m_run == false )
-            break;
+        // The completion is notified once all the lanes are done
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        lane.runningGlobalReload = true;
+        notifyStart = m_globalReloadStarted == false;
+        m_globalReloadStarted = true;
+    }
+    if ( notifyStart == true )
+        m_cb->onReloadStarted( entryPoint );
+    if ( task.resumed == false )
+    {
+        for ( const auto& ep : task.merged )
+            m_cb->onReloadStarted( ep );
+    }
+    try
+    {
+        if ( entryPoint.empty() == true )
+            lane.discoverer->reload();
+        else
+            lane.discoverer->reload( entryPoint );
+    }
+    catch(std::exception& ex)
+    {
+        LOG_ERROR( "Fatal error while reloading: ", ex.what() );
     }
-    m_ml->getCb()->onReloadCompleted( entryPoint );
+    if ( lane.interrupted == true )
+    {
+        LOG_INFO( "Reloading of ", entryPoint, " was interrupted" );
+        return false;
+    }
+    if ( entryPoint.empty() == false )
+        m_cb->onReloadCompleted( entryPoint );
+    for ( const auto& ep : task.merged )
+        m_cb->onReloadCompleted( ep );
+    return true;
+}
+
+bool DiscovererWorker::runRefresh( Lane& lane, const Task& task )
+{
+    const auto& folder = task.entryPoint;
+    try
+    {
+        lane.discoverer->refresh( folder );
+    }
+    catch(std::exception& ex)
+    {
+        LOG_ERROR( "Fatal error while refreshing ", folder, ": ", ex.what() );
+    }
+    return lane.interrupted == false;
 }
 
 void DiscovererWorker::runRemove( const std::string& ep )
@@ -192,7 +668,7 @@ void DiscovererWorker::runRemove( const std::string& ep )
     if ( folder == nullptr )
     {
         LOG_WARN( "Can't remove unknown entrypoint: ", entryPoint );
-        m_ml->getCb()->onEntryPointRemoved( ep, false );
+        m_cb->onEntryPointRemoved( ep, false );
         return;
     }
     // The easy case is that this folder was directly discovered. In which case, we just
@@ -206,64 +682,75 @@ void DiscovererWorker::runRemove( const std::string& ep )
         res = m_ml->deleteFolder( *folder );
     if ( res == false )
     {
-        m_ml->getCb()->onEntryPointRemoved( ep, false );
+        m_cb->onEntryPointRemoved( ep, false );
         return;
     }
     // Force a cache cleanup to avoid stalled media
     Media::clear();
-    m_ml->getCb()->onEntryPointRemoved( ep, true );
+    // Don't resume an interrupted discovery of the removed entry point
+    DiscoveryTask::remove( m_ml, entryPoint );
+    m_cb->onEntryPointRemoved( ep, true );
 }
 
 void DiscovererWorker::runBan( const std::string& entryPoint )
 {
     auto res = Folder::blacklist( m_ml, entryPoint );
-    m_ml->getCb()->onEntryPointBanned( entryPoint, res );
+    m_cb->onEntryPointBanned( entryPoint, res );
 }
 
-void DiscovererWorker::runUnban( const std::string& entryPoint )
+void DiscovererWorker::runUnban( Lane& lane, const std::string& entryPoint )
 {
     auto folder = Folder::blacklistedFolder( m_ml, entryPoint );
     if ( folder == nullptr )
     {
         LOG_WARN( "Can't unban ", entryPoint, " as it wasn't banned" );
-        m_ml->getCb()->onEntryPointUnbanned( entryPoint, false );
+        m_cb->onEntryPointUnbanned( entryPoint, false );
         return;
     }
     auto res = m_ml->deleteFolder( *folder );
-    m_ml->getCb()->onEntryPointUnbanned( entryPoint, res );
+    m_cb->onEntryPointUnbanned( entryPoint, res );
 
     auto parentPath = utils::file::parentDirectory( entryPoint );
     // If the parent folder was never added to the media library, the discoverer will reject it.
     // We could check it from here, but that would mean fetching the folder twice, which would be a waste.
-    runReload( parentPath );
+    runReload( lane, Task( parentPath, Task::Type::Reload, Priority::User ) );
 }
 
-void DiscovererWorker::runDiscover( const std::string& entryPoint )
+bool DiscovererWorker::runDiscover( Lane& lane, const Task& task )
 {
-    m_ml->getCb()->onDiscoveryStarted( entryPoint );
-    for ( auto& d : m_discoverers )
+    const auto& entryPoint = task.entryPoint;
+    if ( task.resumed == false )
     {
-        // Assume only one discoverer can handle an entrypoint.
-        try
-        {
-            auto chrono = std::chrono::steady_clock::now();
-            if ( d->discover( entryPoint ) == true )
-            {
-                auto duration = std::chrono::steady_clock::now() - chrono;
-                LOG_DEBUG( "Discovered ", entryPoint, " in ",
-                           std::chrono::duration_cast<std::chrono::microseconds>( duration ).count(), "µs" );
-                break;
-            }
-        }
-        catch(std::exception& ex)
+        m_cb->onDiscoveryStarted( entryPoint );
+        for ( const auto& ep : task.merged )
+            m_cb->onDiscoveryStarted( ep );
+    }
+    try
+    {
+        auto chrono = std::chrono::steady_clock::now();
+        if ( lane.discoverer->discover( entryPoint ) == true )
         {
-            LOG_ERROR( "Fatal error while discovering ", entryPoint, ": ", ex.what() );
+            auto duration = std::chrono::steady_clock::now() - chrono;
+            LOG_DEBUG( "Discovered ", entryPoint, " in ",
+                       std::chrono::duration_cast<std::chrono::microseconds>( duration ).count(), "µs" );
         }
-
-        if ( m_run == false )
-            break;
     }
-    m_ml->getCb()->onDiscoveryCompleted( entryPoint );
+    catch(std::exception& ex)
+    {
+        LOG_ERROR( "Fatal error while discovering ", entryPoint, ": ", ex.what() );
+    }
+    // Keep the task around, so the discovery gets resumed even if this
+    // instance doesn't run it again
+    if ( lane.interrupted == true )
+    {
+        LOG_INFO( "Discovery of ", entryPoint, " was interrupted" );
+        return false;
+    }
+    DiscoveryTask::remove( m_ml, entryPoint );
+    m_cb->onDiscoveryCompleted( entryPoint );
+    for ( const auto& ep : task.merged )
+        m_cb->onDiscoveryCompleted( ep );
+    return true;
 }
 
 }
@@ -24,8 +24,9 @@
 
 #include <atomic>
 #include "compat/ConditionVariable.h"
+#include <deque>
 #include <memory>
-#include <queue>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -36,8 +37,27 @@
 namespace medialibrary
 {
 
+class FsWatcher;
+class IMediaLibraryCb;
+
 class DiscovererWorker
 {
+public:
+    ///
+    /// Tasks are run by decreasing priority, and in the order they were
+    /// queued within the same priority.
+    ///
+    enum class Priority
+    {
+        // Periodic reloads & filesystem notifications
+        Background,
+        // A known device was plugged back
+        Device,
+        // Explicitly requested through the media library API
+        User,
+    };
+
+private:
     struct Task
     {
         enum class Type
@@ -47,13 +67,44 @@ class DiscovererWorker
             Remove,
             Ban,
             Unban,
+            Refresh,
         };
 
         Task() = default;
-        Task( const std::string& entryPoint, Type type )
-            : entryPoint( entryPoint ), type( type ) {}
+        Task( const std::string& entryPoint, Type type, Priority priority )
+            : entryPoint( entryPoint ), type( type ), priority( priority )
+            , resumed( false ) {}
         std::string entryPoint;
         Type type;
+        Priority priority;
+        // The task was preempted by a more important one, and already
+        // notified its start
+        bool resumed;
+        // The entry points of the identical or covered tasks merged into this
+        // one, whose start & completion are notified along with it
+        std::vector<std::string> merged;
+    };
+
+    ///
+    /// Each discoverer runs its tasks from its own thread, so a slow
+    /// filesystem doesn't hold back the others. The database writes are
+    /// serialized by the connection.
+    ///
+    struct Lane
+    {
+        Lane( DiscovererWorker* worker, std::unique_ptr<IDiscoverer> discoverer );
+        void run();
+
+        DiscovererWorker* worker;
+        std::unique_ptr<IDiscoverer> discoverer;
+        compat::Thread thread;
+        std::deque<Task> tasks;
+        // The priority of the running task, if it can be preempted
+        Priority runningPriority;
+        bool preemptible;
+        bool busy;
+        bool runningGlobalReload;
+        std::atomic_bool interrupted;
     };
 
 public:
@@ -61,32 +112,91 @@ public:
     ~DiscovererWorker();
     void addDiscoverer( std::unique_ptr<IDiscoverer> discoverer );
     void stop();
+    ///
+    /// \brief callback Returns the callback the discoverers must notify
+    ///
+    /// The lanes run concurrently, but the application callbacks were always
+    /// invoked from a single thread, so they are serialized by this callback.
+    ///
+    IMediaLibraryCb* callback() const;
 
     bool discover( const std::string& entryPoint );
     void remove( const std::string& entryPoint );
-    void reload();
-    void reload( const std::string& entryPoint );
+    void reload( Priority priority = Priority::User );
+    void reload( const std::string& entryPoint, Priority priority = Priority::User );
     void ban( const std::string& entryPoint );
     void unban( const std::string& entryPoint );
+    ///
+    /// \brief refresh Checks a known folder for modifications, without
+    ///                browsing its subfolders.
+    ///
+    void refresh( const std::string& folder, Priority priority = Priority::User );
+    ///
+    /// \brief startWatcher Starts monitoring the discovered folders, and
+    /// refresh them as soon as they get modified.
+    ///
+    void startWatcher();
+    ///
+    /// \brief resume Queues the discoveries which were interrupted by the
+    /// previous instance.
+    ///
+    void resume();
 
 private:
-    void enqueue( const std::string& entryPoint, Task::Type type );
-    void run();
-    void runDiscover( const std::string& entryPoint );
-    void runReload( const std::string& entryPoint );
+    void enqueue( const std::string& entryPoint, Task::Type type,
+                  Priority priority = Priority::User );
+    void enqueue( Lane& lane, Task task );
+    ///
+    /// \brief laneForMrl Returns the lane of the discoverer handling the
+    /// provided mrl, or the first one if none does.
+    ///
+    Lane& laneForMrl( const std::string& mrl );
+    ///
+    /// \brief coalesce Merges the provided task with the queued ones.
+    /// \return true if the task is already covered by a queued one, and
+    ///         doesn't need to be queued.
+    ///
+    /// The merged tasks entry points are kept by the remaining task, so the
+    /// callbacks of each request are still invoked.
+    ///
+    static bool coalesce( std::deque<Task>& tasks, Task& task );
+    static void merge( Task& task, Task& mergedTask );
+    ///
+    /// \brief insert Queues a task after all the tasks of the same or a
+    /// higher priority, or before the ones of the same priority when it
+    /// resumes a preempted task
+    ///
+    static void insert( std::deque<Task>& tasks, Task task, bool front );
+    static void setInterrupted( Lane& lane, bool interrupted );
+    void setBusy( Lane& lane, bool busy );
+    bool hasGlobalReload() const;
+    void run( Lane& lane );
+    // Those return false when the task was interrupted before its completion
+    bool runDiscover( Lane& lane, const Task& task );
+    bool runReload( Lane& lane, const Task& task );
     void runRemove( const std::string& entryPoint );
     void runBan( const std::string& entryPoint );
-    void runUnban( const std::string& entryPoint );
+    void runUnban( Lane& lane, const std::string& entryPoint );
+    bool runRefresh( Lane& lane, const Task& task );
 
 private:
 
-    compat::Thread m_thread;
-    std::queue<Task> m_tasks;
+    std::vector<std::unique_ptr<Lane>> m_lanes;
+    // The number of lanes running a task
+    unsigned int m_nbBusyLanes;
+    // A reload of all the folders is split across the lanes, but notified
+    // only once
+    bool m_globalReloadStarted;
     compat::Mutex m_mutex;
     compat::ConditionVariable m_cond;
     std::atomic_bool m_run;
-    std::vector<std::unique_ptr<IDiscoverer>> m_discoverers;
     MediaLibrary* m_ml;
+    std::unique_ptr<IMediaLibraryCb> m_cb;
+    std::unique_ptr<FsWatcher> m_watcher;
+    // The watches to update once the discoverer is idle: all of them when the
+    // set of known folders changed, otherwise only the refreshed folders
+    bool m_watchesOutdated;
+    std::set<std::string> m_refreshedFolders;
 };
 
 }
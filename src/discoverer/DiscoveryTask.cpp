@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "DiscoveryTask.h"
+
+#include "database/SqliteTools.h"
+
+namespace medialibrary
+{
+
+const std::string policy::DiscoveryTaskTable::Name = "DiscoveryTask";
+const std::string policy::DiscoveryTaskTable::PrimaryKeyColumn = "id_task";
+int64_t DiscoveryTask::* const policy::DiscoveryTaskTable::PrimaryKey = &DiscoveryTask::m_id;
+
+DiscoveryTask::DiscoveryTask( MediaLibraryPtr ml, sqlite::Row& row )
+    : m_ml( ml )
+{
+    row >> m_id
+        >> m_entryPoint;
+}
+
+int64_t DiscoveryTask::id() const
+{
+    return m_id;
+}
+
+const std::string& DiscoveryTask::entryPoint() const
+{
+    return m_entryPoint;
+}
+
+void DiscoveryTask::createTable( sqlite::Connection* dbConnection )
+{
+    const std::string req = "CREATE TABLE IF NOT EXISTS " + policy::DiscoveryTaskTable::Name + "("
+            "id_task INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "entry_point TEXT UNIQUE ON CONFLICT IGNORE"
+        ")";
+    sqlite::Tools::executeRequest( dbConnection, req );
+}
+
+void DiscoveryTask::add( MediaLibraryPtr ml, const std::string& entryPoint )
+{
+    // An entry point queued multiple times only needs to be resumed once
+    static const std::string req = "INSERT INTO " + policy::DiscoveryTaskTable::Name +
+            "(entry_point) VALUES(?)";
+    sqlite::Tools::executeRequest( ml->getConn(), req, entryPoint );
+}
+
+bool DiscoveryTask::remove( MediaLibraryPtr ml, const std::string& entryPoint )
+{
+    static const std::string req = "DELETE FROM " + policy::DiscoveryTaskTable::Name +
+            " WHERE entry_point = ?";
+    return sqlite::Tools::executeDelete( ml->getConn(), req, entryPoint );
+}
+
+}
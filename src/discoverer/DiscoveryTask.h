@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <string>
+
+#include "database/DatabaseHelpers.h"
+
+namespace medialibrary
+{
+
+class DiscoveryTask;
+
+namespace policy
+{
+struct DiscoveryTaskTable
+{
+    static const std::string Name;
+    static const std::string PrimaryKeyColumn;
+    static int64_t DiscoveryTask::*const PrimaryKey;
+};
+}
+
+///
+/// \brief The DiscoveryTask class persists the entry points queued for
+/// discovery, so a discovery interrupted by a restart gets resumed.
+///
+class DiscoveryTask : public DatabaseHelpers<DiscoveryTask, policy::DiscoveryTaskTable>
+{
+public:
+    DiscoveryTask( MediaLibraryPtr ml, sqlite::Row& row );
+
+    int64_t id() const;
+    const std::string& entryPoint() const;
+
+    static void createTable( sqlite::Connection* dbConnection );
+    static void add( MediaLibraryPtr ml, const std::string& entryPoint );
+    static bool remove( MediaLibraryPtr ml, const std::string& entryPoint );
+
+private:
+    MediaLibraryPtr m_ml;
+    int64_t m_id;
+    std::string m_entryPoint;
+
+    friend struct policy::DiscoveryTaskTable;
+};
+
+}
@@ -0,0 +1,206 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "FsCrawler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <strings.h>
+#include <system_error>
+
+#include "filesystem/IDirectory.h"
+#include "filesystem/IFile.h"
+#include "logging/Logger.h"
+#include "utils/Governor.h"
+
+namespace medialibrary
+{
+
+FsCrawler::FsCrawler( unsigned int nbThreads, utils::Governor* governor )
+    : m_governor( governor )
+    , m_queues( nbThreads )
+    , m_nbPending( 0 )
+    , m_nbActive( 0 )
+    , m_cancelled( false )
+    , m_stop( false )
+    , m_nextThreadIdx( 0 )
+    , m_interrupted( false )
+{
+    assert( nbThreads > 0 );
+    for ( auto i = 0u; i < nbThreads; ++i )
+        m_threads.emplace_back( &FsCrawler::run, this );
+}
+
+FsCrawler::~FsCrawler()
+{
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_stop = true;
+    }
+    m_interrupted = true;
+    m_workCond.notify_all();
+    for ( auto& t : m_threads )
+        t.join();
+}
+
+void FsCrawler::crawl( DirPtr root )
+{
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        assert( m_nbPending == 0 && m_nbActive == 0 );
+        m_cancelled = false;
+        m_interrupted = false;
+        m_listed.clear();
+        m_listed.emplace( root.get(), false );
+        m_queues[0].push_back( std::move( root ) );
+        m_nbPending = 1;
+    }
+    m_workCond.notify_one();
+}
+
+void FsCrawler::wait( const fs::IDirectory& dir )
+{
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    m_listedCond.wait( lock, [this, &dir]() {
+        auto it = m_listed.find( &dir );
+        return it == end( m_listed ) || it->second == true;
+    });
+}
+
+void FsCrawler::stop()
+{
+    m_interrupted = true;
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    m_cancelled = true;
+    for ( auto& q : m_queues )
+        q.clear();
+    m_nbPending = 0;
+    // The directories being listed can't be interrupted, but we need to wait
+    // for them, since the caller is likely to release them afterward
+    m_listedCond.wait( lock, [this]() {
+        return m_nbActive == 0;
+    });
+    m_listed.clear();
+}
+
+void FsCrawler::run()
+{
+    utils::Governor::setBackgroundPriority();
+    auto idx = m_nextThreadIdx++;
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    while ( m_stop == false )
+    {
+        DirPtr dir;
+        if ( pop( idx, dir ) == false )
+        {
+            m_workCond.wait( lock, [this]() {
+                return m_nbPending > 0 || m_stop == true;
+            });
+            continue;
+        }
+        --m_nbPending;
+        ++m_nbActive;
+        lock.unlock();
+
+        std::vector<DirPtr> subFolders;
+        // When interrupted, leave the listing to the discoverer
+        auto descend = false;
+        if ( m_governor == nullptr || m_governor->acquire( &m_interrupted ) == true )
+            descend = list( *dir, subFolders );
+
+        lock.lock();
+        --m_nbActive;
+        // Register the subfolders while flagging the parent as listed, so the
+        // discoverer can't reach a subfolder before we know about it.
+        m_listed[dir.get()] = true;
+        if ( m_cancelled == false && descend == true && subFolders.empty() == false )
+        {
+            auto& queue = m_queues[idx];
+            // Push in reverse order, so that popping from the back follows
+            // the same order as the discoverer
+            for ( auto it = subFolders.rbegin(); it != subFolders.rend(); ++it )
+            {
+                m_listed.emplace( it->get(), false );
+                queue.push_back( std::move( *it ) );
+            }
+            m_nbPending += subFolders.size();
+            m_workCond.notify_all();
+        }
+        m_listedCond.notify_all();
+    }
+}
+
+bool FsCrawler::pop( unsigned int idx, DirPtr& dir )
+{
+    auto& queue = m_queues[idx];
+    if ( queue.empty() == false )
+    {
+        dir = std::move( queue.back() );
+        queue.pop_back();
+        return true;
+    }
+    // Steal the shallowest directory from another crawler, as it's the most
+    // likely to have a large subtree
+    for ( auto i = 1u; i < m_queues.size(); ++i )
+    {
+        auto& victim = m_queues[( idx + i ) % m_queues.size()];
+        if ( victim.empty() == true )
+            continue;
+        dir = std::move( victim.front() );
+        victim.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool FsCrawler::list( fs::IDirectory& dir, std::vector<DirPtr>& subFolders )
+{
+    try
+    {
+        const auto& files = dir.files();
+        // Don't bother listing folders which will be ignored by default.
+        // Should the discoverer want to browse them anyway, it will list them
+        // by itself.
+        auto hidden = std::find_if( begin( files ), end( files ), []( const std::shared_ptr<fs::IFile>& f ) {
+            return strcasecmp( f->name().c_str(), ".nomedia" ) == 0;
+        }) != end( files );
+        if ( hidden == true )
+            return false;
+        subFolders = dir.dirs();
+        if ( m_governor != nullptr )
+            m_governor->charge( 1 + files.size() + subFolders.size() );
+        return true;
+    }
+    catch ( const std::system_error& ex )
+    {
+        // The discoverer will list this folder again, and handle the error
+        LOG_INFO( "Failed to prefetch ", dir.mrl(), ": ", ex.what() );
+    }
+    return false;
+}
+
+}
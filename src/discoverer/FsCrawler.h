@@ -0,0 +1,110 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
+
+namespace medialibrary
+{
+
+namespace fs
+{
+class IDirectory;
+}
+
+namespace utils
+{
+class Governor;
+}
+
+///
+/// \brief The FsCrawler class prefetches directory listings using a pool of
+/// threads, so that the filesystem I/O happens ahead of the discoverer thread.
+///
+/// The crawler never touches the database: FsDiscoverer stays the only writer
+/// and keeps processing folders in its usual depth-first order. Before accessing
+/// a directory, it must call wait(), which returns once the directory has been
+/// listed by a crawler thread, or immediately if the directory isn't handled by
+/// the crawler.
+/// Each thread owns a deque of directories: it pushes the subfolders it finds at
+/// the back and pops from the back, while idle threads steal from the front of
+/// other threads' deques.
+/// Each listing is accounted to the provided governor, if any.
+///
+class FsCrawler
+{
+    using DirPtr = std::shared_ptr<fs::IDirectory>;
+
+public:
+    FsCrawler( unsigned int nbThreads, utils::Governor* governor );
+    ~FsCrawler();
+
+    ///
+    /// \brief crawl Starts listing the provided directory and all its subfolders
+    /// \note Any previous crawl must have been stopped first.
+    ///
+    void crawl( DirPtr root );
+    ///
+    /// \brief wait Blocks until the provided directory is safe to be accessed
+    /// from the calling thread.
+    ///
+    void wait( const fs::IDirectory& dir );
+    ///
+    /// \brief stop Discards the remaining directories and waits for the
+    /// listings currently in progress to complete.
+    ///
+    void stop();
+
+private:
+    void run();
+    bool pop( unsigned int idx, DirPtr& dir );
+    bool list( fs::IDirectory& dir, std::vector<DirPtr>& subFolders );
+
+private:
+    utils::Governor* m_governor;
+    std::vector<compat::Thread> m_threads;
+    std::vector<std::deque<DirPtr>> m_queues;
+    // Directories scheduled by the crawler. The value is true once the
+    // directory has been listed
+    std::unordered_map<const fs::IDirectory*, bool> m_listed;
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_workCond;
+    compat::ConditionVariable m_listedCond;
+    unsigned int m_nbPending;
+    unsigned int m_nbActive;
+    bool m_cancelled;
+    bool m_stop;
+    std::atomic_uint m_nextThreadIdx;
+    // Interrupts the threads waiting for the governor
+    std::atomic_bool m_interrupted;
+};
+
+}
@@ -27,7 +27,9 @@
 #include "FsDiscoverer.h"
 
 #include <algorithm>
+#include <ctime>
 #include <queue>
+#include <unordered_map>
 #include <utility>
 
 #include "factory/FileSystemFactory.h"
@@ -36,6 +38,7 @@
 #include "File.h"
 #include "Device.h"
 #include "Folder.h"
+#include "FsCrawler.h"
 #include "logging/Logger.h"
 #include "MediaLibrary.h"
 #include "probe/CrawlerProbe.h"
@@ -53,19 +56,78 @@ public:
     }
 };
 
+// Unwinds the folder hierarchy when the worker needs the discoverer for a more
+// important task. The folders which were fully checked have their modification
+// info saved, so running the task again resumes from where it was stopped.
+class InterruptedException : public std::runtime_error
+{
+public:
+    InterruptedException() noexcept
+        : std::runtime_error( "The discovery was interrupted" )
+    {
+    }
+};
+
+// Prefetches the directories below the provided root for the lifetime of the
+// object, and discards the remaining ones when going out of scope
+class CrawlGuard
+{
+public:
+    CrawlGuard( medialibrary::FsCrawler* crawler, std::shared_ptr<medialibrary::fs::IDirectory> root )
+        : m_crawler( crawler )
+    {
+        if ( m_crawler != nullptr )
+            m_crawler->crawl( std::move( root ) );
+    }
+
+    ~CrawlGuard()
+    {
+        if ( m_crawler != nullptr )
+            m_crawler->stop();
+    }
+
+private:
+    medialibrary::FsCrawler* m_crawler;
+};
+
+// Maps each entity's mrl to its position in the provided list
+template <typename T>
+std::unordered_map<std::string, size_t> indexByMrl( const std::vector<std::shared_ptr<T>>& entities )
+{
+    std::unordered_map<std::string, size_t> index;
+    index.reserve( entities.size() );
+    for ( auto i = 0u; i < entities.size(); ++i )
+        index.emplace( entities[i]->mrl(), i );
+    return index;
+}
+
+// Drops the entities which were moved out of the list after being matched,
+// leaving the unseen ones in their original order
+template <typename T>
+void removeSeen( std::vector<std::shared_ptr<T>>& entities )
+{
+    entities.erase( std::remove( begin( entities ), end( entities ), nullptr ), end( entities ) );
+}
+
 }
 
 namespace medialibrary
 {
 
-FsDiscoverer::FsDiscoverer( std::shared_ptr<factory::IFileSystem> fsFactory, MediaLibrary* ml, IMediaLibraryCb* cb, std::unique_ptr<prober::IProbe> probe )
+FsDiscoverer::FsDiscoverer( std::shared_ptr<factory::IFileSystem> fsFactory, MediaLibrary* ml, IMediaLibraryCb* cb,
+                            std::unique_ptr<prober::IProbe> probe, unsigned int nbCrawlerThreads )
     : m_ml( ml )
     , m_fsFactory( std::move( fsFactory ))
     , m_cb( cb )
     , m_probe( std::move( probe ) )
+    , m_interrupted( false )
 {
+    if ( nbCrawlerThreads > 1 )
+        m_crawler.reset( new FsCrawler( nbCrawlerThreads, &m_ml->governor() ) );
 }
 
+FsDiscoverer::~FsDiscoverer() = default;
+
 bool FsDiscoverer::discover( const std::string& entryPoint )
 {
     LOG_INFO( "Adding to discovery list: ", entryPoint );
@@ -85,16 +147,26 @@ bool FsDiscoverer::discover( const std::string& entryPoint )
     }
     auto fsDirMrl = fsDir->mrl(); // Saving MRL now since we might need it after fsDir is moved
     auto f = Folder::fromMrl( m_ml, fsDirMrl );
-    // If the folder exists, we assume it will be handled by reload()
     if ( f != nullptr )
+    {
+        // The discovery may have been interrupted. The folders which were
+        // fully checked have their modification info saved, and will be
+        // skipped, so this resumes from the folders which weren't.
+        LOG_INFO( fsDirMrl, " is already known, checking it for modifications" );
+        reloadFolder( std::move( f ), true );
+        reconcileMoves();
         return true;
+    }
     try
     {
         if ( m_probe->proceedOnDirectory( *fsDir ) == false || m_probe->isHidden( *fsDir ) == true )
             return true;
         // Fetch files explicitly
         fsDir->files();
-        return addFolder( std::move( fsDir ), m_probe->getFolderParent().get() );
+        CrawlGuard crawl( m_crawler.get(), fsDir );
+        auto res = addFolder( std::move( fsDir ), m_probe->getFolderParent().get() );
+        reconcileMoves();
+        return res;
     }
     catch ( sqlite::errors::ConstraintViolation& ex )
     {
@@ -105,10 +177,15 @@ bool FsDiscoverer::discover( const std::string& entryPoint )
         // Simply ignore, the device has already been marked as removed and the DB updated accordingly
         LOG_INFO( "Discovery of ", fsDirMrl, " was stopped after the device was removed" );
     }
+    catch ( InterruptedException& )
+    {
+        LOG_INFO( "Discovery of ", fsDirMrl, " was interrupted" );
+    }
+    reconcileMoves();
     return true;
 }
 
-void FsDiscoverer::reloadFolder( std::shared_ptr<Folder> f )
+void FsDiscoverer::reloadFolder( std::shared_ptr<Folder> f, bool recursive )
 {
     auto mrl = f->mrl();
 
@@ -118,12 +195,22 @@ void FsDiscoverer::reloadFolder( std::shared_ptr<Folder> f )
         assert( folder->device() != nullptr );
         if ( folder->device() == nullptr )
             return;
-        checkFolder( std::move( folder ), std::move( f ), false );
+        // Most local folders are expected to be unchanged, and won't be
+        // listed at all, so don't prefetch them. Network folders don't expose
+        // a modification date, and always get listed again.
+        auto crawler = recursive == true && m_fsFactory->isNetworkFileSystem() == true ?
+                    m_crawler.get() : nullptr;
+        CrawlGuard crawl( crawler, folder );
+        checkFolder( std::move( folder ), std::move( f ), false, recursive );
     }
     catch ( DeviceRemovedException& )
     {
         LOG_INFO( "Reloading of ", mrl, " was stopped after the device was removed" );
     }
+    catch ( InterruptedException& )
+    {
+        LOG_INFO( "Reloading of ", mrl, " was interrupted" );
+    }
     catch ( const std::system_error& ex )
     {
         LOG_INFO( "Failed to instanciate a directory for ", mrl, ": ", ex.what(),
@@ -136,7 +223,16 @@ bool FsDiscoverer::reload()
     LOG_INFO( "Reloading all folders" );
     auto rootFolders = Folder::fetchRootFolders( m_ml );
     for ( const auto& f : rootFolders )
-        reloadFolder( f );
+    {
+        // The other filesystems' folders are reloaded by their own discoverer
+        if ( m_fsFactory->isMrlSupported( f->mrl() ) == false )
+            continue;
+        reloadFolder( f, true );
+        if ( m_interrupted == true )
+            break;
+    }
+    // Files can be moved across entry points
+    reconcileMoves();
     return true;
 }
 
@@ -151,29 +247,79 @@ bool FsDiscoverer::reload( const std::string& entryPoint )
         LOG_ERROR( "Can't reload ", entryPoint, ": folder wasn't found in database" );
         return false;
     }
-    reloadFolder( std::move( folder ) );
+    reloadFolder( std::move( folder ), true );
+    reconcileMoves();
     return true;
 }
 
+bool FsDiscoverer::refresh( const std::string& mrl )
+{
+    if ( m_fsFactory->isMrlSupported( mrl ) == false )
+        return false;
+    LOG_INFO( "Refreshing folder ", mrl );
+    auto folder = Folder::fromMrl( m_ml, mrl );
+    if ( folder == nullptr )
+    {
+        LOG_WARN( "Can't refresh ", mrl, ": folder wasn't found in database" );
+        return false;
+    }
+    reloadFolder( std::move( folder ), false );
+    reconcileMoves();
+    return true;
+}
+
+void FsDiscoverer::setInterrupted( bool interrupted )
+{
+    m_interrupted = interrupted;
+}
+
+bool FsDiscoverer::isMrlSupported( const std::string& mrl ) const
+{
+    return m_fsFactory->isMrlSupported( mrl );
+}
+
 void FsDiscoverer::checkFolder( std::shared_ptr<fs::IDirectory> currentFolderFs,
                                 std::shared_ptr<Folder> currentFolder,
-                                bool newFolder ) const
+                                bool newFolder, bool recursive ) const
 {
+    // Let the parser catch up before adding more files to its queue. This
+    // might overshoot by the content of one folder, which is fine.
+    if ( m_interrupted == true ||
+         m_ml->waitForParserCapacity( &m_interrupted ) == false ||
+         m_ml->governor().acquire( &m_interrupted ) == false )
+        throw InterruptedException();
+    if ( m_crawler != nullptr )
+        m_crawler->wait( *currentFolderFs );
+    // Don't try to fetch any potential sub folders if the folder was freshly added
+    std::vector<std::shared_ptr<Folder>> subFoldersInDB;
+    if ( newFolder == false )
+        subFoldersInDB = currentFolder->folders();
+    unsigned int lastModificationDate = 0;
+    auto listingDate = time( nullptr );
+    bool unchanged = false;
     try
     {
-        // We already know of this folder, though it may now contain a .nomedia file.
-        // In this case, simply delete the folder.
-        if ( m_probe->isHidden( *currentFolderFs ) == true )
+        lastModificationDate = currentFolderFs->lastModificationDate();
+        // A refresh is only requested when the folder content is known to
+        // have changed, which might not be reflected by its modification date
+        if ( newFolder == false && recursive == true )
+            unchanged = isUnchanged( *currentFolder, lastModificationDate, subFoldersInDB );
+        if ( unchanged == false )
         {
-            if ( newFolder == false )
-                m_ml->deleteFolder( *currentFolder );
-            return;
+            // We already know of this folder, though it may now contain a .nomedia file.
+            // In this case, simply delete the folder.
+            if ( m_probe->isHidden( *currentFolderFs ) == true )
+            {
+                if ( newFolder == false )
+                    m_ml->deleteFolder( *currentFolder );
+                return;
+            }
+            // Ensuring that the file fetching is done in this scope, to catch errors
+            currentFolderFs->files();
         }
-        // Ensuring that the file fetching is done in this scope, to catch errors
-        currentFolderFs->files();
     }
-    // Only check once for a system_error. They are bound to happen when we list the files/folders
-    // within, and IProbe::isHidden is the first place when this is done
+    // Only check once for a system_error. They are bound to happen when we access the folder, and
+    // fetching its modification date is the first place when this is done
     catch ( std::system_error& ex )
     {
         LOG_WARN( "Failed to browse ", currentFolderFs->mrl(), ": ", ex.what() );
@@ -217,13 +363,20 @@ void FsDiscoverer::checkFolder( std::shared_ptr<fs::IDirectory> currentFolderFs,
 
     if ( m_cb != nullptr )
         m_cb->onDiscoveryProgress( currentFolderFs->mrl() );
-    // Load the folders we already know of:
+    if ( unchanged == true )
+    {
+        LOG_INFO( "Skipping unchanged folder ", currentFolderFs->mrl() );
+        checkUnchangedSubfolders( std::move( subFoldersInDB ) );
+        return;
+    }
     LOG_INFO( "Checking for modifications in ", currentFolderFs->mrl() );
-    // Don't try to fetch any potential sub folders if the folder was freshly added
-    std::vector<std::shared_ptr<Folder>> subFoldersInDB;
-    if ( newFolder == false )
-        subFoldersInDB = currentFolder->folders();
-    for ( const auto& subFolder : currentFolderFs->dirs() )
+    const auto& subFoldersFs = currentFolderFs->dirs();
+    // The crawler already accounted for the listings it performed
+    if ( m_crawler == nullptr )
+        m_ml->governor().charge( 1 + currentFolderFs->files().size() + subFoldersFs.size() );
+    // Index the known subfolders by mrl so each one is matched in constant time
+    auto subFoldersIndex = indexByMrl( subFoldersInDB );
+    for ( const auto& subFolder : subFoldersFs )
     {
         if ( subFolder->device() == nullptr )
             continue;
@@ -231,11 +384,12 @@ void FsDiscoverer::checkFolder( std::shared_ptr<fs::IDirectory> currentFolderFs,
             break;
         if ( m_probe->proceedOnDirectory( *subFolder ) == false )
             continue;
-        auto it = std::find_if( begin( subFoldersInDB ), end( subFoldersInDB ), [&subFolder](const std::shared_ptr<Folder>& f) {
-            return f->mrl() == subFolder->mrl();
-        });
+        // The probe is about to list the folder content
+        if ( m_crawler != nullptr )
+            m_crawler->wait( *subFolder );
+        auto it = subFoldersIndex.find( subFolder->mrl() );
         // We don't know this folder, it's a new one
-        if ( it == end( subFoldersInDB ) )
+        if ( it == end( subFoldersIndex ) )
         {
             if ( m_probe->isHidden( *subFolder ) )
                 continue;
@@ -259,26 +413,75 @@ void FsDiscoverer::checkFolder( std::shared_ptr<fs::IDirectory> currentFolderFs,
                 continue;
             }
         }
-        auto folderInDb = *it;
+        // Flag the folder as seen by moving it out of the list
+        auto folderInDb = std::move( subFoldersInDB[it->second] );
+        subFoldersIndex.erase( it );
         // In any case, check for modifications, as a change related to a mountpoint might
         // not update the folder modification date.
         // Also, relying on the modification date probably isn't portable
-        checkFolder( subFolder, folderInDb, false );
-        subFoldersInDB.erase( it );
+        if ( recursive == true )
+            checkFolder( subFolder, folderInDb, false, true );
     }
+    removeSeen( subFoldersInDB );
     if ( m_probe->deleteUnseenFolders() == true )
     {
         // Now all folders we had in DB but haven't seen from the FS must have been deleted.
-        for ( const auto& f : subFoldersInDB )
+        for ( auto& f : subFoldersInDB )
         {
+            if ( trackMoves() == true )
+            {
+                folderDisappeared( std::move( f ) );
+                continue;
+            }
             LOG_INFO( "Folder ", f->mrl(), " not found in FS, deleting it" );
             m_ml->deleteFolder( *f );
         }
     }
     checkFiles( currentFolderFs, currentFolder );
+    if ( m_probe->deleteUnseenFolders() == true && m_probe->forceFileRefresh() == false &&
+         m_probe->stopFileDiscovery() == false )
+    {
+        // Don't trust a date which could still change within the same second
+        // without us noticing
+        if ( lastModificationDate >= listingDate )
+            lastModificationDate = 0;
+        currentFolder->setModificationInfo( lastModificationDate, subFoldersFs.size() );
+    }
     LOG_INFO( "Done checking subfolders in ", currentFolderFs->mrl() );
 }
 
+bool FsDiscoverer::isUnchanged( const Folder& folder, unsigned int lastModificationDate,
+                                const std::vector<std::shared_ptr<Folder>>& subFoldersInDB ) const
+{
+    if ( lastModificationDate == 0 || lastModificationDate != folder.lastModificationDate() )
+        return false;
+    if ( m_probe->deleteUnseenFolders() == false || m_probe->forceFileRefresh() == true )
+        return false;
+    // An unchanged modification date means no entry was added or removed, so
+    // the subfolders we know of are all the existing ones, unless some of
+    // them weren't added to the database (hidden or banned folders)
+    return subFoldersInDB.size() == folder.nbSubfolders();
+}
+
+void FsDiscoverer::checkUnchangedSubfolders( std::vector<std::shared_ptr<Folder>> subFolders ) const
+{
+    for ( auto& f : subFolders )
+    {
+        std::shared_ptr<fs::IDirectory> folderFs;
+        try
+        {
+            folderFs = m_fsFactory->createDirectory( f->mrl() );
+        }
+        catch ( const std::system_error& ex )
+        {
+            LOG_INFO( "Failed to instanciate a directory for ", f->mrl(), ": ", ex.what(),
+                      ". Can't reload the folder." );
+            continue;
+        }
+        checkFolder( std::move( folderFs ), std::move( f ), false, true );
+    }
+}
+
 void FsDiscoverer::checkFiles( std::shared_ptr<fs::IDirectory> parentFolderFs,
                                std::shared_ptr<Folder> parentFolder ) const
 {
@@ -288,42 +491,78 @@ void FsDiscoverer::checkFiles( std::shared_ptr<fs::IDirectory> parentFolderFs,
     auto files = File::fetchAll<File>( m_ml, req, parentFolder->id() );
     std::vector<std::shared_ptr<fs::IFile>> filesToAdd;
     std::vector<std::shared_ptr<File>> filesToRemove;
+    std::vector<std::shared_ptr<fs::IFile>> newFiles;
+    // Files known before their inode was stored
+    std::vector<std::pair<std::shared_ptr<File>, int64_t>> inodesToUpdate;
+    // Matching the filesystem content against the database is done through an
+    // index, as a linear lookup per file gets quadratic on large folders
+    auto filesIndex = indexByMrl( files );
     for ( const auto& fileFs: parentFolderFs->files() )
     {
         if ( m_probe->stopFileDiscovery() == true )
             break;
         if ( m_probe->proceedOnFile( *fileFs ) == false )
             continue;
-        auto it = std::find_if( begin( files ), end( files ), [fileFs](const std::shared_ptr<File>& f) {
-            return f->mrl() == fileFs->mrl();
-        });
-        if ( it == end( files ) || m_probe->forceFileRefresh() == true )
+        auto it = filesIndex.find( fileFs->mrl() );
+        if ( it == end( filesIndex ) || m_probe->forceFileRefresh() == true )
         {
             if ( MediaLibrary::isExtensionSupported( fileFs->extension().c_str() ) == true ) {
-                filesToAdd.push_back( fileFs );
+                newFiles.push_back( fileFs );
             }
             continue;
         }
-        if ( fileFs->lastModificationDate() == (*it)->lastModificationDate() )
+        // Flag the file as seen by moving it out of the list
+        auto file = std::move( files[it->second] );
+        filesIndex.erase( it );
+        if ( fileFs->lastModificationDate() == file->lastModificationDate() )
         {
             // Unchanged file
-            files.erase( it );
+            auto inode = static_cast<int64_t>( fileFs->inode() );
+            if ( inode != 0 && inode != file->inode() )
+                inodesToUpdate.emplace_back( std::move( file ), inode );
             continue;
         }
-        auto& file = (*it);
         LOG_INFO( "Forcing file refresh ", fileFs->mrl() );
         // Pre-cache the file's media, since we need it to remove. However, better doing it
         // out of a write context, since that way, other threads can also read the database.
         file->media();
         filesToRemove.push_back( std::move( file ) );
         filesToAdd.push_back( fileFs );
-        files.erase( it );
     }
     if ( m_probe->deleteUnseenFiles() == false )
         files.clear();
+    else
+        removeSeen( files );
+    std::vector<std::pair<std::shared_ptr<File>, std::shared_ptr<fs::IFile>>> filesToMove;
+    if ( trackMoves() == true )
+    {
+        // A renamed file is both an unseen and a new one, so the unseen files
+        // must be known before looking for the new ones
+        for ( auto& f : files )
+            fileDisappeared( std::move( f ), *parentFolder );
+        files.clear();
+        for ( auto& fileFs : newFiles )
+        {
+            auto file = takeDisappearedFile( *fileFs, *parentFolder );
+            if ( file != nullptr )
+                filesToMove.emplace_back( std::move( file ), std::move( fileFs ) );
+            // The file it was moved from may be in a folder we haven't checked yet
+            else if ( fileFs->size() != 0 &&
+                      File::exists( m_ml, parentFolder->deviceId(), fileFs->size(),
+                                    fileFs->lastModificationDate(),
+                                    static_cast<int64_t>( fileFs->inode() ) ) == true )
+                m_appearedFiles.push_back( AppearedFile{ std::move( fileFs ), parentFolder, parentFolderFs } );
+            else
+                filesToAdd.push_back( std::move( fileFs ) );
+        }
+    }
+    else
+        filesToAdd.insert( end( filesToAdd ), begin( newFiles ), end( newFiles ) );
     using FilesT = decltype( files );
     using FilesToRemoveT = decltype( filesToRemove );
     using FilesToAddT = decltype( filesToAdd );
+    using FilesToMoveT = decltype( filesToMove );
+    using InodesToUpdateT = decltype( inodesToUpdate );
 
     // Fix 'Disk I/O error (6410)' when deleting a lot of rows in transaction.
     // For yet unknown reason this error started to appear on childMedia->destroy() call after some number of deletes.
@@ -333,31 +572,13 @@ void FsDiscoverer::checkFiles( std::shared_ptr<fs::IDirectory> parentFolderFs,
     sqlite::Tools::executeRequest(m_ml->getConn(), "PRAGMA journal_mode = MEMORY");
 
     sqlite::Tools::withRetries( 3, [this, &parentFolder, &parentFolderFs]
-                            ( FilesT files, FilesToAddT filesToAdd, FilesToRemoveT filesToRemove ) {
+                            ( FilesT files, FilesToAddT filesToAdd, FilesToRemoveT filesToRemove,
+                              FilesToMoveT filesToMove, InodesToUpdateT inodesToUpdate ) {
         auto t = m_ml->getConn()->newTransaction();
+        for ( const auto& p : inodesToUpdate )
+            p.first->setInode( p.second );
         for ( const auto& file : files )
-        {
-            LOG_INFO( "File ", file->mrl(), " not found on filesystem, deleting it" );
-            auto media = file->media();
-            if ( media != nullptr && media->isDeleted() == false ) {
-                media->removeFile( *file );
-
-                if( media->type() == IMedia::Type::TransportFile ) {
-                    // delete media children (p2p items)
-                    for ( const auto& childMedia: media->children() ) {
-                        LOG_INFO( "checkFiles:remove_missing: delete child: id=", childMedia->id(), " p2p=", childMedia->isP2P() );
-                        childMedia->destroy();
-                    }
-                }
-            }
-            else if ( file->isDeleted() == false )
-            {
-                // This is unexpected, as the file should have been deleted when the media was
-                // removed.
-                LOG_WARN( "Deleting a file without an associated media." );
-                file->destroy();
-            }
-        }
+            removeFile( *file );
         for ( auto& f : filesToRemove )
         {
             if ( f->type() == IFile::Type::Playlist )
@@ -376,12 +597,165 @@ void FsDiscoverer::checkFiles( std::shared_ptr<fs::IDirectory> parentFolderFs,
                 assert( f->isDeleted() );
             }
         }
+        for ( const auto& p : filesToMove )
+            moveFile( *p.first, *p.second, *parentFolder );
         // Insert all files at once to avoid SQL write contention
         for ( auto& p : filesToAdd )
             m_ml->addDiscoveredFile( p, parentFolder, parentFolderFs, m_probe->getPlaylistParent() );
         t->commit();
         LOG_INFO( "Done checking files in ", parentFolderFs->mrl() );
-    }, std::move( files ), std::move( filesToAdd ), std::move( filesToRemove ) );
+    }, std::move( files ), std::move( filesToAdd ), std::move( filesToRemove ),
+       std::move( filesToMove ), std::move( inodesToUpdate ) );
+}
+
+void FsDiscoverer::removeFile( File& file ) const
+{
+    LOG_INFO( "File ", file.mrl(), " not found on filesystem, deleting it" );
+    auto media = file.media();
+    if ( media != nullptr && media->isDeleted() == false ) {
+        media->removeFile( file );
+
+        if( media->type() == IMedia::Type::TransportFile ) {
+            // delete media children (p2p items)
+            for ( const auto& childMedia: media->children() ) {
+                LOG_INFO( "checkFiles:remove_missing: delete child: id=", childMedia->id(), " p2p=", childMedia->isP2P() );
+                childMedia->destroy();
+            }
+        }
+    }
+    else if ( file.isDeleted() == false )
+    {
+        // This is unexpected, as the file should have been deleted when the media was
+        // removed.
+        LOG_WARN( "Deleting a file without an associated media." );
+        file.destroy();
+    }
+}
+
+bool FsDiscoverer::trackMoves() const
+{
+    return m_probe->deleteUnseenFiles() == true && m_probe->forceFileRefresh() == false;
+}
+
+void FsDiscoverer::fileDisappeared( std::shared_ptr<File> file, const Folder& folder ) const
+{
+    MoveKey key{ folder.deviceId(), file->size(), file->lastModificationDate() };
+    m_disappearedFiles.emplace( std::move( key ), DisappearedFile{ std::move( file ), false } );
+}
+
+void FsDiscoverer::folderDisappeared( std::shared_ptr<Folder> folder ) const
+{
+    // The folder content may have been moved elsewhere along with the folder
+    std::vector<std::shared_ptr<Folder>> folders{ folder };
+    while ( folders.empty() == false )
+    {
+        auto f = std::move( folders.back() );
+        folders.pop_back();
+        for ( auto& file : f->files() )
+        {
+            MoveKey key{ f->deviceId(), file->size(), file->lastModificationDate() };
+            m_disappearedFiles.emplace( std::move( key ), DisappearedFile{ std::move( file ), true } );
+        }
+        for ( auto& subFolder : f->folders() )
+            folders.push_back( std::move( subFolder ) );
+    }
+    m_disappearedFolders.push_back( std::move( folder ) );
+}
+
+std::shared_ptr<File> FsDiscoverer::takeDisappearedFile( const fs::IFile& fileFs, const Folder& folder ) const
+{
+    // An unknown size isn't enough to identify a file
+    if ( fileFs.size() == 0 )
+        return nullptr;
+    auto range = m_disappearedFiles.equal_range(
+                MoveKey{ folder.deviceId(), fileFs.size(), fileFs.lastModificationDate() } );
+    if ( range.first == range.second )
+        return nullptr;
+    // Only computed if a candidate doesn't have an inode
+    int64_t hash = 0;
+    auto isSameFile = [&fileFs, &hash]( const File& file ) {
+        auto inode = static_cast<int64_t>( fileFs.inode() );
+        if ( inode != 0 && file.inode() != 0 )
+            return inode == file.inode();
+        if ( file.contentHash() == 0 )
+            return false;
+        if ( hash == 0 )
+            hash = File::contentHash( fileFs );
+        return hash == file.contentHash();
+    };
+    // Files are more likely to be moved than renamed, so favor a file with the
+    // same name when there are multiple candidates
+    auto match = range.second;
+    for ( auto it = range.first; it != range.second; ++it )
+    {
+        if ( isSameFile( *it->second.file ) == false )
+            continue;
+        if ( match == range.second )
+            match = it;
+        if ( utils::file::fileName( it->second.file->mrl() ) == fileFs.name() )
+        {
+            match = it;
+            break;
+        }
+    }
+    if ( match == range.second )
+        return nullptr;
+    auto file = std::move( match->second.file );
+    m_disappearedFiles.erase( match );
+    return file;
+}
+
+void FsDiscoverer::moveFile( File& file, const fs::IFile& fileFs, const Folder& folder ) const
+{
+    LOG_INFO( "File ", file.mrl(), " was moved to ", fileFs.mrl() );
+    if ( file.move( fileFs, folder.id() ) == false )
+        return;
+    auto media = file.media();
+    if ( media != nullptr )
+        media->setFileName( fileFs.name() );
+}
+
+void FsDiscoverer::reconcileMoves() const
+{
+    if ( m_disappearedFiles.empty() == true && m_disappearedFolders.empty() == true &&
+         m_appearedFiles.empty() == true )
+        return;
+    std::vector<std::pair<std::shared_ptr<File>, AppearedFile>> filesToMove;
+    std::vector<AppearedFile> filesToAdd;
+    for ( auto& f : m_appearedFiles )
+    {
+        auto file = takeDisappearedFile( *f.fileFs, *f.folder );
+        if ( file != nullptr )
+            filesToMove.emplace_back( std::move( file ), std::move( f ) );
+        else
+            filesToAdd.push_back( std::move( f ) );
+    }
+    auto disappearedFiles = std::move( m_disappearedFiles );
+    auto disappearedFolders = std::move( m_disappearedFolders );
+    m_disappearedFiles.clear();
+    m_disappearedFolders.clear();
+    m_appearedFiles.clear();
+
+    sqlite::Tools::withRetries( 3, [this, &filesToMove, &filesToAdd, &disappearedFiles, &disappearedFolders]() {
+        auto t = m_ml->getConn()->newTransaction();
+        // Move the files first, so they don't get removed along with their
+        // previous folder
+        for ( const auto& p : filesToMove )
+            moveFile( *p.first, *p.second.fileFs, *p.second.folder );
+        for ( const auto& f : filesToAdd )
+            m_ml->addDiscoveredFile( f.fileFs, f.folder, f.folderFs, m_probe->getPlaylistParent() );
+        for ( const auto& p : disappearedFiles )
+        {
+            if ( p.second.inDisappearedFolder == false )
+                removeFile( *p.second.file );
+        }
+        for ( const auto& f : disappearedFolders )
+        {
+            LOG_INFO( "Folder ", f->mrl(), " not found in FS, deleting it" );
+            m_ml->deleteFolder( *f );
+        }
+        t->commit();
+    });
 }
 
 bool FsDiscoverer::addFolder( std::shared_ptr<fs::IDirectory> folder,
@@ -409,7 +783,7 @@ bool FsDiscoverer::addFolder( std::shared_ptr<fs::IDirectory> folder,
                              *device, *deviceFs );
     if ( f == nullptr )
         return false;
-    checkFolder( std::move( folder ), std::move( f ), true );
+    checkFolder( std::move( folder ), std::move( f ), true, true );
     return true;
 }
 
@@ -22,7 +22,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <tuple>
+#include <vector>
 
 #include "discoverer/IDiscoverer.h"
 #include "factory/IFileSystem.h"
@@ -31,7 +35,9 @@ namespace medialibrary
 {
 
 class MediaLibrary;
+class File;
 class Folder;
+class FsCrawler;
 
 namespace prober
 {
@@ -41,10 +47,20 @@ class IProbe;
 class FsDiscoverer : public IDiscoverer
 {
 public:
-    FsDiscoverer( std::shared_ptr<factory::IFileSystem> fsFactory, MediaLibrary* ml , IMediaLibraryCb* cb, std::unique_ptr<prober::IProbe> probe );
+    ///
+    /// \param nbCrawlerThreads The number of threads used to prefetch the
+    ///                         directory listings. 1 disables the prefetching,
+    ///                         and browses the folders from the discoverer thread
+    ///
+    FsDiscoverer( std::shared_ptr<factory::IFileSystem> fsFactory, MediaLibrary* ml , IMediaLibraryCb* cb,
+                  std::unique_ptr<prober::IProbe> probe, unsigned int nbCrawlerThreads = 1 );
+    virtual ~FsDiscoverer();
     virtual bool discover(const std::string& entryPoint ) override;
     virtual bool reload() override;
     virtual bool reload( const std::string& entryPoint ) override;
+    virtual bool refresh( const std::string& folder ) override;
+    virtual void setInterrupted( bool interrupted ) override;
+    virtual bool isMrlSupported( const std::string& mrl ) const override;
 
 private:
     ///
@@ -52,18 +68,73 @@ private:
     /// \return true if files in this folder needs to be listed, false otherwise
     ///
     void checkFolder( std::shared_ptr<fs::IDirectory> currentFolderFs,
-                      std::shared_ptr<Folder> currentFolder, bool newFolder ) const;
+                      std::shared_ptr<Folder> currentFolder, bool newFolder,
+                      bool recursive ) const;
+    ///
+    /// \brief isUnchanged Uses the folder modification date to check if its
+    /// content needs to be listed again.
+    /// When it doesn't, its files are not checked, and the subfolders are
+    /// fetched from the database instead.
+    ///
+    bool isUnchanged( const Folder& folder, unsigned int lastModificationDate,
+                      const std::vector<std::shared_ptr<Folder>>& subFoldersInDB ) const;
+    void checkUnchangedSubfolders( std::vector<std::shared_ptr<Folder>> subFolders ) const;
     void checkFiles( std::shared_ptr<fs::IDirectory> parentFolderFs,
                      std::shared_ptr<Folder> parentFolder ) const;
     bool addFolder( std::shared_ptr<fs::IDirectory> folder,
                     Folder* parentFolder ) const;
-    void reloadFolder( std::shared_ptr<Folder> folder );
+    void reloadFolder( std::shared_ptr<Folder> folder, bool recursive );
+    void removeFile( File& file ) const;
+
+    ///
+    /// Files which disappeared from their folder aren't removed right away,
+    /// but at the end of the discovery run, as they may reappear in another
+    /// folder of the same device. In this case, they are moved in place,
+    /// which preserves the media and everything linked to it.
+    /// The candidates sharing the same device, size and modification date
+    /// must also have the same inode, or the same content hash when either
+    /// inode is unknown.
+    ///
+    bool trackMoves() const;
+    void fileDisappeared( std::shared_ptr<File> file, const Folder& folder ) const;
+    void folderDisappeared( std::shared_ptr<Folder> folder ) const;
+    std::shared_ptr<File> takeDisappearedFile( const fs::IFile& fileFs, const Folder& folder ) const;
+    void moveFile( File& file, const fs::IFile& fileFs, const Folder& folder ) const;
+    ///
+    /// \brief reconcileMoves Moves the files which reappeared during the run,
+    /// and removes the ones which didn't.
+    ///
+    void reconcileMoves() const;
 
 private:
+    // (device id, size, last modification date)
+    using MoveKey = std::tuple<int64_t, unsigned int, unsigned int>;
+
+    struct DisappearedFile
+    {
+        std::shared_ptr<File> file;
+        // The file will be removed along with its folder
+        bool inDisappearedFolder;
+    };
+
+    struct AppearedFile
+    {
+        std::shared_ptr<fs::IFile> fileFs;
+        std::shared_ptr<Folder> folder;
+        std::shared_ptr<fs::IDirectory> folderFs;
+    };
+
     MediaLibrary* m_ml;
     std::shared_ptr<factory::IFileSystem> m_fsFactory;
     IMediaLibraryCb* m_cb;
     std::unique_ptr<prober::IProbe> m_probe;
+    std::unique_ptr<FsCrawler> m_crawler;
+    std::atomic_bool m_interrupted;
+    mutable std::multimap<MoveKey, DisappearedFile> m_disappearedFiles;
+    mutable std::vector<std::shared_ptr<Folder>> m_disappearedFolders;
+    // New files which may be moved ones, whose addition is delayed until the
+    // end of the run
+    mutable std::vector<AppearedFile> m_appearedFiles;
 };
 
 }
@@ -0,0 +1,351 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "FsWatcher.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+# include <poll.h>
+# include <sys/eventfd.h>
+# include <sys/inotify.h>
+# include <unistd.h>
+#endif
+
+#include "DiscovererWorker.h"
+#include "Folder.h"
+#include "logging/Logger.h"
+#include "MediaLibrary.h"
+#include "utils/Filename.h"
+
+namespace medialibrary
+{
+
+const std::chrono::milliseconds FsWatcher::DebounceDelay{ 500 };
+const std::chrono::seconds FsWatcher::MaxBatchDelay{ 5 };
+const std::chrono::minutes FsWatcher::FallbackReloadPeriod{ 10 };
+
+FsWatcher::FsWatcher( MediaLibrary* ml, DiscovererWorker* worker )
+    : m_ml( ml )
+    , m_worker( worker )
+    , m_stop( false )
+    , m_fallback( false )
+    , m_fd( -1 )
+    , m_wakeupFd( -1 )
+{
+#ifdef __linux__
+    m_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if ( m_fd >= 0 )
+    {
+        m_wakeupFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        if ( m_wakeupFd < 0 )
+        {
+            close( m_fd );
+            m_fd = -1;
+        }
+    }
+#endif
+    if ( m_fd < 0 )
+    {
+        LOG_WARN( "Filesystem notifications are unavailable, falling back to periodic reloads" );
+        m_fallback = true;
+    }
+    m_thread = compat::Thread( &FsWatcher::run, this );
+}
+
+FsWatcher::~FsWatcher()
+{
+    stop();
+#ifdef __linux__
+    if ( m_fd >= 0 )
+    {
+        close( m_fd );
+        close( m_wakeupFd );
+    }
+#endif
+}
+
+void FsWatcher::stop()
+{
+    bool expected = false;
+    if ( m_stop.compare_exchange_strong( expected, true ) == false )
+        return;
+    wakeUp();
+    m_thread.join();
+}
+
+void FsWatcher::update()
+{
+    if ( m_fd < 0 )
+        return;
+    static const std::string req = "SELECT * FROM " + policy::FolderTable::Name +
+            " WHERE is_blacklisted = 0 AND is_present != 0";
+    auto folders = Folder::fetchAll<Folder>( m_ml, req );
+    std::set<std::string> mrls;
+    for ( const auto& f : folders )
+    {
+        const auto& mrl = f->mrl();
+        if ( utils::file::schemeIs( "file://", mrl ) == true )
+            mrls.insert( mrl );
+    }
+
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    // Remove the watches on folders which are gone from the database. The
+    // ones deleted from the filesystem are removed by the kernel.
+    for ( auto it = begin( m_watchedMrls ); it != end( m_watchedMrls ); )
+    {
+        if ( mrls.find( it->first ) != end( mrls ) )
+        {
+            ++it;
+            continue;
+        }
+#ifdef __linux__
+        inotify_rm_watch( m_fd, it->second );
+#endif
+        m_watches.erase( it->second );
+        it = m_watchedMrls.erase( it );
+    }
+    for ( const auto& mrl : mrls )
+    {
+        if ( m_watchedMrls.find( mrl ) != end( m_watchedMrls ) )
+            continue;
+        if ( addWatch( mrl ) == false )
+            break;
+    }
+}
+
+void FsWatcher::update( const std::string& folderMrl )
+{
+    if ( m_fd < 0 || utils::file::schemeIs( "file://", folderMrl ) == false )
+        return;
+    auto folder = Folder::fromMrl( m_ml, folderMrl );
+    if ( folder == nullptr || folder->isPresent() == false )
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        auto it = m_watchedMrls.find( folderMrl );
+        if ( it == end( m_watchedMrls ) )
+            return;
+#ifdef __linux__
+        inotify_rm_watch( m_fd, it->second );
+#endif
+        m_watches.erase( it->second );
+        m_watchedMrls.erase( it );
+        return;
+    }
+    // The subfolders which are already watched were synchronized before, so
+    // only the new ones are browsed
+    std::vector<std::string> mrls{ folder->mrl() };
+    auto folders = folder->folders();
+    while ( folders.empty() == false )
+    {
+        auto f = std::move( folders.back() );
+        folders.pop_back();
+        auto mrl = f->mrl();
+        {
+            std::lock_guard<compat::Mutex> lock( m_mutex );
+            if ( m_watchedMrls.find( mrl ) != end( m_watchedMrls ) )
+                continue;
+        }
+        for ( auto& subFolder : f->folders() )
+            folders.push_back( std::move( subFolder ) );
+        mrls.push_back( std::move( mrl ) );
+    }
+
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    for ( const auto& mrl : mrls )
+    {
+        if ( m_watchedMrls.find( mrl ) != end( m_watchedMrls ) )
+            continue;
+        if ( addWatch( mrl ) == false )
+            break;
+    }
+}
+
+bool FsWatcher::addWatch( const std::string& mrl )
+{
+#ifdef __linux__
+    auto path = utils::file::toLocalPath( mrl );
+    auto wd = inotify_add_watch( m_fd, path.c_str(),
+                                 IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                 IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR );
+    if ( wd >= 0 )
+    {
+        m_watches[wd] = mrl;
+        m_watchedMrls[mrl] = wd;
+        return true;
+    }
+    if ( errno == ENOSPC )
+    {
+        if ( m_fallback == false )
+        {
+            LOG_WARN( "inotify watch limit reached, falling back to periodic reloads" );
+            m_fallback = true;
+            wakeUp();
+        }
+        return false;
+    }
+    // The folder may have been removed or made unreadable since it was discovered
+    LOG_INFO( "Failed to watch ", path, ": ", strerror( errno ) );
+    return true;
+#else
+    (void)mrl;
+    return false;
+#endif
+}
+
+void FsWatcher::run()
+{
+    LOG_INFO( "Entering FsWatcher thread" );
+    update();
+    auto nextReload = Clock::now() + FallbackReloadPeriod;
+    while ( m_stop == false )
+    {
+        auto deadline = Clock::time_point::max();
+        if ( m_pending.empty() == false )
+            deadline = std::min( m_lastEvent + DebounceDelay, m_firstEvent + MaxBatchDelay );
+        if ( m_fallback == true )
+            deadline = std::min( deadline, nextReload );
+        if ( waitForEvents( deadline ) == true )
+            readEvents();
+        if ( m_stop == true )
+            break;
+        auto now = Clock::now();
+        if ( m_pending.empty() == false &&
+             ( now >= m_lastEvent + DebounceDelay || now >= m_firstEvent + MaxBatchDelay ) )
+            flush();
+        if ( m_fallback == true && now >= nextReload )
+        {
+            LOG_INFO( "Reloading all folders" );
+            m_worker->reload( DiscovererWorker::Priority::Background );
+            nextReload = now + FallbackReloadPeriod;
+        }
+    }
+    LOG_INFO( "Exiting FsWatcher thread" );
+}
+
+bool FsWatcher::waitForEvents( Clock::time_point deadline )
+{
+#ifdef __linux__
+    if ( m_fd >= 0 )
+    {
+        int timeout = -1;
+        if ( deadline != Clock::time_point::max() )
+        {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - Clock::now() ).count();
+            timeout = remaining > 0 ? static_cast<int>( remaining ) : 0;
+        }
+        pollfd fds[] = {
+            { m_fd, POLLIN, 0 },
+            { m_wakeupFd, POLLIN, 0 },
+        };
+        if ( poll( fds, 2, timeout ) <= 0 )
+            return false;
+        if ( ( fds[1].revents & POLLIN ) != 0 )
+        {
+            eventfd_t value;
+            eventfd_read( m_wakeupFd, &value );
+        }
+        return ( fds[0].revents & POLLIN ) != 0;
+    }
+#endif
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    m_cond.wait_until( lock, deadline, [this]() {
+        return m_stop == true;
+    });
+    return false;
+}
+
+void FsWatcher::readEvents()
+{
+#ifdef __linux__
+    alignas( inotify_event ) char buffer[4096];
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    while ( true )
+    {
+        auto len = read( m_fd, buffer, sizeof( buffer ) );
+        if ( len <= 0 )
+            break;
+        for ( auto ptr = buffer; ptr < buffer + len; )
+        {
+            auto event = reinterpret_cast<const inotify_event*>( ptr );
+            ptr += sizeof( *event ) + event->len;
+            if ( ( event->mask & IN_Q_OVERFLOW ) != 0 )
+            {
+                // Some events were lost, we can't tell which folders are outdated
+                LOG_WARN( "inotify queue overflowed, reloading all folders" );
+                m_pending.clear();
+                m_worker->reload( DiscovererWorker::Priority::Background );
+                continue;
+            }
+            auto it = m_watches.find( event->wd );
+            if ( it == end( m_watches ) )
+                continue;
+            if ( ( event->mask & IN_IGNORED ) != 0 )
+            {
+                // The folder was deleted or unmounted. Its parent, if any, will
+                // receive its own event.
+                m_watchedMrls.erase( it->second );
+                m_watches.erase( it );
+                continue;
+            }
+            auto now = Clock::now();
+            if ( m_pending.empty() == true )
+                m_firstEvent = now;
+            m_lastEvent = now;
+            m_pending.insert( it->second );
+        }
+    }
+#endif
+}
+
+void FsWatcher::flush()
+{
+    LOG_INFO( "Refreshing ", m_pending.size(), " modified folder(s)" );
+    for ( const auto& mrl : m_pending )
+        m_worker->refresh( mrl, DiscovererWorker::Priority::Background );
+    m_pending.clear();
+}
+
+void FsWatcher::wakeUp()
+{
+#ifdef __linux__
+    if ( m_wakeupFd >= 0 )
+    {
+        eventfd_write( m_wakeupFd, 1 );
+        return;
+    }
+#endif
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+    }
+    m_cond.notify_all();
+}
+
+}
@@ -0,0 +1,107 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
+
+namespace medialibrary
+{
+
+class MediaLibrary;
+class DiscovererWorker;
+
+///
+/// \brief The FsWatcher class monitors the local folders known to the database,
+/// and asks the discoverer to refresh them when their content changes.
+///
+/// Events are debounced: a folder is refreshed once no event was received for
+/// DebounceDelay, or after MaxBatchDelay if it keeps changing. Only the modified
+/// folders are refreshed, not their whole hierarchy.
+/// When the system can't provide notifications (no inotify support, or the
+/// watch limit was reached), the watcher falls back to reloading all folders
+/// every FallbackReloadPeriod.
+///
+class FsWatcher
+{
+    using Clock = std::chrono::steady_clock;
+
+public:
+    FsWatcher( MediaLibrary* ml, DiscovererWorker* worker );
+    ~FsWatcher();
+    ///
+    /// \brief update Synchronizes the watched folders with the database content
+    ///
+    void update();
+    ///
+    /// \brief update Watches a refreshed folder, and the subfolders which were
+    /// discovered along with it. This doesn't fetch all the known folders.
+    ///
+    void update( const std::string& folderMrl );
+    ///
+    /// \brief stop Stops the watcher thread. No more tasks will be queued
+    /// afterward.
+    ///
+    void stop();
+
+private:
+    void run();
+    bool waitForEvents( Clock::time_point deadline );
+    void readEvents();
+    bool addWatch( const std::string& mrl );
+    void flush();
+    void wakeUp();
+
+private:
+    static const std::chrono::milliseconds DebounceDelay;
+    static const std::chrono::seconds MaxBatchDelay;
+    static const std::chrono::minutes FallbackReloadPeriod;
+
+    MediaLibrary* m_ml;
+    DiscovererWorker* m_worker;
+    compat::Thread m_thread;
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    std::atomic_bool m_stop;
+    // Set when some folders can't be monitored
+    std::atomic_bool m_fallback;
+    // The inotify instance, and the eventfd used to interrupt the watcher thread
+    int m_fd;
+    int m_wakeupFd;
+    // watch descriptor -> folder mrl, and the reverse mapping
+    std::unordered_map<int, std::string> m_watches;
+    std::unordered_map<std::string, int> m_watchedMrls;
+    // The folders waiting to be refreshed. Only used from the watcher thread
+    std::set<std::string> m_pending;
+    Clock::time_point m_firstEvent;
+    Clock::time_point m_lastEvent;
+};
+
+}
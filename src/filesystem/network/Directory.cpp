@@ -26,12 +26,17 @@
 
 #include "Directory.h"
 #include "File.h"
+#include "logging/Logger.h"
 #include "utils/Filename.h"
 #include "utils/VLCInstance.h"
 
 #include "compat/ConditionVariable.h"
 #include "compat/Mutex.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
 #include <vlcpp/vlc.hpp>
 
 namespace medialibrary
@@ -39,42 +44,132 @@ namespace medialibrary
 namespace fs
 {
 
-NetworkDirectory::NetworkDirectory( const std::string& mrl, factory::IFileSystem& fsFactory )
-    : CommonDirectory( fsFactory )
-    , m_mrl( utils::file::toFolderPath( mrl ) )
+namespace
 {
-}
 
-const std::string& NetworkDirectory::mrl() const
+const std::chrono::milliseconds MinBrowseTimeout{ 2000 };
+const std::chrono::milliseconds MaxBrowseTimeout{ 30000 };
+const unsigned int MaxBrowseAttempts = 3;
+
+// Network shares don't all answer as fast, so the timeout follows the
+// observed browsing durations instead of being fixed.
+class BrowseTimeout
 {
-    return m_mrl;
-}
+public:
+    BrowseTimeout()
+        // Starts with a 5s timeout
+        : m_average( 1250 )
+    {
+    }
 
-void NetworkDirectory::read() const
+    std::chrono::milliseconds get()
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        return std::min( std::max( m_average * 4, MinBrowseTimeout ), MaxBrowseTimeout );
+    }
+
+    void report( std::chrono::milliseconds duration )
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_average = ( m_average * 7 + duration ) / 8;
+    }
+
+private:
+    compat::Mutex m_mutex;
+    std::chrono::milliseconds m_average;
+};
+
+BrowseTimeout browseTimeout;
+
+VLC::Media::ParsedStatus browse( const std::string& mrl, std::chrono::milliseconds timeout,
+                                 std::shared_ptr<VLC::MediaList>& subItems )
 {
-    VLC::Media media( VLCInstance::get(), m_mrl, VLC::Media::FromLocation );
+    VLC::Media media( VLCInstance::get(), mrl, VLC::Media::FromLocation );
     assert( media.parsedStatus() != VLC::Media::ParsedStatus::Done );
 
     compat::Mutex mutex;
     compat::ConditionVariable cond;
-    VLC::Media::ParsedStatus res = VLC::Media::ParsedStatus::Skipped;
+    auto status = VLC::Media::ParsedStatus::Skipped;
+    bool done = false;
+    // Snapshots of the state above, taken under the lock: the callback may still
+    // fire once we gave up waiting
+    auto res = VLC::Media::ParsedStatus::Skipped;
+    bool parsed = false;
 
-    media.eventManager().onParsedChanged([&mutex, &cond, &res]( VLC::Media::ParsedStatus status) {
+    auto event = media.eventManager().onParsedChanged( [&mutex, &cond, &status, &done]( VLC::Media::ParsedStatus s ) {
         std::lock_guard<compat::Mutex> lock( mutex );
-        res = status;
+        status = s;
+        done = true;
+        cond.notify_all();
     });
+    {
+        std::unique_lock<compat::Mutex> lock( mutex );
+        if ( media.parseWithOptions( VLC::Media::ParseFlags::Network | VLC::Media::ParseFlags::Local |
+                                     VLC::Media::ParseFlags::FetchLocal | VLC::Media::ParseFlags::FetchNetwork,
+                                     static_cast<int>( timeout.count() ) ) == true )
+        {
+            // libvlc enforces the timeout, but don't rely on it to report back
+            if ( cond.wait_for( lock, timeout + std::chrono::seconds{ 1 }, [&done]() {
+                    return done == true;
+                }) == false )
+            {
+                status = VLC::Media::ParsedStatus::Timeout;
+            }
+        }
+        else
+            status = VLC::Media::ParsedStatus::Failed;
+        res = status;
+        parsed = done;
+    }
+    if ( parsed == false )
+        media.parseStop();
+    event->unregister();
+    if ( res == VLC::Media::ParsedStatus::Done )
+        subItems = media.subitems();
+    return res;
+}
 
-    std::unique_lock<compat::Mutex> lock( mutex );
-    media.parseWithOptions( VLC::Media::ParseFlags::Network | VLC::Media::ParseFlags::Local |
-                            VLC::Media::ParseFlags::FetchLocal | VLC::Media::ParseFlags::FetchNetwork, -1 );
-    bool timeout = cond.wait_for( lock, std::chrono::seconds{ 5 }, [res]() {
-        return res != VLC::Media::ParsedStatus::Skipped;
-    });
-    if ( timeout == true )
-        throw std::runtime_error( "Failed to browse network directory: Network is too slow" );
-    if ( res == VLC::Media::ParsedStatus::Failed )
-        throw std::runtime_error( "Failed to browse network directory: Unknown error" );
-    auto subItems = media.subitems();
+}
+
+NetworkDirectory::NetworkDirectory( const std::string& mrl, factory::IFileSystem& fsFactory )
+    : CommonDirectory( fsFactory )
+    , m_mrl( utils::file::toFolderPath( mrl ) )
+{
+}
+
+const std::string& NetworkDirectory::mrl() const
+{
+    return m_mrl;
+}
+
+unsigned int NetworkDirectory::lastModificationDate() const
+{
+    // Network shares are browsed through VLC, which doesn't expose this
+    return 0;
+}
+
+void NetworkDirectory::read() const
+{
+    std::shared_ptr<VLC::MediaList> subItems;
+    auto timeout = browseTimeout.get();
+    for ( auto attempt = 1u; ; ++attempt )
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto status = browse( m_mrl, timeout, subItems );
+        if ( status == VLC::Media::ParsedStatus::Done )
+        {
+            browseTimeout.report( std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      std::chrono::steady_clock::now() - start ) );
+            break;
+        }
+        if ( status != VLC::Media::ParsedStatus::Timeout )
+            throw std::runtime_error( "Failed to browse network directory: Unknown error" );
+        browseTimeout.report( timeout );
+        if ( attempt == MaxBrowseAttempts )
+            throw std::runtime_error( "Failed to browse network directory: Network is too slow" );
+        timeout = std::min( timeout * 2, MaxBrowseTimeout );
+        LOG_INFO( "Browsing ", m_mrl, " timed out, retrying with a ", timeout.count(), "ms timeout" );
+    }
     for ( auto i = 0; i < subItems->count(); ++i )
     {
         auto m = subItems->itemAtIndex( i );
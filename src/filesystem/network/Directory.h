@@ -31,6 +31,7 @@ class NetworkDirectory : public CommonDirectory
 public:
     NetworkDirectory(const std::string& mrl, factory::IFileSystem& fsFactory );
     virtual const std::string& mrl() const override;
+    virtual unsigned int lastModificationDate() const override;
 
 private:
     virtual void read() const override;
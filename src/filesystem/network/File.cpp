@@ -46,5 +46,10 @@ unsigned int NetworkFile::size() const
     return 0;
 }
 
+uint64_t NetworkFile::inode() const
+{
+    return 0;
+}
+
 }
 }
@@ -34,6 +34,7 @@ public:
     NetworkFile( const std::string& mrl );
     virtual unsigned int lastModificationDate() const override;
     virtual unsigned int size() const override;
+    virtual uint64_t inode() const override;
 };
 }
 }
@@ -29,7 +29,12 @@
 #include "utils/Filename.h"
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
 #include <mntent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <vector>
 #include <memory>
@@ -37,6 +42,7 @@
 #include <sstream>
 #include <cstdio>
 #include <algorithm>
+#include <cassert>
 #include <cstring>
 #include <limits.h>
 #include <unistd.h>
@@ -46,6 +52,21 @@ namespace medialibrary
 namespace fs
 {
 
+DeviceLister::DeviceLister()
+    : m_mountinfoFd( -1 )
+    , m_ueventFd( -1 )
+    , m_wakeupFd( -1 )
+    , m_cb( nullptr )
+    , m_cached( false )
+    , m_monitoring( false )
+{
+}
+
+DeviceLister::~DeviceLister()
+{
+    stop();
+}
+
 DeviceLister::DeviceMap DeviceLister::listDevices() const
 {
     static const std::vector<std::string> deviceBlacklist = { "loop" };
@@ -198,9 +219,9 @@ bool DeviceLister::isRemovable( const std::string& deviceName, const std::string
     return false;
 }
 
-std::vector<std::tuple<std::string, std::string, bool>> DeviceLister::devices() const
+DeviceLister::DeviceList DeviceLister::readDevices() const
 {
-    std::vector<std::tuple<std::string, std::string, bool>> res;
+    DeviceList res;
     try
     {
         DeviceMap mountpoints = listMountpoints();
@@ -270,5 +291,174 @@ std::vector<std::tuple<std::string, std::string, bool>> DeviceLister::devices()
     return res;
 }
 
+DeviceLister::DeviceList DeviceLister::devices() const
+{
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    if ( m_cached == false )
+    {
+        m_devices = readDevices();
+        m_cached = m_monitoring;
+    }
+    return m_devices;
+}
+
+bool DeviceLister::start( IDeviceListerCb* cb )
+{
+    assert( m_thread.get_id() == compat::Thread::id{} );
+    m_mountinfoFd = open( "/proc/self/mountinfo", O_RDONLY | O_CLOEXEC );
+    if ( m_mountinfoFd < 0 )
+    {
+        LOG_WARN( "Failed to open /proc/self/mountinfo: ", strerror( errno ),
+                  ". Devices won't be monitored" );
+        return false;
+    }
+    m_wakeupFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if ( m_wakeupFd < 0 )
+    {
+        close( m_mountinfoFd );
+        m_mountinfoFd = -1;
+        return false;
+    }
+    // The block devices events are only a hint: the mount table changes are
+    // enough to detect most devices being plugged & unplugged
+    m_ueventFd = socket( AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                         NETLINK_KOBJECT_UEVENT );
+    if ( m_ueventFd >= 0 )
+    {
+        sockaddr_nl addr = {};
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = 1;
+        if ( bind( m_ueventFd, reinterpret_cast<sockaddr*>( &addr ), sizeof( addr ) ) != 0 )
+        {
+            LOG_INFO( "Failed to listen to udev events: ", strerror( errno ) );
+            close( m_ueventFd );
+            m_ueventFd = -1;
+        }
+    }
+    m_cb = cb;
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_devices = readDevices();
+        m_cached = true;
+        m_monitoring = true;
+        m_notified = m_devices;
+    }
+    m_thread = compat::Thread( &DeviceLister::run, this );
+    return true;
+}
+
+void DeviceLister::stop()
+{
+    if ( m_thread.get_id() == compat::Thread::id{} )
+        return;
+    eventfd_write( m_wakeupFd, 1 );
+    m_thread.join();
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_cached = false;
+        m_monitoring = false;
+    }
+    close( m_mountinfoFd );
+    close( m_wakeupFd );
+    if ( m_ueventFd >= 0 )
+        close( m_ueventFd );
+    m_mountinfoFd = m_ueventFd = m_wakeupFd = -1;
+}
+
+void DeviceLister::run()
+{
+    LOG_INFO( "Entering DeviceLister thread" );
+    while ( waitForChanges() == true )
+    {
+        DeviceList devices;
+        {
+            std::lock_guard<compat::Mutex> lock( m_mutex );
+            m_devices = readDevices();
+            devices = m_devices;
+        }
+        notifyChanges( devices );
+    }
+    LOG_INFO( "Exiting DeviceLister thread" );
+}
+
+bool DeviceLister::waitForChanges()
+{
+    while ( true )
+    {
+        pollfd fds[] = {
+            { m_wakeupFd, POLLIN, 0 },
+            // The mount table changes are reported as exceptional conditions
+            { m_mountinfoFd, POLLPRI, 0 },
+            { m_ueventFd, POLLIN, 0 },
+        };
+        if ( poll( fds, m_ueventFd >= 0 ? 3 : 2, -1 ) < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            LOG_ERROR( "Failed to wait for device changes: ", strerror( errno ) );
+            return false;
+        }
+        if ( ( fds[0].revents & POLLIN ) != 0 )
+            return false;
+        auto changed = ( fds[1].revents & ( POLLPRI | POLLERR ) ) != 0;
+        if ( ( fds[2].revents & POLLIN ) != 0 )
+        {
+            char buff[4096];
+            ssize_t size;
+            while ( ( size = recv( m_ueventFd, buff, sizeof( buff ) - 1, 0 ) ) > 0 )
+            {
+                buff[size] = 0;
+                // Messages start with "<action>@<devpath>", only block
+                // devices can hold a filesystem
+                if ( strstr( buff, "/block/" ) != nullptr )
+                    changed = true;
+            }
+        }
+        if ( changed == true )
+            return true;
+    }
+}
+
+void DeviceLister::notifyChanges( const DeviceList& devices )
+{
+    auto changes = diffDevices( m_notified, devices );
+    for ( const auto& d : changes.first )
+    {
+        const auto& uuid = std::get<0>( d );
+        LOG_INFO( "Device ", uuid, " was unmounted from ", std::get<1>( d ) );
+        if ( m_cb->isDeviceKnown( uuid ) == true )
+            m_cb->onDeviceUnplugged( uuid );
+    }
+    for ( const auto& d : changes.second )
+    {
+        const auto& uuid = std::get<0>( d );
+        LOG_INFO( "Device ", uuid, " was mounted on ", std::get<1>( d ) );
+        m_cb->onDevicePlugged( uuid, std::get<1>( d ) );
+    }
+    m_notified = devices;
+}
+
+std::pair<DeviceLister::DeviceList, DeviceLister::DeviceList>
+DeviceLister::diffDevices( const DeviceList& previous, const DeviceList& current )
+{
+    auto findDevice = []( const DeviceList& list, const std::string& uuid ) {
+        return std::find_if( begin( list ), end( list ), [&uuid]( const DeviceList::value_type& d ) {
+            return std::get<0>( d ) == uuid;
+        });
+    };
+    std::pair<DeviceList, DeviceList> res;
+    for ( const auto& d : previous )
+    {
+        if ( findDevice( current, std::get<0>( d ) ) == end( current ) )
+            res.first.push_back( d );
+    }
+    for ( const auto& d : current )
+    {
+        if ( findDevice( previous, std::get<0>( d ) ) == end( previous ) )
+            res.second.push_back( d );
+    }
+    return res;
+}
+
 }
 }
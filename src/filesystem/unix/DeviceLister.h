@@ -23,6 +23,8 @@
 #pragma once
 
 #include "medialibrary/IDeviceLister.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
 
 #include <unordered_map>
 
@@ -33,6 +35,10 @@ namespace fs
 
 class DeviceLister : public IDeviceLister
 {
+public:
+    // (UUID, mountpoint, removable) tuples
+    using DeviceList = std::vector<std::tuple<std::string, std::string, bool>>;
+
 private:
     // Device name / UUID map
     using DeviceMap = std::unordered_map<std::string, std::string>;
@@ -43,9 +49,46 @@ private:
     MountpointMap listMountpoints() const;
     std::pair<std::string, std::string> deviceFromDeviceMapper( const std::string& devicePath ) const;
     bool isRemovable( const std::string& deviceName, const std::string& mountpoint ) const;
+    DeviceList readDevices() const;
+    ///
+    /// \brief run Waits for the mount table or the block devices to change,
+    /// and reports the plugged & unplugged devices.
+    ///
+    void run();
+    bool waitForChanges();
+    void notifyChanges( const DeviceList& devices );
 
 public:
-    virtual std::vector<std::tuple<std::string, std::string, bool>> devices() const override;
+    DeviceLister();
+    virtual ~DeviceLister();
+    virtual DeviceList devices() const override;
+    virtual bool start( IDeviceListerCb* cb ) override;
+    virtual void stop() override;
+    ///
+    /// \brief diffDevices Compares two devices listings, by device UUID
+    /// \return The unmounted devices as a first element, and the mounted ones
+    ///         as a second element
+    ///
+    static std::pair<DeviceList, DeviceList> diffDevices( const DeviceList& previous,
+                                                          const DeviceList& current );
+
+private:
+    // /proc/self/mountinfo, which gets flagged when the mount table changes,
+    // the udev netlink socket, and the eventfd used to stop the monitoring
+    int m_mountinfoFd;
+    int m_ueventFd;
+    int m_wakeupFd;
+    IDeviceListerCb* m_cb;
+    compat::Thread m_thread;
+    mutable compat::Mutex m_mutex;
+    // The last listed devices. They are only reused while monitoring, since
+    // they are then kept up to date
+    mutable DeviceList m_devices;
+    mutable bool m_cached;
+    // The monitoring thread is running
+    bool m_monitoring;
+    // The devices as of the last notification. Only used from the monitor thread
+    DeviceList m_notified;
 };
 
 }
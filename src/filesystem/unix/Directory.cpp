@@ -35,6 +35,7 @@
 #include <cstring>
 #include <cstdlib>
 #include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <sys/stat.h>
 #include <system_error>
@@ -54,9 +55,19 @@ Directory::Directory( const std::string& mrl, factory::IFileSystem& fsFactory )
     m_mrl = utils::file::toMrl( m_path );
 }
 
+Directory::Directory( std::string path, const Directory& parent )
+    : CommonDirectory( parent.m_fsFactory )
+    , m_path( std::move( path ) )
+{
+    assert( *m_path.crbegin() == '/' );
+}
+
 const std::string& Directory::mrl() const
 {
-    return m_mrl;
+    auto lock = m_mrl.lock();
+    if ( m_mrl.isCached() == false )
+        m_mrl = utils::file::toMrl( m_path );
+    return m_mrl.get();
 }
 
 void Directory::read() const
@@ -68,6 +79,10 @@ void Directory::read() const
         throw std::system_error( errno, std::generic_category(), "Failed to open directory" );
     }
 
+    // Entries are probed relatively to the opened directory, which spares
+    // building and resolving a full path for each of them
+    auto fd = dirfd( dir.get() );
+    const auto& dirMrl = mrl();
     dirent* result = nullptr;
 
     while ( ( result = readdir( dir.get() ) ) != nullptr )
@@ -75,49 +90,65 @@ void Directory::read() const
         if ( result->d_name[0] == '.' && strcasecmp( result->d_name, ".nomedia" ) != 0 )
             continue;
 
-        std::string path = m_path + result->d_name;
-
         struct stat s;
-        if ( lstat( path.c_str(), &s ) != 0 )
+#ifdef DT_DIR
+        // Most filesystems provide the entry type, so directories can be
+        // listed without any additional syscall
+        auto isDirectory = result->d_type == DT_DIR;
+#else
+        auto isDirectory = false;
+#endif
+        if ( isDirectory == false )
         {
-            if ( errno == EACCES )
-                continue;
-            // some Android devices will list folder content, but will yield
-            // ENOENT when accessing those.
-            // See https://trac.videolan.org/vlc/ticket/19909
-            if ( errno == ENOENT )
-            {
-                LOG_WARN( "Ignoring unexpected ENOENT while listing folder content." );
-                continue;
-            }
-            // Ignore EOVERFLOW since we are not (yet?) interested in the file size
-            if ( errno != EOVERFLOW )
+            if ( fstatat( fd, result->d_name, &s, AT_SYMLINK_NOFOLLOW ) != 0 )
             {
-                LOG_ERROR( "Failed to get file ", path, " info" );
-                throw std::system_error( errno, std::generic_category(), "Failed to get file info" );
+                if ( errno == EACCES )
+                    continue;
+                // some Android devices will list folder content, but will yield
+                // ENOENT when accessing those.
+                // See https://trac.videolan.org/vlc/ticket/19909
+                if ( errno == ENOENT )
+                {
+                    LOG_WARN( "Ignoring unexpected ENOENT while listing folder content." );
+                    continue;
+                }
+                // Ignore EOVERFLOW since we are not (yet?) interested in the file size
+                if ( errno != EOVERFLOW )
+                {
+                    LOG_ERROR( "Failed to get file ", m_path, result->d_name, " info" );
+                    throw std::system_error( errno, std::generic_category(), "Failed to get file info" );
+                }
             }
+            // The type is unknown to some filesystems, in which case we need
+            // to rely on the entry mode
+            isDirectory = S_ISDIR( s.st_mode );
         }
-        try
+        if ( isDirectory == true )
         {
-            if ( S_ISDIR( s.st_mode ) )
-                m_dirs.emplace_back( std::make_shared<Directory>(
-                            m_mrl + utils::url::encode( result->d_name ), m_fsFactory ) );
-            else
-                m_files.emplace_back( std::make_shared<File>( path, s ) );
+            // Our own path is already resolved, and symbolic links are
+            // not followed, so there is no need to resolve it again
+            m_dirs.emplace_back( std::shared_ptr<Directory>(
+                    new Directory( m_path + result->d_name + '/', *this ) ) );
         }
-        catch ( const std::system_error& err )
+        else
         {
-            if ( err.code() == std::errc::no_such_file_or_directory )
-            {
-                LOG_WARN( "Ignoring ", path, ": ", err.what() );
-                continue;
-            }
-            LOG_ERROR( "Fatal error while reading ", path, ": ", err.what() );
-            throw;
+            m_files.emplace_back( std::make_shared<File>(
+                    dirMrl + utils::url::encode( result->d_name ), s ) );
         }
     }
 }
 
+unsigned int Directory::lastModificationDate() const
+{
+    struct stat s;
+    if ( stat( m_path.c_str(), &s ) != 0 )
+    {
+        LOG_ERROR( "Failed to get ", m_path, " stats" );
+        throw std::system_error( errno, std::generic_category(), "Failed to get stats" );
+    }
+    return s.st_mtime;
+}
+
 std::string Directory::toAbsolute( const std::string& path )
 {
     char abs[PATH_MAX];
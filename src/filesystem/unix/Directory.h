@@ -37,13 +37,17 @@ class Directory : public CommonDirectory
 public:
     Directory( const std::string& mrl, factory::IFileSystem& fsFactory );
     const std::string& mrl() const override;
+    virtual unsigned int lastModificationDate() const override;
 
 private:
+    /// Constructs a subdirectory of parent from its already resolved path
+    Directory( std::string path, const Directory& parent );
     virtual void read() const override;
     static std::string toAbsolute( const std::string& path );
 
 private:
-    std::string m_mrl;
+    // Lazily computed, as subdirectories may be listed without ever being used
+    mutable Cache<std::string> m_mrl;
     std::string m_path;
 };
 
@@ -25,7 +25,6 @@
 #endif
 
 #include "File.h"
-#include "utils/Filename.h"
 
 #include <stdexcept>
 #include <sys/stat.h>
@@ -36,11 +35,12 @@ namespace medialibrary
 namespace fs
 {
 
-File::File( const std::string& filePath, const struct stat& s )
-    : CommonFile( utils::file::toMrl( filePath ) )
+File::File( const std::string& mrl, const struct stat& s )
+    : CommonFile( mrl )
 {
     m_lastModificationDate = s.st_mtime;
     m_size = s.st_size;
+    m_inode = s.st_ino;
 }
 
 unsigned int File::lastModificationDate() const
@@ -53,6 +53,11 @@ unsigned int File::size() const
     return m_size;
 }
 
+uint64_t File::inode() const
+{
+    return m_inode;
+}
+
 }
 
 }
@@ -35,14 +35,16 @@ namespace fs
 class File : public CommonFile
 {
 public:
-    explicit File( const std::string& filePath, const struct stat& s );
+    explicit File( const std::string& mrl, const struct stat& s );
 
     virtual unsigned int lastModificationDate() const override;
     virtual unsigned int size() const override;
+    virtual uint64_t inode() const override;
 
 private:
     unsigned int m_lastModificationDate;
     unsigned int m_size;
+    uint64_t m_inode;
 };
 
 }
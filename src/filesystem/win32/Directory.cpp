@@ -34,6 +34,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <tchar.h>
 #include <windows.h>
 #include <winapifamily.h>
 
@@ -56,6 +57,19 @@ const std::string& Directory::mrl() const
     return m_mrl;
 }
 
+unsigned int Directory::lastModificationDate() const
+{
+    // _stat fails on paths with a trailing separator
+    auto path = m_path.substr( 0, m_path.length() - 1 );
+    struct _stat s;
+    if ( _tstat( charset::ToWide( path.c_str() ).get(), &s ) != 0 )
+    {
+        LOG_ERROR( "Failed to get ", m_path, " stats" );
+        throw std::system_error( errno, std::generic_category(), "Failed to get stats" );
+    }
+    return s.st_mtime;
+}
+
 void Directory::read() const
 {
 #if WINAPI_FAMILY_PARTITION (WINAPI_PARTITION_DESKTOP)
@@ -35,6 +35,7 @@ class Directory : public CommonDirectory
 public:
     Directory( const std::string& mrl, factory::IFileSystem& fsFactory );
     const std::string& mrl() const override;
+    virtual unsigned int lastModificationDate() const override;
 
 private:
     virtual void read() const override;
@@ -56,6 +56,21 @@ File::File( const std::string& filePath )
 
     m_lastModificationDate = s.st_mtime;
     m_size = s.st_size;
+
+    // The file index is the closest thing to an inode, but it requires a
+    // handle. Failing to get it only prevents the move detection.
+    m_inode = 0;
+    auto h = CreateFileW( charset::ToWide( filePath.c_str() ).get(), 0,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                          nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr );
+    if ( h != INVALID_HANDLE_VALUE )
+    {
+        BY_HANDLE_FILE_INFORMATION info;
+        if ( GetFileInformationByHandle( h, &info ) != 0 )
+            m_inode = ( static_cast<uint64_t>( info.nFileIndexHigh ) << 32 ) |
+                    info.nFileIndexLow;
+        CloseHandle( h );
+    }
 }
 
 unsigned int File::lastModificationDate() const
@@ -68,6 +83,11 @@ unsigned int File::size() const
     return m_size;
 }
 
+uint64_t File::inode() const
+{
+    return m_inode;
+}
+
 }
 
 }
@@ -37,10 +37,12 @@ public:
 
     unsigned int lastModificationDate() const override;
     unsigned int size() const override;
+    uint64_t inode() const override;
 
 private:
     unsigned int m_lastModificationDate;
     unsigned int m_size;
+    uint64_t m_inode;
 };
 
 }
@@ -51,6 +51,7 @@ namespace medialibrary
 
 MetadataParser::MetadataParser()
     : m_previousFolderId( 0 )
+    , m_indexed( false )
 {
 }
 
@@ -59,12 +60,115 @@ bool MetadataParser::initialize()
     m_unknownArtist = Artist::fetch( m_ml, UnknownArtistID );
     if ( m_unknownArtist == nullptr )
         LOG_ERROR( "Failed to cache unknown artist" );
+    buildIndexes();
     return m_unknownArtist != nullptr;
 }
 
-int MetadataParser::toInt( VLC::Media& vlcMedia, libvlc_meta_t meta, const char* name )
+void MetadataParser::buildIndexes()
 {
-    auto str = vlcMedia.meta( meta );
+    m_albumIds.clear();
+    m_artistIds.clear();
+    m_genreIds.clear();
+    m_indexed = false;
+    static const std::string albumReq = "SELECT id_album, title FROM " + policy::AlbumTable::Name;
+    static const std::string artistReq = "SELECT id_artist, name FROM " + policy::ArtistTable::Name;
+    static const std::string genreReq = "SELECT id_genre, name FROM " + policy::GenreTable::Name;
+    try
+    {
+        auto dbConn = m_ml->getConn();
+        auto ctx = dbConn->acquireReadContext();
+        {
+            sqlite::Statement stmt( dbConn->handle(), albumReq );
+            stmt.execute();
+            for ( sqlite::Row row = stmt.row(); row != nullptr; row = stmt.row() )
+            {
+                auto title = row.load<std::string>( 1 );
+                if ( title.empty() == false )
+                    m_albumIds[utils::string::caseFold( title )].push_back( row.load<int64_t>( 0 ) );
+            }
+        }
+        {
+            sqlite::Statement stmt( dbConn->handle(), artistReq );
+            stmt.execute();
+            for ( sqlite::Row row = stmt.row(); row != nullptr; row = stmt.row() )
+            {
+                auto name = row.load<std::string>( 1 );
+                if ( name.empty() == false )
+                    m_artistIds[utils::string::caseFold( name )] = row.load<int64_t>( 0 );
+            }
+        }
+        sqlite::Statement stmt( dbConn->handle(), genreReq );
+        stmt.execute();
+        for ( sqlite::Row row = stmt.row(); row != nullptr; row = stmt.row() )
+        {
+            auto name = row.load<std::string>( 1 );
+            if ( name.empty() == false )
+                m_genreIds[utils::string::caseFold( name )] = row.load<int64_t>( 0 );
+        }
+    }
+    catch ( const sqlite::errors::GenericExecution& ex )
+    {
+        // Fall back to the database queries
+        LOG_ERROR( "Failed to index the albums, artists & genres: ", ex.what() );
+        m_albumIds.clear();
+        m_artistIds.clear();
+        m_genreIds.clear();
+        return;
+    }
+    m_indexed = true;
+    LOG_INFO( "Indexed ", m_albumIds.size(), " album titles, ", m_artistIds.size(),
+              " artists & ", m_genreIds.size(), " genres" );
+}
+
+std::vector<std::shared_ptr<Album>> MetadataParser::albumCandidates( const std::string& title )
+{
+    static const std::string req = "SELECT * FROM " + policy::AlbumTable::Name +
+            " WHERE title = ?";
+    if ( m_indexed == false )
+        return Album::fetchAll<Album>( m_ml, req, title );
+    std::vector<std::shared_ptr<Album>> albums;
+    auto key = utils::string::caseFold( title );
+    auto it = m_albumIds.find( key );
+    if ( it == end( m_albumIds ) )
+        return albums;
+    auto& ids = it->second;
+    for ( auto idIt = begin( ids ); idIt != end( ids ); )
+    {
+        // The album might have been deleted by a trigger, or its creation
+        // rolled back, in which case its id might even have been reused.
+        auto album = Album::fetch( m_ml, *idIt );
+        if ( album == nullptr || utils::string::caseFold( album->title() ) != key )
+        {
+            idIt = ids.erase( idIt );
+            continue;
+        }
+        albums.push_back( std::move( album ) );
+        ++idIt;
+    }
+    return albums;
+}
+
+std::shared_ptr<Artist> MetadataParser::artistFromName( const std::string& name )
+{
+    static const std::string req = "SELECT * FROM " + policy::ArtistTable::Name + " WHERE name = ?";
+    auto key = utils::string::caseFold( name );
+    auto it = m_artistIds.find( key );
+    if ( it != end( m_artistIds ) )
+    {
+        auto artist = Artist::fetch( m_ml, it->second );
+        if ( artist != nullptr && utils::string::caseFold( artist->name() ) == key )
+            return artist;
+        m_artistIds.erase( it );
+    }
+    auto artist = Artist::fetch( m_ml, req, name );
+    if ( artist != nullptr )
+        m_artistIds[key] = artist->id();
+    return artist;
+}
+
+int MetadataParser::toInt( const parser::ExtractedMetadata& metadata, libvlc_meta_t meta, const char* name )
+{
+    auto str = metadata.meta( meta );
     if ( str.empty() == false )
     {
         try
@@ -82,7 +186,9 @@ int MetadataParser::toInt( VLC::Media& vlcMedia, libvlc_meta_t meta, const char*
 parser::Task::Status MetadataParser::run( parser::Task& task )
 {
     bool alreadyInParser = false;
-    int nbSubitem = task.vlcMedia.subitems()->count();
+    assert( task.metadata != nullptr );
+    // The cached medias weren't parsed by libvlc, but are never playlists
+    int nbSubitem = task.vlcMedia.isValid() == true ? task.vlcMedia.subitems()->count() : 0;
     // Assume that file containing subitem(s) is a Playlist
     if ( nbSubitem > 0 )
     {
@@ -164,33 +270,25 @@ parser::Task::Status MetadataParser::run( parser::Task& task )
     }
 
     //:ace
-    bool isTransportFile = false;
-    const char* transportFileExtensions[] = { ".acelive", ".torrent" };
-    for( auto it = std::begin(transportFileExtensions); it != std::end(transportFileExtensions); it++) {
-        if( utils::string::endsWith(task.mrl, *it) ) {
-            isTransportFile = true;
-        }
-
-    }
-
-    if ( isTransportFile ) {
+    // The transport files weren't parsed by libvlc, see Task::isTransportFile
+    if ( task.isTransportFile() == true ) {
         LOG_INFO( "Got transport file: ", task.mrl );
 
         // Complete this step and thumbnailer step
         task.markStepCompleted( parser::Task::ParserStep::MetadataAnalysis );
         task.markStepCompleted( parser::Task::ParserStep::Thumbnailer );
-        if ( task.saveParserStep() == false )
-            return parser::Task::Status::Fatal;
-
+        auto t = m_ml->getConn()->newTransaction();
         task.media->setType( IMedia::Type::TransportFile );
-        task.media->save();
+        if ( task.media->save() == false || task.saveParserStep() == false )
+            return parser::Task::Status::Fatal;
+        t->commit();
         m_notifier->notifyMediaCreation( task.media );
 
         return parser::Task::Status::Success;
     }
     ///ace
 
-    const auto& tracks = task.vlcMedia.tracks();
+    const auto& tracks = task.metadata->tracks;
 
     // If we failed to extract any tracks, don't make any assumption and forward to the
     // thumbnailer. Since it starts an actual playback, it will have more information.
@@ -219,25 +317,29 @@ parser::Task::Status MetadataParser::run( parser::Task& task )
             auto t = m_ml->getConn()->newTransaction();
             for ( const auto& track : tracks )
             {
-                auto codec = track.codec();
-                std::string fcc( reinterpret_cast<const char*>( &codec ), 4 );
-                if ( track.type() == VLC::MediaTrack::Type::Video )
+                if ( track.type == VLC::MediaTrack::Type::Video )
                 {
-                    task.media->addVideoTrack( fcc, track.width(), track.height(),
-                                          static_cast<float>( track.fpsNum() ) / static_cast<float>( track.fpsDen() ),
-                                          track.language(), track.description() );
+                    task.media->addVideoTrack( track.codec, track.width, track.height,
+                                          static_cast<float>( track.fpsNum ) / static_cast<float>( track.fpsDen ),
+                                          track.language, track.description );
                     isAudio = false;
                 }
-                else if ( track.type() == VLC::MediaTrack::Type::Audio )
+                else if ( track.type == VLC::MediaTrack::Type::Audio )
                 {
-                    task.media->addAudioTrack( fcc, track.bitrate(), track.rate(), track.channels(),
-                                          track.language(), track.description() );
+                    task.media->addAudioTrack( track.codec, track.bitrate, track.rate, track.channels,
+                                          track.language, track.description );
                 }
             }
-            task.media->setDuration( task.vlcMedia.duration() );
+            task.media->setDuration( task.metadata->duration );
+            // Keep the raw metadata around, for the next rescans to use
+            if ( task.metadata->fromCache == false )
+                parser::ParseCache::insert( m_ml, task, *task.metadata );
             t->commit();
         }, std::move( tracks ) );
     }
+    // The parser step is saved by parseAudioFile/parseVideoFile, in the
+    // transaction committing their results
+    task.markStepCompleted( parser::Task::ParserStep::MetadataAnalysis );
     if ( isAudio == true )
     {
         if ( parseAudioFile( task ) == false )
@@ -252,13 +354,6 @@ parser::Task::Status MetadataParser::run( parser::Task& task )
     if ( task.file->isDeleted() == true || task.media->isDeleted() == true )
         return parser::Task::Status::Fatal;
 
-    task.markStepCompleted( parser::Task::ParserStep::MetadataAnalysis );
-    // Save ourselves from the useless processing of a thumbnail later if
-    // we're analyzing an audio file
-    if ( isAudio == true && utils::file::schemeIs( "attachment://", task.media->thumbnail() ) == false )
-        task.markStepCompleted( parser::Task::ParserStep::Thumbnailer );
-    if ( task.saveParserStep() == false )
-        return parser::Task::Status::Fatal;
     m_notifier->notifyMediaCreation( task.media );
     return parser::Task::Status::Success;
 }
@@ -269,7 +364,7 @@ bool MetadataParser::addPlaylistMedias( parser::Task& task, int nbSubitem ) cons
 {
     auto t = m_ml->getConn()->newTransaction();
     LOG_INFO( "Try to import ", task.mrl, " as a playlist" );
-    auto playlistName = task.vlcMedia.meta( libvlc_meta_Title );
+    auto playlistName = task.metadata->meta( libvlc_meta_Title );
     if ( playlistName.empty() == true )
         playlistName = utils::url::decode( utils::file::fileName( task.mrl ) );
     auto playlistPtr = Playlist::create( m_ml, playlistName );
@@ -380,11 +475,17 @@ bool MetadataParser::parseVideoFile( parser::Task& task ) const
 {
     auto media = task.media.get();
     media->setType( IMedia::Type::Video );
-    const auto& title = task.vlcMedia.meta( libvlc_meta_Title );
+    const auto& title = task.metadata->meta( libvlc_meta_Title );
     if ( title.length() == 0 )
+    {
+        auto t = m_ml->getConn()->newTransaction();
+        if ( media->save() == false || task.saveParserStep() == false )
+            return false;
+        t->commit();
         return true;
+    }
 
-    const auto& showName = task.vlcMedia.meta( libvlc_meta_ShowName );
+    const auto& showName = task.metadata->meta( libvlc_meta_ShowName );
 
     return sqlite::Tools::withRetries( 3, [this, &showName, &title, &task]() {
         auto t = m_ml->getConn()->newTransaction();
@@ -399,7 +500,7 @@ bool MetadataParser::parseVideoFile( parser::Task& task ) const
                 if ( show == nullptr )
                     return false;
             }
-            auto episode = toInt( task.vlcMedia, libvlc_meta_Episode, "episode number" );
+            auto episode = toInt( *task.metadata, libvlc_meta_Episode, "episode number" );
             if ( episode != 0 )
             {
                 std::shared_ptr<Show> s = std::static_pointer_cast<Show>( show );
@@ -410,11 +511,11 @@ bool MetadataParser::parseVideoFile( parser::Task& task ) const
         {
             // How do we know if it's a movie or a random video?
         }
-        task.media->save();
+        if ( task.media->save() == false || task.saveParserStep() == false )
+            return false;
         t->commit();
         return true;
     });
-    return true;
 }
 
 /* Audio files */
@@ -423,7 +524,7 @@ bool MetadataParser::parseAudioFile( parser::Task& task )
 {
     task.media->setType( IMedia::Type::Audio );
 
-    auto artworkMrl = task.vlcMedia.meta( libvlc_meta_ArtworkURL );
+    auto artworkMrl = task.metadata->meta( libvlc_meta_ArtworkURL );
     if ( artworkMrl.empty() == false )
     {
         task.media->setThumbnail( artworkMrl );
@@ -431,7 +532,10 @@ bool MetadataParser::parseAudioFile( parser::Task& task )
         if ( utils::file::schemeIs( "attachment", artworkMrl ) )
             artworkMrl.clear();
     }
-
+    // Save ourselves from the useless processing of a thumbnail later if
+    // we're analyzing an audio file
+    if ( utils::file::schemeIs( "attachment://", task.media->thumbnail() ) == false )
+        task.markStepCompleted( parser::Task::ParserStep::Thumbnailer );
 
     auto genre = handleGenre( task );
     auto artists = findOrCreateArtist( task );
@@ -443,10 +547,12 @@ bool MetadataParser::parseAudioFile( parser::Task& task )
         auto t = m_ml->getConn()->newTransaction();
         if ( album == nullptr )
         {
-            const auto& albumName = task.vlcMedia.meta( libvlc_meta_Album );
+            const auto& albumName = task.metadata->meta( libvlc_meta_Album );
             album = m_ml->createAlbum( albumName, artworkMrl );
             if ( album == nullptr )
                 return false;
+            if ( albumName.empty() == false )
+                m_albumIds[utils::string::caseFold( albumName )].push_back( album->id() );
             m_notifier->notifyAlbumCreation( album );
         }
         // If we know a track artist, specify it, otherwise, fallback to the album/unknown artist
@@ -454,24 +560,38 @@ bool MetadataParser::parseAudioFile( parser::Task& task )
                                   genre.get() );
 
         auto res = link( *task.media, album, artists.first, artists.second );
-        task.media->save();
+        if ( task.media->save() == false || task.saveParserStep() == false )
+            return false;
         t->commit();
         return res;
     }, std::move( artworkMrl ), std::move( album ), std::move( genre ) );
 }
 
-std::shared_ptr<Genre> MetadataParser::handleGenre( parser::Task& task ) const
+std::shared_ptr<Genre> MetadataParser::handleGenre( parser::Task& task )
 {
-    const auto& genreStr = task.vlcMedia.meta( libvlc_meta_Genre );
+    const auto& genreStr = task.metadata->meta( libvlc_meta_Genre );
     if ( genreStr.length() == 0 )
         return nullptr;
+    auto key = utils::string::caseFold( genreStr );
+    auto it = m_genreIds.find( key );
+    if ( it != end( m_genreIds ) )
+    {
+        auto genre = Genre::fetch( m_ml, it->second );
+        if ( genre != nullptr && utils::string::caseFold( genre->name() ) == key )
+            return genre;
+        m_genreIds.erase( it );
+    }
     auto genre = Genre::fromName( m_ml, genreStr );
     if ( genre == nullptr )
     {
         genre = Genre::create( m_ml, genreStr );
         if ( genre == nullptr )
+        {
             LOG_ERROR( "Failed to get/create Genre", genreStr );
+            return nullptr;
+        }
     }
+    m_genreIds[key] = genre->id();
     return genre;
 }
 
@@ -480,7 +600,7 @@ std::shared_ptr<Genre> MetadataParser::handleGenre( parser::Task& task ) const
 std::shared_ptr<Album> MetadataParser::findAlbum( parser::Task& task, std::shared_ptr<Artist> albumArtist,
                                                     std::shared_ptr<Artist> trackArtist )
 {
-    const auto& albumName = task.vlcMedia.meta( libvlc_meta_Album );
+    const auto& albumName = task.metadata->meta( libvlc_meta_Album );
     if ( albumName.empty() == true )
     {
         if ( albumArtist != nullptr )
@@ -498,15 +618,13 @@ std::shared_ptr<Album> MetadataParser::findAlbum( parser::Task& task, std::share
 
     // Album matching depends on the difference between artist & album artist.
     // Specificaly pass the albumArtist here.
-    static const std::string req = "SELECT * FROM " + policy::AlbumTable::Name +
-            " WHERE title = ?";
-    auto albums = Album::fetchAll<Album>( m_ml, req, albumName );
+    auto albums = albumCandidates( albumName );
 
     if ( albums.size() == 0 )
         return nullptr;
 
-    const auto discTotal = toInt( task.vlcMedia, libvlc_meta_DiscTotal, "disc total" );
-    const auto discNumber = toInt( task.vlcMedia, libvlc_meta_DiscNumber, "disc number" );
+    const auto discTotal = toInt( *task.metadata, libvlc_meta_DiscTotal, "disc total" );
+    const auto discNumber = toInt( *task.metadata, libvlc_meta_DiscNumber, "disc number" );
     /*
      * Even if we get only 1 album, we need to filter out invalid matches.
      * For instance, if we have already inserted an album "A" by an artist "john"
@@ -603,7 +721,7 @@ std::shared_ptr<Album> MetadataParser::findAlbum( parser::Task& task, std::share
         // tagged with a year.
         if ( multipleArtists == false )
         {
-            auto candidateDate = task.vlcMedia.meta( libvlc_meta_Date );
+            auto candidateDate = task.metadata->meta( libvlc_meta_Date );
             if ( candidateDate.empty() == false )
             {
                 try
@@ -649,14 +767,13 @@ std::shared_ptr<Album> MetadataParser::findAlbum( parser::Task& task, std::share
 /// The album artist as a first element
 /// The track artist as a second element, or nullptr if it is the same as album artist
 ///
-std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::findOrCreateArtist( parser::Task& task ) const
+std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::findOrCreateArtist( parser::Task& task )
 {
     std::shared_ptr<Artist> albumArtist;
     std::shared_ptr<Artist> artist;
-    static const std::string req = "SELECT * FROM " + policy::ArtistTable::Name + " WHERE name = ?";
 
-    const auto& albumArtistStr = task.vlcMedia.meta( libvlc_meta_AlbumArtist );
-    const auto& artistStr = task.vlcMedia.meta( libvlc_meta_Artist );
+    const auto& albumArtistStr = task.metadata->meta( libvlc_meta_AlbumArtist );
+    const auto& artistStr = task.metadata->meta( libvlc_meta_Artist );
     if ( albumArtistStr.empty() == true && artistStr.empty() == true )
     {
         return {m_unknownArtist, m_unknownArtist};
@@ -664,7 +781,7 @@ std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::find
 
     if ( albumArtistStr.empty() == false )
     {
-        albumArtist = Artist::fetch( m_ml, req, albumArtistStr );
+        albumArtist = artistFromName( albumArtistStr );
         if ( albumArtist == nullptr )
         {
             albumArtist = m_ml->createArtist( albumArtistStr );
@@ -673,12 +790,13 @@ std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::find
                 LOG_ERROR( "Failed to create new artist ", albumArtistStr );
                 return {nullptr, nullptr};
             }
+            m_artistIds[utils::string::caseFold( albumArtistStr )] = albumArtist->id();
             m_notifier->notifyArtistCreation( albumArtist );
         }
     }
     if ( artistStr.empty() == false && artistStr != albumArtistStr )
     {
-        artist = Artist::fetch( m_ml, req, artistStr );
+        artist = artistFromName( artistStr );
         if ( artist == nullptr )
         {
             artist = m_ml->createArtist( artistStr );
@@ -687,6 +805,7 @@ std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::find
                 LOG_ERROR( "Failed to create new artist ", artistStr );
                 return {nullptr, nullptr};
             }
+            m_artistIds[utils::string::caseFold( artistStr )] = artist->id();
             m_notifier->notifyArtistCreation( artist );
         }
     }
@@ -700,9 +819,9 @@ std::shared_ptr<AlbumTrack> MetadataParser::handleTrack( std::shared_ptr<Album>
 {
     assert( sqlite::Transaction::transactionInProgress() == true );
 
-    auto title = task.vlcMedia.meta( libvlc_meta_Title );
-    const auto trackNumber = toInt( task.vlcMedia, libvlc_meta_TrackNumber, "track number" );
-    const auto discNumber = toInt( task.vlcMedia, libvlc_meta_DiscNumber, "disc number" );
+    auto title = task.metadata->meta( libvlc_meta_Title );
+    const auto trackNumber = toInt( *task.metadata, libvlc_meta_TrackNumber, "track number" );
+    const auto discNumber = toInt( *task.metadata, libvlc_meta_DiscNumber, "disc number" );
     if ( title.empty() == true )
     {
         LOG_WARN( "Failed to get track title" );
@@ -724,7 +843,7 @@ std::shared_ptr<AlbumTrack> MetadataParser::handleTrack( std::shared_ptr<Album>
         return nullptr;
     }
 
-    const auto& releaseDate = task.vlcMedia.meta( libvlc_meta_Date );
+    const auto& releaseDate = task.metadata->meta( libvlc_meta_Date );
     if ( releaseDate.empty() == false )
     {
         auto releaseYear = atoi( releaseDate.c_str() );
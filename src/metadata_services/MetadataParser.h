@@ -22,6 +22,9 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <vector>
+
 #include "MediaLibrary.h"
 #include "parser/ParserService.h"
 
@@ -49,22 +52,32 @@ protected:
                              VLC::MediaPtr subitem, unsigned int index ) const;
     bool parseAudioFile(parser::Task& task);
     bool parseVideoFile(parser::Task& task) const;
-    std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> findOrCreateArtist( parser::Task& vlcMedia ) const;
+    std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> findOrCreateArtist( parser::Task& vlcMedia );
     std::shared_ptr<AlbumTrack> handleTrack( std::shared_ptr<Album> album, parser::Task& task,
                                              std::shared_ptr<Artist> artist, Genre* genre ) const;
     bool link(Media& media, std::shared_ptr<Album> album, std::shared_ptr<Artist> albumArtist, std::shared_ptr<Artist> artist );
     std::shared_ptr<Album> findAlbum( parser::Task& task, std::shared_ptr<Artist> albumArtist,
                                         std::shared_ptr<Artist> artist );
-    std::shared_ptr<Genre> handleGenre( parser::Task& task ) const;
+    std::shared_ptr<Genre> handleGenre( parser::Task& task );
 
 private:
-    static int toInt( VLC::Media& vlcMedia, libvlc_meta_t meta, const char* name );
+    static int toInt( const parser::ExtractedMetadata& metadata, libvlc_meta_t meta, const char* name );
+    void buildIndexes();
+    std::vector<std::shared_ptr<Album>> albumCandidates( const std::string& title );
+    std::shared_ptr<Artist> artistFromName( const std::string& name );
 
 private:
     std::shared_ptr<Artist> m_unknownArtist;
     std::shared_ptr<Artist> m_variousArtists;
     std::shared_ptr<Album> m_previousAlbum;
     int64_t m_previousFolderId;
+    // The known albums, artists & genres ids, by case folded title/name, to
+    // match them without querying the database for each track. The album
+    // index is considered exhaustive, since only this service creates albums.
+    std::unordered_map<std::string, std::vector<int64_t>> m_albumIds;
+    std::unordered_map<std::string, int64_t> m_artistIds;
+    std::unordered_map<std::string, int64_t> m_genreIds;
+    bool m_indexed;
 };
 
 }
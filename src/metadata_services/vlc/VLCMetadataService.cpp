@@ -24,6 +24,7 @@
 # include "config.h"
 #endif
 
+#include <algorithm>
 #include <chrono>
 
 #include "VLCMetadataService.h"
@@ -33,12 +34,35 @@
 namespace medialibrary
 {
 
-VLCMetadataService::VLCMetadataService()
-    : m_instance( VLCInstance::get() )
+const unsigned int VLCMetadataService::DefaultMaxThreads;
+
+VLCMetadataService::VLCMetadataService( unsigned int nbThreads )
+    : m_nbInstances( 0 )
 {
+    // The parsing is mostly spent demuxing & probing, so use half the cores
+    // by default, and leave the other half to the other services
+    if ( nbThreads == 0 )
+        nbThreads = std::min( std::max( nbNativeThreads() / 2u, 1u ), DefaultMaxThreads );
+    m_nbThreads = static_cast<uint8_t>( std::min( nbThreads, 255u ) );
 }
 
 parser::Task::Status VLCMetadataService::run( parser::Task& task )
+{
+    // Unchanged files don't need to be parsed again, ie. when rescanning
+    task.metadata = parser::ParseCache::fetch( m_ml, task );
+    if ( task.metadata != nullptr )
+    {
+        LOG_INFO( "Using cached metadata for ", task.mrl );
+        task.markStepCompleted( parser::Task::ParserStep::MetadataExtraction );
+        return parser::Task::Status::Success;
+    }
+    auto instance = acquireInstance();
+    auto status = extract( instance, task );
+    releaseInstance( std::move( instance ) );
+    return status;
+}
+
+parser::Task::Status VLCMetadataService::extract( VLC::Instance& instance, parser::Task& task )
 {
     auto mrl = task.mrl;
     LOG_INFO( "Parsing ", mrl );
@@ -46,24 +70,32 @@ parser::Task::Status VLCMetadataService::run( parser::Task& task )
     // Having a valid media means we're re-executing this parser after the thumbnailer,
     // which isn't expected, as we always mark this task as completed.
     assert( task.vlcMedia.isValid() == false );
-    task.vlcMedia = VLC::Media( m_instance, mrl, VLC::Media::FromType::FromLocation );
+    task.vlcMedia = VLC::Media( instance, mrl, VLC::Media::FromType::FromLocation );
 
+    // The parsing state is local to this call, so the worker threads don't
+    // wake each other up when one of their medias gets parsed
+    compat::Mutex mutex;
+    compat::ConditionVariable cond;
     VLC::Media::ParsedStatus status;
     bool done = false;
 
-    auto event = task.vlcMedia.eventManager().onParsedChanged( [this, &status, &done](VLC::Media::ParsedStatus s ) {
-        std::lock_guard<compat::Mutex> lock( m_mutex );
+    auto event = task.vlcMedia.eventManager().onParsedChanged( [&mutex, &cond, &status, &done](VLC::Media::ParsedStatus s ) {
+        std::lock_guard<compat::Mutex> lock( mutex );
         status = s;
         done = true;
-        m_cond.notify_all();
+        cond.notify_all();
     });
     {
-        std::unique_lock<compat::Mutex> lock( m_mutex );
+        std::unique_lock<compat::Mutex> lock( mutex );
 
         if ( task.vlcMedia.parseWithOptions( VLC::Media::ParseFlags::Local | VLC::Media::ParseFlags::Network |
                                              VLC::Media::ParseFlags::FetchLocal, 5000 ) == false )
+        {
+            lock.unlock();
+            event->unregister();
             return parser::Task::Status::Fatal;
-        m_cond.wait( lock, [&status, &done]() {
+        }
+        cond.wait( lock, [&done]() {
             return done == true;
         });
     }
@@ -73,12 +105,40 @@ parser::Task::Status VLCMetadataService::run( parser::Task& task )
     auto tracks = task.vlcMedia.tracks();
     if ( tracks.size() == 0 )
         LOG_WARN( "Failed to fetch any tracks for ", mrl );
+    task.metadata.reset( new parser::ExtractedMetadata( task.vlcMedia ) );
     // Don't save the file parsing step yet, since all data are just in memory. Just mark
     // the extraction as done.
     task.markStepCompleted( parser::Task::ParserStep::MetadataExtraction );
     return parser::Task::Status::Success;
 }
 
+VLC::Instance VLCMetadataService::acquireInstance()
+{
+    bool first;
+    {
+        std::lock_guard<compat::Mutex> lock( m_instancesMutex );
+        if ( m_instances.empty() == false )
+        {
+            auto instance = std::move( m_instances.back() );
+            m_instances.pop_back();
+            return instance;
+        }
+        first = m_nbInstances++ == 0;
+    }
+    // Each thread holds at most one instance, so we never create more than
+    // nbThreads instances. Share the first one with the other services.
+    if ( first == true )
+        return VLCInstance::get();
+    LOG_INFO( "Creating a new VLC instance for metadata extraction" );
+    return VLCInstance::create();
+}
+
+void VLCMetadataService::releaseInstance( VLC::Instance instance )
+{
+    std::lock_guard<compat::Mutex> lock( m_instancesMutex );
+    m_instances.push_back( std::move( instance ) );
+}
+
 const char* VLCMetadataService::name() const
 {
     return "VLC";
@@ -86,13 +146,13 @@ const char* VLCMetadataService::name() const
 
 uint8_t VLCMetadataService::nbThreads() const
 {
-    return 1;
+    return m_nbThreads;
 }
 
 bool VLCMetadataService::isCompleted( const parser::Task& task ) const
 {
     // We always need to run this task if the metadata extraction isn't completed
-    return task.vlcMedia.isValid() == true;
+    return task.metadata != nullptr;
 }
 
 }
@@ -26,6 +26,7 @@
 #include "compat/ConditionVariable.h"
 #include <vlcpp/vlc.hpp>
 #include <mutex>
+#include <vector>
 
 #include "parser/ParserService.h"
 #include "parser/Parser.h"
@@ -37,7 +38,11 @@ namespace medialibrary
 class VLCMetadataService : public ParserService
 {
     public:
-        explicit VLCMetadataService();
+        ///
+        /// \param nbThreads The number of medias parsed concurrently. 0 picks
+        ///                  a value based on the number of CPU cores.
+        ///
+        explicit VLCMetadataService( unsigned int nbThreads = 0 );
 
 private:
         virtual parser::Task::Status run( parser::Task& task ) override;
@@ -45,10 +50,20 @@ private:
         virtual uint8_t nbThreads() const override;
         virtual bool isCompleted( const parser::Task& task ) const override;
 
+        parser::Task::Status extract( VLC::Instance& instance, parser::Task& task );
+        VLC::Instance acquireInstance();
+        void releaseInstance( VLC::Instance instance );
+
 private:
-        VLC::Instance m_instance;
-        compat::Mutex m_mutex;
-        compat::ConditionVariable m_cond;
+        // The maximum number of threads when none is explicitely requested
+        static const unsigned int DefaultMaxThreads = 4;
+
+        uint8_t m_nbThreads;
+        // Each libvlc instance only parses one media at a time, so each
+        // worker thread borrows its own instance from this pool
+        compat::Mutex m_instancesMutex;
+        std::vector<VLC::Instance> m_instances;
+        unsigned int m_nbInstances;
 };
 
 }
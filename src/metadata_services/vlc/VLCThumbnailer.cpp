@@ -89,7 +89,9 @@ parser::Task::Status VLCThumbnailer::run( parser::Task& task )
     task.vlcMedia.addOption( ":input-fast-seek" );
     task.vlcMedia.addOption( ":avcodec-hw=none" );
     task.vlcMedia.addOption( ":no-mkv-preload-local-dir" );
-    auto duration = task.vlcMedia.duration();
+    // The media might not have been parsed by libvlc, if its metadata were cached
+    auto duration = task.metadata != nullptr ? task.metadata->duration :
+                                               task.vlcMedia.duration();
     if ( duration > 0 && media->type() != IMedia::Type::Audio )
     {
         std::ostringstream ss;
@@ -109,7 +111,10 @@ parser::Task::Status VLCThumbnailer::run( parser::Task& task )
         if ( media->type() == Media::Type::Audio )
         {
             task.markStepCompleted( parser::Task::ParserStep::Thumbnailer );
-            task.saveParserStep();
+            auto t = m_ml->getConn()->newTransaction();
+            if ( media->save() == false || task.saveParserStep() == false )
+                return parser::Task::Status::Fatal;
+            t->commit();
             LOG_INFO( file->mrl(), " type has changed to Audio. Skipping thumbnail generation" );
             return parser::Task::Status::Success;
         }
@@ -238,8 +243,8 @@ parser::Task::Status VLCThumbnailer::startPlayback( parser::Task& task, VLC::Med
     // The file might be an audio file we haven't detected yet:
     else if ( task.media->type() == Media::Type::Unknown )
     {
+        // The new type is saved along with the parser step, by the caller
         task.media->setType( Media::Type::Audio );
-        task.media->save();
         // We still return an error since we don't want to attempt the thumbnail generation for a
         // file without video tracks
     }
@@ -0,0 +1,229 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "ParseCache.h"
+
+#include "database/SqliteTools.h"
+#include "filesystem/IFile.h"
+#include "parser/Task.h"
+
+namespace medialibrary
+{
+
+const std::string policy::ParseCacheTable::Name = "ParseCache";
+const std::string policy::ParseCacheTrackTable::Name = "ParseCacheTrack";
+
+namespace parser
+{
+
+namespace
+{
+// The metadata used by the analysis, in the cache table columns order
+const libvlc_meta_t CachedMetas[] = {
+    libvlc_meta_Title,
+    libvlc_meta_Artist,
+    libvlc_meta_AlbumArtist,
+    libvlc_meta_Album,
+    libvlc_meta_Genre,
+    libvlc_meta_Date,
+    libvlc_meta_TrackNumber,
+    libvlc_meta_DiscNumber,
+    libvlc_meta_DiscTotal,
+    libvlc_meta_ShowName,
+    libvlc_meta_Episode,
+    libvlc_meta_ArtworkURL,
+};
+}
+
+ExtractedMetadata::ExtractedMetadata( VLC::Media& media )
+    : duration( media.duration() )
+    , fromCache( false )
+{
+    for ( const auto& track : media.tracks() )
+    {
+        auto codec = track.codec();
+        tracks.push_back( Track{ track.type(),
+                                 std::string( reinterpret_cast<const char*>( &codec ), 4 ),
+                                 track.width(), track.height(), track.fpsNum(), track.fpsDen(),
+                                 track.bitrate(), track.rate(), track.channels(),
+                                 track.language(), track.description() } );
+    }
+    for ( auto m : CachedMetas )
+    {
+        auto value = media.meta( m );
+        if ( value.empty() == false )
+            metas.emplace( m, std::move( value ) );
+    }
+}
+
+ExtractedMetadata::ExtractedMetadata()
+    : duration( 0 )
+    , fromCache( false )
+{
+}
+
+std::string ExtractedMetadata::meta( libvlc_meta_t meta ) const
+{
+    auto it = metas.find( meta );
+    if ( it == end( metas ) )
+        return {};
+    return it->second;
+}
+
+void ParseCache::createTable( sqlite::Connection* dbConnection )
+{
+    const std::string reqs[] = {
+        "CREATE TABLE IF NOT EXISTS " + policy::ParseCacheTable::Name + "("
+            "task_id INTEGER PRIMARY KEY,"
+            "mrl TEXT,"
+            "size UNSIGNED INTEGER,"
+            "last_modification_date UNSIGNED INTEGER,"
+            "duration INTEGER,"
+            "title TEXT,"
+            "artist TEXT,"
+            "album_artist TEXT,"
+            "album TEXT,"
+            "genre TEXT,"
+            "date TEXT,"
+            "track_number TEXT,"
+            "disc_number TEXT,"
+            "disc_total TEXT,"
+            "show_name TEXT,"
+            "episode TEXT,"
+            "artwork_url TEXT,"
+            "FOREIGN KEY (task_id) REFERENCES " + policy::TaskTable::Name +
+                "(id_task) ON DELETE CASCADE"
+        ")",
+        "CREATE TABLE IF NOT EXISTS " + policy::ParseCacheTrackTable::Name + "("
+            "task_id INTEGER,"
+            "type INTEGER,"
+            "codec TEXT,"
+            "width UNSIGNED INTEGER,"
+            "height UNSIGNED INTEGER,"
+            "fps_num UNSIGNED INTEGER,"
+            "fps_den UNSIGNED INTEGER,"
+            "bitrate UNSIGNED INTEGER,"
+            "rate UNSIGNED INTEGER,"
+            "channels UNSIGNED INTEGER,"
+            "language TEXT,"
+            "description TEXT,"
+            "FOREIGN KEY (task_id) REFERENCES " + policy::ParseCacheTable::Name +
+                "(task_id) ON DELETE CASCADE"
+        ")",
+        "CREATE INDEX IF NOT EXISTS parse_cache_track_task_id_idx ON " +
+            policy::ParseCacheTrackTable::Name + "(task_id)",
+    };
+    for ( const auto& req : reqs )
+        sqlite::Tools::executeRequest( dbConnection, req );
+}
+
+std::unique_ptr<ExtractedMetadata> ParseCache::fetch( MediaLibraryPtr ml, const Task& task )
+{
+    if ( task.fileFs == nullptr || task.id() == 0 )
+        return nullptr;
+    static const std::string req = "SELECT * FROM " + policy::ParseCacheTable::Name +
+            " WHERE task_id = ?"
+            " AND mrl = ? AND size = ? AND last_modification_date = ?";
+    static const std::string tracksReq = "SELECT * FROM " + policy::ParseCacheTrackTable::Name +
+            " WHERE task_id = ?";
+
+    auto dbConnection = ml->getConn();
+    sqlite::Connection::ReadContext ctx;
+    if ( sqlite::Transaction::transactionInProgress() == false )
+        ctx = dbConnection->acquireReadContext();
+
+    std::unique_ptr<ExtractedMetadata> metadata;
+    {
+        sqlite::Statement stmt( dbConnection->handle(), req );
+        stmt.execute( task.id(), task.mrl, task.fileFs->size(),
+                      task.fileFs->lastModificationDate() );
+        auto row = stmt.row();
+        if ( row == nullptr )
+            return nullptr;
+        metadata.reset( new ExtractedMetadata );
+        row.advanceToColumn( 4 );
+        row >> metadata->duration;
+        for ( auto m : CachedMetas )
+        {
+            std::string value;
+            row >> value;
+            if ( value.empty() == false )
+                metadata->metas.emplace( m, std::move( value ) );
+        }
+    }
+    sqlite::Statement stmt( dbConnection->handle(), tracksReq );
+    stmt.execute( task.id() );
+    for ( sqlite::Row row = stmt.row(); row != nullptr; row = stmt.row() )
+    {
+        ExtractedMetadata::Track track;
+        int64_t taskId;
+        row >> taskId >> track.type >> track.codec >> track.width >> track.height
+            >> track.fpsNum >> track.fpsDen >> track.bitrate >> track.rate
+            >> track.channels >> track.language >> track.description;
+        metadata->tracks.push_back( std::move( track ) );
+    }
+    metadata->fromCache = true;
+    return metadata;
+}
+
+bool ParseCache::insert( MediaLibraryPtr ml, const Task& task,
+                         const ExtractedMetadata& metadata )
+{
+    if ( task.fileFs == nullptr || task.id() == 0 )
+        return false;
+    static const std::string deleteReq = "DELETE FROM " + policy::ParseCacheTable::Name +
+            " WHERE task_id = ?";
+    static const std::string req = "INSERT INTO " + policy::ParseCacheTable::Name + " VALUES("
+            "?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+    static const std::string trackReq = "INSERT INTO " + policy::ParseCacheTrackTable::Name + " VALUES("
+            "?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+    auto dbConnection = ml->getConn();
+    // The tracks are deleted along with their previous entry
+    sqlite::Tools::executeDelete( dbConnection, deleteReq, task.id() );
+    if ( sqlite::Tools::executeInsert( dbConnection, req, task.id(), task.mrl,
+                task.fileFs->size(), task.fileFs->lastModificationDate(),
+                metadata.duration,
+                metadata.meta( libvlc_meta_Title ), metadata.meta( libvlc_meta_Artist ),
+                metadata.meta( libvlc_meta_AlbumArtist ), metadata.meta( libvlc_meta_Album ),
+                metadata.meta( libvlc_meta_Genre ), metadata.meta( libvlc_meta_Date ),
+                metadata.meta( libvlc_meta_TrackNumber ), metadata.meta( libvlc_meta_DiscNumber ),
+                metadata.meta( libvlc_meta_DiscTotal ), metadata.meta( libvlc_meta_ShowName ),
+                metadata.meta( libvlc_meta_Episode ), metadata.meta( libvlc_meta_ArtworkURL ) ) == 0 )
+        return false;
+    for ( const auto& t : metadata.tracks )
+    {
+        if ( sqlite::Tools::executeInsert( dbConnection, trackReq, task.id(), t.type,
+                    t.codec, t.width, t.height, t.fpsNum, t.fpsDen, t.bitrate,
+                    t.rate, t.channels, t.language, t.description ) == 0 )
+            return false;
+    }
+    return true;
+}
+
+}
+
+}
@@ -0,0 +1,121 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <vlcpp/vlc.hpp>
+
+#include "Types.h"
+
+namespace medialibrary
+{
+
+namespace sqlite
+{
+class Connection;
+}
+
+namespace policy
+{
+struct ParseCacheTable
+{
+    static const std::string Name;
+};
+
+struct ParseCacheTrackTable
+{
+    static const std::string Name;
+};
+}
+
+namespace parser
+{
+
+class Task;
+
+///
+/// \brief The ExtractedMetadata struct holds what the analysis needs from
+/// the libvlc parsing of a media, so it can be cached, and the analysis run
+/// again without parsing the file.
+///
+struct ExtractedMetadata
+{
+    struct Track
+    {
+        VLC::MediaTrack::Type type;
+        std::string codec;
+        uint32_t width;
+        uint32_t height;
+        uint32_t fpsNum;
+        uint32_t fpsDen;
+        uint32_t bitrate;
+        uint32_t rate;
+        uint32_t channels;
+        std::string language;
+        std::string description;
+    };
+
+    explicit ExtractedMetadata( VLC::Media& media );
+    ExtractedMetadata();
+
+    std::string meta( libvlc_meta_t meta ) const;
+
+    int64_t duration;
+    std::vector<Track> tracks;
+    std::map<libvlc_meta_t, std::string> metas;
+    // True when this was loaded from the cache rather than parsed by libvlc
+    bool fromCache;
+};
+
+///
+/// \brief The ParseCache class persists the metadata extracted for each task.
+///
+/// The entries are keyed by the task, and are only valid as long as the file
+/// mrl, size and modification date are unchanged. They are deleted along with
+/// their task, and survive rescans, so a rescan doesn't need libvlc to parse
+/// the unchanged files again.
+///
+class ParseCache
+{
+public:
+    static void createTable( sqlite::Connection* dbConnection );
+    ///
+    /// \brief fetch Returns the cached metadata for this task, or nullptr if
+    ///              there are none, or if the file changed since.
+    ///
+    static std::unique_ptr<ExtractedMetadata> fetch( MediaLibraryPtr ml, const Task& task );
+    ///
+    /// \brief insert Stores (or replaces) the metadata extracted for this task
+    /// This is expected to be called from within a transaction.
+    ///
+    static bool insert( MediaLibraryPtr ml, const Task& task,
+                        const ExtractedMetadata& metadata );
+};
+
+}
+
+}
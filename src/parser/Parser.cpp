@@ -27,18 +27,56 @@
 #include "Parser.h"
 
 #include <algorithm>
+#include <cassert>
+#include <iterator>
 #include <utility>
 
 #include "medialibrary/IMediaLibrary.h"
 #include "Media.h"
 #include "File.h"
 #include "ParserService.h"
+#include "utils/Governor.h"
 
 namespace medialibrary
 {
 
+constexpr unsigned int Parser::MaxQueuedTasks;
+constexpr unsigned int Parser::ResumeQueuedTasks;
+constexpr unsigned int Parser::RestorePageSize;
+
+namespace
+{
+// How often an interruptible wait checks its flag
+constexpr auto InterruptibleWait = std::chrono::milliseconds( 100 );
+// Set on the parser workers, which must never wait for the queue to drain:
+// they are the ones draining it
+thread_local bool IsParserWorker = false;
+}
+
+Parser::Worker::Worker( Parser* p, size_t nbServices )
+    : parser( p )
+    , tasks( nbServices )
+    , busy( false )
+{
+}
+
+void Parser::Worker::run()
+{
+    parser->run( *this );
+}
+
 Parser::Parser( MediaLibrary* ml )
-    : m_ml( ml )
+    : m_nbQueued( 0 )
+    , m_nbBusyWorkers( 0 )
+    , m_nextWorker( 0 )
+    , m_stopParser( false )
+    , m_paused( false )
+    , m_restoring( false )
+    , m_fetchingPage( false )
+    , m_restoreCursor( 0 )
+    , m_restoreLastId( 0 )
+    , m_firstParsedId( 0 )
+    , m_ml( ml )
     , m_callback( ml->getCb() )
     , m_opToDo( 0 )
     , m_opDone( 0 )
@@ -53,15 +91,33 @@ Parser::~Parser()
 
 void Parser::addService( ServicePtr service )
 {
-    service->initialize( m_ml, this );
+    // The workers are sized according to the services
+    assert( m_workers.empty() == true );
+    service->initialize( m_ml );
     m_services.push_back( std::move( service ) );
+    m_nbRunning.push_back( 0 );
+    // Interactive & Visible
+    m_prioritized.resize( 2 );
+    for ( auto& p : m_prioritized )
+        p.resize( m_services.size() );
 }
 
 void Parser::parse( std::shared_ptr<parser::Task> task )
 {
     if ( m_services.empty() == true )
         return;
-    m_services[0]->parse( std::move( task ) );
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        if ( m_workers.empty() == true )
+            startWorkers();
+        if ( m_firstParsedId == 0 )
+            m_firstParsedId = task->id();
+        // Spread the new tasks across the workers, the idle ones will steal
+        // them anyway
+        auto& worker = *m_workers[m_nextWorker++ % m_workers.size()];
+        push( worker, std::move( task ) );
+    }
+    m_cond.notify_all();
     m_opToDo += m_services.size();
     updateStats();
 }
@@ -73,30 +129,58 @@ void Parser::start()
 
 void Parser::pause()
 {
-    for ( auto& s : m_services )
-        s->pause();
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    m_paused = true;
 }
 
 void Parser::resume()
 {
-    for ( auto& s : m_services )
-        s->resume();
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_paused = false;
+    }
+    m_cond.notify_all();
 }
 
 void Parser::stop()
 {
-    for ( auto& s : m_services )
     {
-        s->signalStop();
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_stopParser = true;
     }
-    for ( auto& s : m_services )
+    m_cond.notify_all();
+    m_capacityCond.notify_all();
+    for ( auto& w : m_workers )
     {
-        s->stop();
+        if ( w->thread.joinable() )
+            w->thread.join();
     }
 }
 
 void Parser::flush()
 {
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        assert( m_paused == true || m_workers.empty() == true );
+        m_idleCond.wait( lock, [this]() {
+            return m_nbBusyWorkers == 0;
+        });
+        for ( auto& w : m_workers )
+        {
+            for ( auto& q : w->tasks )
+                q.clear();
+        }
+        for ( auto& p : m_prioritized )
+        {
+            for ( auto& q : p )
+                q.clear();
+        }
+        m_nbQueued = 0;
+        // The pending tasks will be restored again after restarting
+        m_restoring = false;
+        m_firstParsedId = 0;
+    }
+    m_capacityCond.notify_all();
     for ( auto& s : m_services )
         s->flush();
 }
@@ -111,14 +195,316 @@ void Parser::restore()
 {
     if ( m_services.empty() == true )
         return;
+    // The discoverer calls parse() while holding the database write lock, so
+    // this can't be read while holding m_mutex. The tasks inserted until then
+    // were already queued, and are excluded through m_firstParsedId below,
+    // while the next ones get a greater id.
+    int64_t lastId;
+    try
+    {
+        lastId = parser::Task::lastId( m_ml );
+    }
+    catch ( const std::exception& ex )
+    {
+        LOG_ERROR( "Failed to restore the uncompleted tasks: ", ex.what() );
+        return;
+    }
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        LOG_INFO( "Resuming parsing of the uncompleted tasks" );
+        m_restoring = true;
+        m_restoreCursor = 0;
+        m_restoreLastId = m_firstParsedId != 0 ?
+                    std::min( lastId, m_firstParsedId - 1 ) : lastId;
+        if ( m_workers.empty() == true )
+            startWorkers();
+    }
+    m_cond.notify_all();
+}
+
+bool Parser::prioritize( const std::string& mrl, ParsingPriority priority )
+{
+    auto isFolder = mrl.back() == '/';
+    auto matches = [&mrl, isFolder]( const std::shared_ptr<parser::Task>& t ) {
+        if ( isFolder == true )
+            return t->mrl.compare( 0, mrl.length(), mrl ) == 0;
+        return t->mrl == mrl;
+    };
+    std::vector<std::shared_ptr<parser::Task>> tasks;
+    auto extract = [&tasks, &matches, priority]( TaskQueue& queue ) {
+        auto it = std::stable_partition( begin( queue ), end( queue ),
+                                         [&matches, priority]( const std::shared_ptr<parser::Task>& t ) {
+            return matches( t ) == false || t->priority == priority;
+        });
+        std::move( it, end( queue ), std::back_inserter( tasks ) );
+        queue.erase( it, end( queue ) );
+    };
+    auto found = false;
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        for ( auto& w : m_workers )
+        {
+            for ( auto& q : w->tasks )
+                extract( q );
+            // The next services will run the task with its new priority
+            if ( w->current != nullptr && w->current->isRestored() == true &&
+                 matches( w->current ) == true )
+            {
+                w->current->priority = priority;
+                found = true;
+            }
+        }
+        for ( auto& p : m_prioritized )
+        {
+            for ( auto& q : p )
+                extract( q );
+        }
+        if ( tasks.empty() == true )
+            return found;
+        LOG_INFO( "Moving ", tasks.size(), " tasks matching ", mrl, " to another priority lane" );
+        m_nbQueued -= tasks.size();
+        for ( auto& t : tasks )
+        {
+            t->priority = priority;
+            push( *m_workers[m_nextWorker++ % m_workers.size()], std::move( t ) );
+        }
+    }
+    m_cond.notify_all();
+    return true;
+}
+
+bool Parser::waitForCapacity( const std::atomic_bool* interrupted )
+{
+    // A service might queue tasks, for instance when importing a playlist
+    // content. Blocking a worker would prevent its tasks from being
+    // processed, possibly until the parser is stopped.
+    if ( IsParserWorker == true )
+        return true;
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    if ( m_nbQueued < MaxQueuedTasks )
+        return true;
+    LOG_INFO( "Parser queue is full, waiting for ", m_nbQueued - ResumeQueuedTasks,
+              " tasks to be processed" );
+    auto hasCapacity = [this]() {
+        return m_nbQueued <= ResumeQueuedTasks || m_stopParser == true ||
+                m_workers.empty() == true;
+    };
+    if ( interrupted == nullptr )
+    {
+        m_capacityCond.wait( lock, hasCapacity );
+        return true;
+    }
+    while ( m_capacityCond.wait_for( lock, InterruptibleWait, hasCapacity ) == false )
+    {
+        if ( *interrupted == true )
+            return false;
+    }
+    return true;
+}
+
+void Parser::startWorkers()
+{
+    // Provide as many workers as the services can use at once
+    auto nbWorkers = 0u;
+    for ( const auto& s : m_services )
+        nbWorkers += s->nbThreads();
+    nbWorkers = std::max( nbWorkers, 1u );
+    for ( auto i = 0u; i < nbWorkers; ++i )
+        m_workers.emplace_back( new Worker( this, m_services.size() ) );
+    for ( auto& w : m_workers )
+        w->thread = compat::Thread( &Worker::run, w.get() );
+}
 
-    auto tasks = parser::Task::fetchUncompleted( m_ml );
+void Parser::run( Worker& worker )
+{
+    LOG_INFO( "Entering parser worker thread" );
+    utils::Governor::setBackgroundPriority();
+    IsParserWorker = true;
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    while ( m_stopParser == false )
+    {
+        std::shared_ptr<parser::Task> task;
+        if ( m_paused == false && needsRestoration() == true )
+        {
+            setBusy( worker, true );
+            restorePage( lock );
+            continue;
+        }
+        if ( m_paused == true || pop( worker, task ) == false )
+        {
+            setBusy( worker, false );
+            // We get notified whenever a task is queued, or a service can
+            // accept a new task
+            m_cond.wait( lock );
+            continue;
+        }
+        setBusy( worker, true );
+        auto serviceIdx = task->currentService;
+        ++m_nbRunning[serviceIdx];
+        worker.current = task;
+        lock.unlock();
+
+        // The restored tasks are postponed when their file can't be found
+        auto status = task->restoreLinkedEntities() == true ?
+                    m_services[serviceIdx]->process( *task ) :
+                    parser::Task::Status::TemporaryUnavailable;
+        task = next( std::move( task ), status );
+
+        lock.lock();
+        --m_nbRunning[serviceIdx];
+        worker.current = nullptr;
+        if ( task != nullptr )
+            push( worker, std::move( task ) );
+        m_cond.notify_all();
+    }
+    setBusy( worker, false );
+    LOG_INFO( "Exiting parser worker thread" );
+}
+
+bool Parser::needsRestoration() const
+{
+    // Only fetch the next page once the pipeline is about to starve
+    return m_restoring == true && m_fetchingPage == false &&
+            m_nbQueued < RestorePageSize;
+}
+
+void Parser::restorePage( std::unique_lock<compat::Mutex>& lock )
+{
+    m_fetchingPage = true;
+    auto cursor = m_restoreCursor;
+    auto lastId = m_restoreLastId;
+    lock.unlock();
+    std::vector<std::shared_ptr<parser::Task>> tasks;
+    try
+    {
+        tasks = parser::Task::fetchUncompleted( m_ml, cursor, lastId,
+                                                RestorePageSize );
+    }
+    catch ( const std::exception& ex )
+    {
+        LOG_ERROR( "Failed to restore the uncompleted tasks: ", ex.what() );
+    }
+    lock.lock();
+    m_fetchingPage = false;
+    // The parser might have been flushed & restarted in the meantime
+    if ( m_restoring == false || m_restoreCursor != cursor ||
+         m_restoreLastId != lastId )
+        return;
+    if ( tasks.size() < RestorePageSize )
+        m_restoring = false;
+    if ( tasks.empty() == true )
+        return;
     LOG_INFO( "Resuming parsing on ", tasks.size(), " tasks" );
+    m_restoreCursor = tasks.back()->id();
+    m_opToDo += tasks.size() * m_services.size();
     for ( auto& t : tasks )
+        push( *m_workers[m_nextWorker++ % m_workers.size()], std::move( t ) );
+    m_cond.notify_all();
+    lock.unlock();
+    updateStats();
+    lock.lock();
+}
+
+bool Parser::pop( Worker& worker, std::shared_ptr<parser::Task>& task )
+{
+    if ( popPrioritized( task ) == true )
+        return true;
+    // Favor the last services, to complete the tasks which are already
+    // in the pipeline
+    for ( auto i = m_services.size(); i > 0; --i )
     {
-        if ( t->restoreLinkedEntities() == false )
+        auto serviceIdx = i - 1;
+        if ( m_nbRunning[serviceIdx] >= m_services[serviceIdx]->nbThreads() )
             continue;
-        parse( std::move( t ) );
+        auto& queue = worker.tasks[serviceIdx];
+        if ( queue.empty() == false )
+        {
+            task = std::move( queue.back() );
+            queue.pop_back();
+            onDequeued();
+            return true;
+        }
+        for ( auto& w : m_workers )
+        {
+            auto& victim = w->tasks[serviceIdx];
+            if ( victim.empty() == true )
+                continue;
+            task = std::move( victim.front() );
+            victim.pop_front();
+            onDequeued();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Parser::popPrioritized( std::shared_ptr<parser::Task>& task )
+{
+    for ( auto& lane : m_prioritized )
+    {
+        for ( auto i = m_services.size(); i > 0; --i )
+        {
+            auto serviceIdx = i - 1;
+            auto& queue = lane[serviceIdx];
+            if ( queue.empty() == true ||
+                 m_nbRunning[serviceIdx] >= m_services[serviceIdx]->nbThreads() )
+                continue;
+            task = std::move( queue.front() );
+            queue.pop_front();
+            onDequeued();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Parser::push( Worker& worker, std::shared_ptr<parser::Task> task )
+{
+    // Don't let a task wait for a busy service which has nothing to do with it
+    while ( task->currentService + 1 < m_services.size() &&
+            m_services[task->currentService]->isCompleted( *task ) == true )
+    {
+        ++task->currentService;
+        ++m_opDone;
+    }
+    switch ( task->priority.load() )
+    {
+        case ParsingPriority::Interactive:
+            m_prioritized[0][task->currentService].push_back( std::move( task ) );
+            break;
+        case ParsingPriority::Visible:
+            m_prioritized[1][task->currentService].push_back( std::move( task ) );
+            break;
+        case ParsingPriority::Background:
+            worker.tasks[task->currentService].push_back( std::move( task ) );
+            break;
+    }
+    ++m_nbQueued;
+}
+
+void Parser::onDequeued()
+{
+    // The producers only get woken up once the queue has drained enough
+    if ( --m_nbQueued == ResumeQueuedTasks )
+        m_capacityCond.notify_all();
+}
+
+void Parser::setBusy( Worker& worker, bool busy )
+{
+    if ( worker.busy == busy )
+        return;
+    worker.busy = busy;
+    if ( busy == true )
+    {
+        if ( m_nbBusyWorkers++ == 0 )
+            m_ml->onParserIdleChanged( false );
+        return;
+    }
+    if ( --m_nbBusyWorkers == 0 )
+    {
+        LOG_INFO( "Parser is now idle, ", m_nbQueued, " tasks remaining" );
+        m_idleCond.notify_all();
+        m_ml->onParserIdleChanged( true );
     }
 }
 
@@ -142,7 +528,8 @@ void Parser::updateStats()
     }
 }
 
-void Parser::done( std::shared_ptr<parser::Task> t, parser::Task::Status status )
+std::shared_ptr<parser::Task> Parser::next( std::shared_ptr<parser::Task> t,
+                                            parser::Task::Status status )
 {
     ++m_opDone;
 
@@ -157,7 +544,7 @@ void Parser::done( std::shared_ptr<parser::Task> t, parser::Task::Status status
             m_opToDo -= m_services.size() - serviceIdx;
         }
         updateStats();
-        return;
+        return nullptr;
     }
 
     // If some services declined to parse the file, start over again.
@@ -168,27 +555,7 @@ void Parser::done( std::shared_ptr<parser::Task> t, parser::Task::Status status
         LOG_INFO("Running parser chain again for ", t->mrl);
     }
     updateStats();
-    m_services[serviceIdx]->parse( std::move( t ) );
-}
-
-void Parser::onIdleChanged( bool idle )
-{
-    // If any parser service is not idle, then the global parser state is active
-    if ( idle == false )
-    {
-        m_ml->onParserIdleChanged( false );
-        return;
-    }
-    // Otherwise the parser is idle when all services are idle
-    for ( const auto& s : m_services )
-    {
-        // We're switching a service from "not idle" to "idle" here, so as far as the medialibrary
-        // is concerned the parser is still "not idle". In case a single parser service isn't
-        // idle, no need to trigger a change to the medialibrary.
-        if ( s->isIdle() == false )
-            return;
-    }
-    m_ml->onParserIdleChanged( true );
+    return t;
 }
 
 }
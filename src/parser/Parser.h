@@ -22,27 +22,42 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <memory>
-#include <queue>
+#include <vector>
 
 #include "Task.h"
 #include "File.h"
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
 
 namespace medialibrary
 {
 
 class ParserService;
 
-// Use an interface to expose only the "done" method
-class IParserCb
-{
-public:
-    virtual ~IParserCb() = default;
-    virtual void done( std::shared_ptr<parser::Task> task, parser::Task::Status status ) = 0;
-    virtual void onIdleChanged( bool isIdle ) = 0;
-};
-
-class Parser : IParserCb
+///
+/// \brief The Parser class runs the tasks through each parser service in turn.
+///
+/// The tasks are run by a pool of workers shared by all the services. Each
+/// worker owns one deque per service: once a worker is done with a task, it
+/// pushes it at the back of its deque for the next service, and pops from the
+/// back, so that it usually keeps processing the same file through the next
+/// services. When its deques are empty, a worker steals the oldest task from
+/// another worker, for any service.
+/// The later services are served first, so the files already in the pipeline
+/// get completed before new ones are started, and a service never runs more
+/// tasks at once than it allows.
+/// The prioritized tasks bypass the workers' deques: they are held in shared
+/// queues, one per priority & service, which are always served first.
+/// The number of queued tasks isn't bounded by parse(), since it is called
+/// while holding a database transaction, but the producers are expected to
+/// call waitForCapacity() beforehand, outside of any transaction, so that the
+/// pipeline memory usage stays flat regardless of the library size.
+///
+class Parser
 {
 public:
     using ServicePtr = std::unique_ptr<ParserService>;
@@ -62,20 +77,94 @@ public:
     ///                as it can imply initialization side effects
     ///
     void restart();
-    // Queues all unparsed files for parsing.
+    ///
+    /// \brief restore Queues all unparsed files for parsing.
+    /// The tasks are fetched by pages, by the workers, whenever the pipeline
+    /// is about to drain, and their linked entities are restored by the worker
+    /// which processes them first. This doesn't block.
+    ///
     void restore();
+    ///
+    /// \brief prioritize Changes the priority of the tasks matching the mrl
+    /// \param mrl A file mrl, or a folder mrl ending with a '/'
+    /// \return true if any queued or running task matched
+    ///
+    bool prioritize( const std::string& mrl, ParsingPriority priority );
+    ///
+    /// \brief waitForCapacity Blocks while too many tasks are queued
+    /// \param interrupted An optional flag which is polled while waiting
+    /// \return false if the wait was interrupted, true otherwise
+    ///
+    /// Once the queue is full, this waits until it has drained down to
+    /// ResumeQueuedTasks, to avoid waking the producers for each task.
+    /// This never blocks when called from a parser worker thread.
+    ///
+    bool waitForCapacity( const std::atomic_bool* interrupted = nullptr );
+
+    static constexpr unsigned int MaxQueuedTasks = 1000;
+    static constexpr unsigned int ResumeQueuedTasks = 500;
+    static constexpr unsigned int RestorePageSize = 100;
 
 private:
+    using TaskQueue = std::deque<std::shared_ptr<parser::Task>>;
+
+    struct Worker
+    {
+        Worker( Parser* parser, size_t nbServices );
+        void run();
+
+        Parser* parser;
+        compat::Thread thread;
+        // One queue per service
+        std::vector<TaskQueue> tasks;
+        std::shared_ptr<parser::Task> current;
+        bool busy;
+    };
+
+    void startWorkers();
+    void run( Worker& worker );
+    bool pop( Worker& worker, std::shared_ptr<parser::Task>& task );
+    bool popPrioritized( std::shared_ptr<parser::Task>& task );
+    void push( Worker& worker, std::shared_ptr<parser::Task> task );
+    void setBusy( Worker& worker, bool busy );
+    void onDequeued();
+    bool needsRestoration() const;
+    void restorePage( std::unique_lock<compat::Mutex>& lock );
     void updateStats();
-    virtual void done( std::shared_ptr<parser::Task> task,
-                       parser::Task::Status status ) override;
-    virtual void onIdleChanged( bool idle ) override;
+    // Returns the task if it must be processed by another service
+    std::shared_ptr<parser::Task> next( std::shared_ptr<parser::Task> task,
+                                        parser::Task::Status status );
 
 private:
     typedef std::vector<ServicePtr> ServiceList;
 
 private:
     ServiceList m_services;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    // The prioritized tasks, indexed by priority (most important first) and
+    // by service
+    std::vector<std::vector<TaskQueue>> m_prioritized;
+    // The number of tasks currently running, for each service
+    std::vector<unsigned int> m_nbRunning;
+    unsigned int m_nbQueued;
+    unsigned int m_nbBusyWorkers;
+    unsigned int m_nextWorker;
+    bool m_stopParser;
+    bool m_paused;
+    // Restoration state: the id of the last restored task, and whether a
+    // worker is currently fetching the next page.
+    bool m_restoring;
+    bool m_fetchingPage;
+    int64_t m_restoreCursor;
+    // The tasks created after the restoration started are queued through
+    // parse(), so the restoration stops at the last task which wasn't.
+    int64_t m_restoreLastId;
+    // The id of the first task queued through parse() since the last flush
+    int64_t m_firstParsedId;
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    compat::ConditionVariable m_idleCond;
+    compat::ConditionVariable m_capacityCond;
 
     MediaLibrary* m_ml;
     IMediaLibraryCb* m_callback;
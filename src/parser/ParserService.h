@@ -22,50 +22,39 @@
 
 #pragma once
 
-#include <atomic>
-#include "compat/ConditionVariable.h"
-#include <queue>
-
 #include "Task.h"
 #include "medialibrary/Types.h"
-#include "compat/Mutex.h"
-#include "compat/Thread.h"
 #include "File.h"
 
 namespace medialibrary
 {
 
-class IParserCb;
 class ModificationNotifier;
 class MediaLibrary;
 
+///
+/// \brief The ParserService class represents a stage of the parser pipeline.
+///
+/// The services don't own any thread: the parser runs their tasks from its
+/// shared pool of workers, without ever running more than nbThreads() tasks
+/// of a given service at once.
+///
 class ParserService
 {
 public:
     ParserService();
     virtual ~ParserService() = default;
 
-    void pause();
-    void resume();
-    ///
-    /// \brief signalStop Will trigger the threads for termination.
-    /// This doesn't wait for the threads to be done, but ensure they won't
-    /// queue another operation.
-    /// This is usefull to ask all the threads to terminate asynchronously, before
-    /// waiting for them to actually stop in the stop() method.
+    void initialize( MediaLibrary* mediaLibrary );
     ///
-    void signalStop();
+    /// \brief process Runs this service on the provided task, unless the task
+    /// was already processed.
     ///
-    /// \brief stop Effectively wait the the underlying threads to join.
+    parser::Task::Status process( parser::Task& task );
     ///
-    void stop();
-    void parse( std::shared_ptr<parser::Task> t );
-    void initialize( MediaLibrary* mediaLibrary, IParserCb* parserCb );
-    bool isIdle() const;
+    /// \brief flush Discards any state related to the previously scheduled tasks
     ///
-    /// \brief flush flush every currently scheduled tasks
-    ///
-    /// The service needs to be previously paused or unstarted
+    /// The parser is paused and doesn't run any task while this is called
     ///
     virtual void flush();
 
@@ -74,37 +63,28 @@ public:
     /// This assumes a flush was triggered before
     ///
     virtual void restart();
+    virtual const char* name() const = 0;
+    ///
+    /// \brief nbThreads The maximum number of tasks this service can run
+    /// concurrently.
+    ///
+    virtual uint8_t nbThreads() const = 0;
+    ///
+    /// \brief isCompleted Returns true if this service has nothing left to do
+    /// with the provided task
+    ///
+    virtual bool isCompleted( const parser::Task& task ) const = 0;
 
 protected:
     uint8_t nbNativeThreads() const;
     /// Can be overriden to run service dependent initializations
     virtual bool initialize();
     virtual parser::Task::Status run( parser::Task& task ) = 0;
-    virtual const char* name() const = 0;
-    virtual uint8_t nbThreads() const = 0;
-    virtual bool isCompleted( const parser::Task& task ) const = 0;
-
-private:
-    // Thread(s) entry point
-    void start();
-    void mainloop();
-    void setIdle( bool isIdle );
 
 protected:
     MediaLibrary* m_ml;
     IMediaLibraryCb* m_cb;
     std::shared_ptr<ModificationNotifier> m_notifier;
-
-private:
-    IParserCb* m_parserCb;
-    bool m_stopParser;
-    bool m_paused;
-    std::atomic_bool m_idle;
-    compat::ConditionVariable m_cond;
-    compat::ConditionVariable m_idleCond;
-    std::queue<std::shared_ptr<parser::Task>> m_tasks;
-    std::vector<compat::Thread> m_threads;
-    compat::Mutex m_lock;
 };
 
 }
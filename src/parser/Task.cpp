@@ -34,6 +34,7 @@
 #include "Playlist.h"
 #include "parser/Task.h"
 #include "utils/Filename.h"
+#include "utils/String.h"
 #include "utils/Url.h"
 
 namespace medialibrary
@@ -48,7 +49,10 @@ namespace parser
 
 Task::Task( MediaLibraryPtr ml, sqlite::Row& row )
     : currentService( 0 )
+    , priority( ParsingPriority::Background )
     , m_ml( ml )
+    , m_restored( false )
+    , m_retryCountUpdated( false )
 {
     row >> m_id
         >> m_step
@@ -72,10 +76,15 @@ Task::Task( MediaLibraryPtr ml, std::shared_ptr<fs::IFile> fileFs,
     , parentPlaylistIndex( parentPlaylistIndex )
     , mrl( this->fileFs->mrl() )
     , currentService( 0 )
+    , priority( ParsingPriority::Background )
     , m_ml( ml )
+    , m_id( 0 )
     , m_step( ParserStep::None )
     , m_fileId( 0 )
+    , m_restored( true )
+    , m_retryCountUpdated( false )
 {
+    classify();
 }
 
 void Task::markStepCompleted( ParserStep stepCompleted )
@@ -111,9 +120,15 @@ bool Task::isStepCompleted( Task::ParserStep step ) const
 
 void Task::startParserStep()
 {
+    // If the process crashes later on, the next session will run the same
+    // step first, and increment the retry count again.
+    if ( m_retryCountUpdated == true )
+        return;
     static const std::string req = "UPDATE " + policy::TaskTable::Name + " SET "
             "retry_count = retry_count + 1 WHERE id_task = ?";
-    sqlite::Tools::executeUpdate( m_ml->getConn(), req, m_id );
+    if ( sqlite::Tools::executeUpdate( m_ml->getConn(), req, m_id ) == false )
+        return;
+    m_retryCountUpdated = true;
 }
 
 bool Task::updateFileId()
@@ -135,6 +150,8 @@ int64_t Task::id() const
 
 bool Task::restoreLinkedEntities()
 {
+    if ( m_restored == true )
+        return true;
     LOG_INFO("Restoring linked entities of task ", m_id);
     // MRL will be empty if the task has been resumed from unparsed files
     // parentFolderId == 0 indicates an external file
@@ -234,9 +251,31 @@ bool Task::restoreLinkedEntities()
     if ( m_parentPlaylistId != 0 )
         parentPlaylist = Playlist::fetch( m_ml, m_parentPlaylistId );
 
+    classify();
+    m_restored = true;
     return true;
 }
 
+bool Task::isRestored() const
+{
+    return m_restored;
+}
+
+bool Task::isTransportFile() const
+{
+    auto ext = utils::string::caseFold( utils::file::extension( mrl ) );
+    return ext == "acelive" || ext == "torrent";
+}
+
+void Task::classify()
+{
+    if ( isTransportFile() == false || metadata != nullptr )
+        return;
+    // There is nothing for libvlc to extract from a transport file
+    metadata.reset( new ExtractedMetadata );
+    markStepCompleted( ParserStep::MetadataExtraction );
+}
+
 void Task::setMrl( std::string newMrl )
 {
     if ( mrl == newMrl )
@@ -284,13 +323,35 @@ void Task::resetParsing( MediaLibraryPtr ml )
     sqlite::Tools::executeUpdate( ml->getConn(), req, parser::Task::ParserStep::None );
 }
 
-std::vector<std::shared_ptr<Task>> Task::fetchUncompleted( MediaLibraryPtr ml )
+std::vector<std::shared_ptr<Task>> Task::fetchUncompleted( MediaLibraryPtr ml,
+                                                           int64_t afterId,
+                                                           int64_t lastId,
+                                                           unsigned int nbTasks )
 {
     static const std::string req = "SELECT * FROM " + policy::TaskTable::Name + " t"
         " LEFT JOIN " + policy::FileTable::Name + " f ON f.id_file = t.file_id"
         " WHERE step != ? AND retry_count < 3 AND (f.is_present != 0 OR "
-        " t.file_id IS NULL)";
-    return Task::fetchAll<Task>( ml, req, parser::Task::ParserStep::Completed );
+        " t.file_id IS NULL) AND t.id_task > ? AND t.id_task <= ?"
+        " ORDER BY t.id_task LIMIT ?";
+    return Task::fetchAll<Task>( ml, req, parser::Task::ParserStep::Completed,
+                                 afterId, lastId, nbTasks );
+}
+
+int64_t Task::lastId( MediaLibraryPtr ml )
+{
+    static const std::string req = "SELECT COALESCE(MAX(id_task), 0) FROM " +
+            policy::TaskTable::Name;
+    auto dbConnection = ml->getConn();
+    sqlite::Connection::ReadContext ctx;
+    if ( sqlite::Transaction::transactionInProgress() == false )
+        ctx = dbConnection->acquireReadContext();
+    sqlite::Statement stmt( dbConnection->handle(), req );
+    stmt.execute();
+    auto row = stmt.row();
+    int64_t id = 0;
+    if ( row != nullptr )
+        row >> id;
+    return id;
 }
 
 std::shared_ptr<Task>
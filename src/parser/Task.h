@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -30,6 +31,8 @@
 #include <vlcpp/vlc.hpp>
 
 #include "database/DatabaseHelpers.h"
+#include "medialibrary/IMediaLibrary.h"
+#include "parser/ParseCache.h"
 
 namespace medialibrary
 {
@@ -116,14 +119,26 @@ public:
     bool isStepCompleted( ParserStep step ) const;
     /**
      * @brief startParserStep Do some internal book keeping to avoid restarting a step too many time
+     *
+     * The retry count is only incremented for the first step ran during this
+     * session: a task which keeps crashing the parser will still be abandonned
+     * after a few restarts, without a database write for each step.
      */
     void startParserStep();
 
     bool updateFileId();
     int64_t id() const;
 
-    // Restore attached entities such as media/files
+    // Restore attached entities such as media/files. This is a no-op for the
+    // tasks which were not resumed from the database, or already restored.
     bool restoreLinkedEntities();
+    bool isRestored() const;
+    ///
+    /// \brief isTransportFile Returns true for the P2P transport files (.acelive
+    /// & .torrent). Those are registered by the metadata analysis, without
+    /// being parsed by libvlc nor thumbnailed.
+    ///
+    bool isTransportFile() const;
     void setMrl( std::string mrl );
 
     std::shared_ptr<Media>          media;
@@ -135,18 +150,43 @@ public:
     unsigned int                    parentPlaylistIndex;
     std::string                     mrl;
     VLC::Media                      vlcMedia;
+    // The metadata extracted by libvlc, or fetched from the parse cache
+    std::unique_ptr<ExtractedMetadata> metadata;
     unsigned int                    currentService;
+    // Not persisted: the restored tasks are processed in the background.
+    // This can be changed while a service processes the task.
+    std::atomic<ParsingPriority>    priority;
 
     static void createTable( sqlite::Connection* dbConnection );
     static void resetRetryCount( MediaLibraryPtr ml );
     static void resetParsing( MediaLibraryPtr ml );
-    static std::vector<std::shared_ptr<Task>> fetchUncompleted( MediaLibraryPtr ml );
+    ///
+    /// \brief fetchUncompleted Fetches a page of uncompleted tasks
+    /// \param afterId Only tasks with a greater id are fetched, so the last id
+    ///                of a page can be used to fetch the next one.
+    /// \param lastId Only tasks with a lower or equal id are fetched
+    /// \param nbTasks The maximum number of tasks to fetch
+    ///
+    /// The returned tasks linked entities are not restored yet.
+    ///
+    static std::vector<std::shared_ptr<Task>> fetchUncompleted( MediaLibraryPtr ml,
+                                                                int64_t afterId,
+                                                                int64_t lastId,
+                                                                unsigned int nbTasks );
+    ///
+    /// \brief lastId Returns the greatest task id, or 0 if there is no task
+    ///
+    static int64_t lastId( MediaLibraryPtr ml );
     static std::shared_ptr<Task> create( MediaLibraryPtr ml, std::shared_ptr<fs::IFile> fileFs,
                                          std::shared_ptr<Folder> parentFolder,
                                          std::shared_ptr<fs::IDirectory> parentFolderFs,
                                          std::pair<std::shared_ptr<Playlist>, unsigned int> parentPlaylist );
     static void recoverUnscannedFiles( MediaLibraryPtr ml );
 
+private:
+    // Skips the metadata extraction of the transport files
+    void classify();
+
 private:
     MediaLibraryPtr m_ml;
     int64_t     m_id;
@@ -155,6 +195,10 @@ private:
     int64_t     m_fileId;
     int64_t     m_parentFolderId;
     int64_t     m_parentPlaylistId;
+    // The restoration is done by the parser worker picking the task up, while
+    // the task mrl can be read by another thread once it's set.
+    std::atomic_bool m_restored;
+    bool        m_retryCountUpdated;
 
     friend policy::TaskTable;
 };
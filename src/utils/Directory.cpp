@@ -27,7 +27,10 @@
 
 #include "Directory.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <memory>
 #include <stdexcept>
 #include <system_error>
 
@@ -74,6 +77,45 @@ bool isDirectory( const std::string& path )
 #endif
 }
 
+uint64_t contentHash( const std::string& path )
+{
+    const long ChunkSize = 64 * 1024;
+#ifdef _WIN32
+    std::unique_ptr<FILE, int(*)(FILE*)> f( _wfopen( charset::ToWide( path.c_str() ).get(), L"rb" ),
+                                            &fclose );
+#else
+    std::unique_ptr<FILE, int(*)(FILE*)> f( fopen( path.c_str(), "rb" ), &fclose );
+#endif
+    if ( f == nullptr )
+        return 0;
+    // 64 bits FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    unsigned char buff[4096];
+    auto hashChunk = [&f, &hash, &buff]() {
+        auto remaining = ChunkSize;
+        while ( remaining > 0 )
+        {
+            auto nbRead = fread( buff, 1, std::min<long>( sizeof( buff ), remaining ), f.get() );
+            if ( nbRead == 0 )
+                break;
+            for ( auto i = 0u; i < nbRead; ++i )
+            {
+                hash ^= buff[i];
+                hash *= 1099511628211ULL;
+            }
+            remaining -= nbRead;
+        }
+    };
+    hashChunk();
+    // Small files are entirely covered by their first chunk
+    if ( fseek( f.get(), -ChunkSize, SEEK_END ) == 0 && ftell( f.get() ) != 0 )
+        hashChunk();
+    if ( ferror( f.get() ) != 0 )
+        return 0;
+    // 0 is reserved for the files which can't be read
+    return hash != 0 ? hash : 1;
+}
+
 }
 
 }
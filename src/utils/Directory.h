@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace medialibrary
@@ -36,6 +37,12 @@ namespace fs
 
 bool isDirectory( const std::string& path );
 
+///
+/// \brief contentHash Hashes the first and last 64KiB of a file
+/// \return The hash, or 0 if the file can't be read
+///
+uint64_t contentHash( const std::string& path );
+
 }
 
 }
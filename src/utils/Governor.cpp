@@ -0,0 +1,246 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Governor.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef __linux__
+# include <sys/resource.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+#include "logging/Logger.h"
+
+namespace medialibrary
+{
+
+namespace utils
+{
+
+namespace
+{
+// Don't sleep for too long when the caller might get interrupted, as the
+// interruption isn't notified through the governor
+const auto InterruptibleWait = std::chrono::milliseconds( 100 );
+// The lowest best effort I/O priority. The idle class would be even lower,
+// but it can starve the discovery forever on a busy device.
+const int IoprioWhoProcess = 1;
+const int IoprioClassBestEffort = 2;
+const int IoprioClassShift = 13;
+const int IoprioLowest = 7;
+const int BackgroundNiceness = 10;
+}
+
+const uint32_t Governor::DefaultOperationsPerSec;
+const uint64_t Governor::DefaultBytesPerSec;
+const uint32_t Governor::PlaybackOperationsPerSec;
+const uint64_t Governor::PlaybackBytesPerSec;
+
+Governor::Bucket::Bucket()
+    : rate( 0 )
+    , tokens( 0 )
+    , lastRefill( std::chrono::steady_clock::now() )
+{
+}
+
+void Governor::Bucket::setRate( uint64_t r )
+{
+    // A previously unlimited bucket starts full. Otherwise keep the current
+    // debt, but no more than a second worth of tokens
+    if ( rate == 0 )
+        tokens = static_cast<double>( r );
+    else
+        tokens = std::min( tokens, static_cast<double>( r ) );
+    rate = r;
+}
+
+void Governor::Bucket::refill( std::chrono::steady_clock::time_point now )
+{
+    auto elapsed = std::chrono::duration<double>( now - lastRefill ).count();
+    lastRefill = now;
+    if ( rate == 0 )
+        return;
+    // Allow bursts of up to a second
+    tokens = std::min( tokens + elapsed * rate, static_cast<double>( rate ) );
+}
+
+std::chrono::steady_clock::duration Governor::Bucket::debt() const
+{
+    if ( rate == 0 || tokens >= 0 )
+        return std::chrono::steady_clock::duration::zero();
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>( -tokens / rate ) );
+}
+
+Governor::Governor()
+    : m_nbOperationsPerSec( DefaultOperationsPerSec )
+    , m_nbBytesPerSec( DefaultBytesPerSec )
+    , m_playbackActive( false )
+    , m_stopped( false )
+    , m_nbUpdates( 0 )
+{
+    updateRates();
+}
+
+void Governor::setBudget( uint32_t nbOperationsPerSec, uint64_t nbBytesPerSec )
+{
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    m_nbOperationsPerSec = nbOperationsPerSec;
+    m_nbBytesPerSec = nbBytesPerSec;
+    updateRates();
+}
+
+void Governor::setPlaybackActive( bool active )
+{
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    if ( m_playbackActive == active )
+        return;
+    LOG_INFO( "Playback is now ", active ? "active" : "inactive" );
+    m_playbackActive = active;
+    updateRates();
+}
+
+bool Governor::isPlaybackActive() const
+{
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    return m_playbackActive;
+}
+
+bool Governor::acquire( const std::atomic_bool* interrupted )
+{
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    while ( m_stopped == false )
+    {
+        if ( interrupted != nullptr && *interrupted == true )
+            return false;
+        auto now = std::chrono::steady_clock::now();
+        m_operations.refill( now );
+        m_bytes.refill( now );
+        auto wait = std::max( m_operations.debt(), m_bytes.debt() );
+        if ( wait == std::chrono::steady_clock::duration::zero() )
+            break;
+        if ( interrupted != nullptr )
+            wait = std::min<std::chrono::steady_clock::duration>( wait, InterruptibleWait );
+        auto nbUpdates = m_nbUpdates;
+        m_cond.wait_for( lock, wait, [this, nbUpdates]() {
+            return m_stopped == true || m_nbUpdates != nbUpdates;
+        });
+    }
+    return true;
+}
+
+void Governor::charge( uint32_t nbOperations )
+{
+    // The bytes read by each thread are only known as a running total
+    static thread_local uint64_t lastReadBytes = 0;
+    auto readBytes = threadReadBytes();
+    auto nbBytes = readBytes > lastReadBytes ? readBytes - lastReadBytes : 0;
+    lastReadBytes = readBytes;
+
+    std::lock_guard<compat::Mutex> lock( m_mutex );
+    auto now = std::chrono::steady_clock::now();
+    m_operations.refill( now );
+    m_bytes.refill( now );
+    if ( m_operations.rate != 0 )
+        m_operations.tokens -= nbOperations;
+    if ( m_bytes.rate != 0 )
+        m_bytes.tokens -= nbBytes;
+}
+
+void Governor::stop()
+{
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_stopped = true;
+    }
+    m_cond.notify_all();
+}
+
+void Governor::setBackgroundPriority()
+{
+#ifdef __linux__
+    auto tid = static_cast<id_t>( syscall( SYS_gettid ) );
+    // On linux, the niceness is a per thread attribute
+    if ( setpriority( PRIO_PROCESS, tid, BackgroundNiceness ) != 0 )
+        LOG_WARN( "Failed to lower the thread CPU priority" );
+# ifdef SYS_ioprio_set
+    auto ioprio = ( IoprioClassBestEffort << IoprioClassShift ) | IoprioLowest;
+    if ( syscall( SYS_ioprio_set, IoprioWhoProcess, tid, ioprio ) != 0 )
+        LOG_WARN( "Failed to lower the thread I/O priority" );
+# endif
+#endif
+}
+
+void Governor::updateRates()
+{
+    auto nbOperations = m_nbOperationsPerSec;
+    auto nbBytes = m_nbBytesPerSec;
+    if ( m_playbackActive == true )
+    {
+        if ( nbOperations == 0 || nbOperations > PlaybackOperationsPerSec )
+            nbOperations = PlaybackOperationsPerSec;
+        if ( nbBytes == 0 || nbBytes > PlaybackBytesPerSec )
+            nbBytes = PlaybackBytesPerSec;
+    }
+    auto now = std::chrono::steady_clock::now();
+    m_operations.refill( now );
+    m_bytes.refill( now );
+    m_operations.setRate( nbOperations );
+    m_bytes.setRate( nbBytes );
+    ++m_nbUpdates;
+    m_cond.notify_all();
+}
+
+uint64_t Governor::threadReadBytes()
+{
+#ifdef __linux__
+    char path[64];
+    snprintf( path, sizeof( path ), "/proc/self/task/%ld/io", syscall( SYS_gettid ) );
+    auto f = fopen( path, "r" );
+    if ( f == nullptr )
+        return 0;
+    char line[64];
+    unsigned long long readBytes = 0;
+    while ( fgets( line, sizeof( line ), f ) != nullptr )
+    {
+        // Only account for the bytes actually fetched from the storage, since
+        // reading from the page cache doesn't compete with the playback
+        if ( sscanf( line, "read_bytes: %llu", &readBytes ) == 1 )
+            break;
+    }
+    fclose( f );
+    return readBytes;
+#else
+    return 0;
+#endif
+}
+
+}
+
+}
@@ -0,0 +1,118 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+
+namespace medialibrary
+{
+
+namespace utils
+{
+
+///
+/// \brief The Governor class limits the resources used by the background
+/// threads (discovery & parsing), so that they don't compete with the playback.
+///
+/// The budget is expressed as a number of filesystem operations and a number
+/// of bytes read per second, each one being backed by a token bucket. The
+/// threads charge the resources they used once they're done, which can put the
+/// buckets in debt, and call acquire() before their next operation, which
+/// blocks until the debt is paid off.
+/// When the playback is active, the budget drops to a few operations per
+/// second, regardless of the configured one.
+///
+class Governor
+{
+public:
+    // A rate of 0 means unlimited
+    static const uint32_t DefaultOperationsPerSec = 0;
+    static const uint64_t DefaultBytesPerSec = 0;
+    static const uint32_t PlaybackOperationsPerSec = 10;
+    static const uint64_t PlaybackBytesPerSec = 256 * 1024;
+
+    Governor();
+
+    void setBudget( uint32_t nbOperationsPerSec, uint64_t nbBytesPerSec );
+    void setPlaybackActive( bool active );
+    bool isPlaybackActive() const;
+    ///
+    /// \brief acquire Blocks until the budget allows another operation
+    /// \param interrupted An optional flag checked while waiting
+    /// \return false if the wait was interrupted
+    ///
+    bool acquire( const std::atomic_bool* interrupted = nullptr );
+    ///
+    /// \brief charge Accounts for the operations the calling thread performed
+    /// since its last call, along with the bytes it read from the storage.
+    ///
+    void charge( uint32_t nbOperations );
+    ///
+    /// \brief stop Releases the waiting threads, and disables any throttling
+    ///
+    void stop();
+
+    ///
+    /// \brief setBackgroundPriority Lowers the CPU & I/O priority of the
+    /// calling thread, so the kernel favors the player over it.
+    ///
+    static void setBackgroundPriority();
+
+private:
+    struct Bucket
+    {
+        Bucket();
+        void setRate( uint64_t rate );
+        void refill( std::chrono::steady_clock::time_point now );
+        // Returns the time left until the debt is paid off
+        std::chrono::steady_clock::duration debt() const;
+
+        uint64_t rate;
+        double tokens;
+        std::chrono::steady_clock::time_point lastRefill;
+    };
+
+    void updateRates();
+    static uint64_t threadReadBytes();
+
+private:
+    mutable compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    Bucket m_operations;
+    Bucket m_bytes;
+    uint32_t m_nbOperationsPerSec;
+    uint64_t m_nbBytesPerSec;
+    bool m_playbackActive;
+    bool m_stopped;
+    // Incremented each time the rates change, to wake up the waiting threads
+    uint32_t m_nbUpdates;
+};
+
+}
+
+}
@@ -42,6 +42,17 @@ namespace medialibrary
                     return false;
                 }
             }
+
+            std::string caseFold( const std::string& str )
+            {
+                std::string res = str;
+                for ( auto& c : res )
+                {
+                    if ( c >= 'A' && c <= 'Z' )
+                        c = c - 'A' + 'a';
+                }
+                return res;
+            }
         }
     }
 }
@@ -29,6 +29,8 @@ namespace medialibrary
         namespace string
         {
             bool endsWith (std::string const &fullString, std::string const &ending);
+            // Lowercases the ASCII letters only, as sqlite's NOCASE collation does
+            std::string caseFold( const std::string& str );
         }
     }
 }
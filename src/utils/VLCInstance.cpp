@@ -28,43 +28,35 @@
 #include "logging/Logger.h"
 #include "vlcpp/vlc.hpp"
 
-namespace
-{
-// Define this in the .cpp file to avoid including libvlcpp from the header.
-struct Init
-{
-    Init()
-    {
-        const char* args[] = {
-            "--no-lua",
-        };
-        instance = VLC::Instance( sizeof(args) / sizeof(args[0]), args );
-        // Do not take the string by reference. libvlcpp is constructing the std::string
-        // as it calls the log callback, so the string we receive will be move constructed
-        instance.logSet([this](int lvl, const libvlc_log_t*, std::string msg) {
-            if ( medialibrary::Log::logLevel() != medialibrary::LogLevel::Verbose )
-                return;
-            if ( lvl == LIBVLC_ERROR )
-                medialibrary::Log::Error( msg );
-            else if ( lvl == LIBVLC_WARNING )
-                medialibrary::Log::Warning( msg );
-            else
-                medialibrary::Log::Info( msg );
-        });
-    }
-
-    VLC::Instance instance;
-};
-}
-
 namespace medialibrary
 {
 
 VLC::Instance& VLCInstance::get()
 {
-    // Instanciate the wrapper only once, and run initialization in its constructor.
-    static Init wrapper;
-    return wrapper.instance;
+    // Instanciate the shared instance only once
+    static VLC::Instance instance = create();
+    return instance;
+}
+
+VLC::Instance VLCInstance::create()
+{
+    const char* args[] = {
+        "--no-lua",
+    };
+    VLC::Instance instance( sizeof(args) / sizeof(args[0]), args );
+    // Do not take the string by reference. libvlcpp is constructing the std::string
+    // as it calls the log callback, so the string we receive will be move constructed
+    instance.logSet([](int lvl, const libvlc_log_t*, std::string msg) {
+        if ( Log::logLevel() != LogLevel::Verbose )
+            return;
+        if ( lvl == LIBVLC_ERROR )
+            Log::Error( msg );
+        else if ( lvl == LIBVLC_WARNING )
+            Log::Warning( msg );
+        else
+            Log::Info( msg );
+    });
+    return instance;
 }
 
 }
@@ -34,6 +34,12 @@ class VLCInstance
 {
 public:
     static VLC::Instance& get();
+    ///
+    /// \brief create Creates a new instance, configured like the shared one.
+    /// A libvlc instance only preparses one media at a time, so this allows
+    /// multiple medias to be parsed concurrently.
+    ///
+    static VLC::Instance create();
 };
 
 }
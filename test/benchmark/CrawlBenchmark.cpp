@@ -0,0 +1,372 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "unittest/Tests.h"
+
+#include "database/SqliteConnection.h"
+#include "discoverer/FsDiscoverer.h"
+#include "discoverer/probe/CrawlerProbe.h"
+#include "factory/FileSystemFactory.h"
+#include "filesystem/common/CommonDirectory.h"
+#include "mocks/FileSystem.h"
+#include "utils/Filename.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <ftw.h>
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+
+// Describes a synthetic tree: each folder contains filesPerDir files and
+// fanOut subfolders, down to the provided depth.
+struct TreeSpec
+{
+    const char* name;
+    unsigned int depth;
+    unsigned int fanOut;
+    unsigned int filesPerDir;
+    // Extensions are assigned to files in a round robin fashion, each one
+    // being repeated according to its weight
+    std::vector<std::pair<const char*, unsigned int>> extensions;
+    // Injected before each folder listing
+    std::chrono::milliseconds latency;
+    unsigned int nbCrawlerThreads;
+};
+
+enum class Backend
+{
+    Mock,
+    Tmpfs,
+};
+
+struct Scenario
+{
+    TreeSpec tree;
+    Backend backend;
+};
+
+const std::vector<std::pair<const char*, unsigned int>> MediaMix = {
+    { "mkv", 3 }, { "mp3", 5 }, { "avi", 1 }, { "jpg", 1 }, { "nfo", 1 }, { "srt", 1 }
+};
+
+const TreeSpec Trees[] = {
+    { "Wide", 2, 20, 20, MediaMix, std::chrono::milliseconds{ 0 }, 1 },
+    { "Deep", 6, 3, 5, MediaMix, std::chrono::milliseconds{ 0 }, 1 },
+    { "DeepCrawler", 6, 3, 5, MediaMix, std::chrono::milliseconds{ 0 }, 4 },
+    { "Slow", 3, 4, 5, MediaMix, std::chrono::milliseconds{ 2 }, 1 },
+    { "SlowCrawler", 3, 4, 5, MediaMix, std::chrono::milliseconds{ 2 }, 4 },
+};
+
+struct TreeStats
+{
+    size_t nbFolders;
+    size_t nbFiles;
+};
+
+// Generates the tree by invoking the provided callbacks with the path of
+// each folder & file, relative to the tree root. Parents are always created
+// before their content.
+template <typename AddFolder, typename AddFile>
+void generate( const TreeSpec& spec, const std::string& path, unsigned int depth,
+               TreeStats& stats, AddFolder&& addFolder, AddFile&& addFile )
+{
+    auto totalWeight = 0u;
+    for ( const auto& e : spec.extensions )
+        totalWeight += e.second;
+    for ( auto i = 0u; i < spec.filesPerDir; ++i )
+    {
+        auto w = ( stats.nbFiles + i ) % totalWeight;
+        auto ext = begin( spec.extensions );
+        while ( w >= ext->second )
+        {
+            w -= ext->second;
+            ++ext;
+        }
+        addFile( path + "file " + std::to_string( i ) + "." + ext->first );
+    }
+    stats.nbFiles += spec.filesPerDir;
+    if ( depth == spec.depth )
+        return;
+    for ( auto i = 0u; i < spec.fanOut; ++i )
+    {
+        auto folder = path + "folder " + std::to_string( i ) + "/";
+        addFolder( folder );
+        ++stats.nbFolders;
+        generate( spec, folder, depth + 1, stats, addFolder, addFile );
+    }
+}
+
+// Forwards to another directory after waiting for the injected latency
+class SlowDirectory : public fs::CommonDirectory
+{
+public:
+    SlowDirectory( std::shared_ptr<fs::IDirectory> dir, factory::IFileSystem& fsFactory,
+                   std::chrono::milliseconds latency )
+        : CommonDirectory( fsFactory )
+        , m_dir( std::move( dir ) )
+        , m_latency( latency )
+    {
+    }
+
+    virtual const std::string& mrl() const override
+    {
+        return m_dir->mrl();
+    }
+
+    virtual unsigned int lastModificationDate() const override
+    {
+        return m_dir->lastModificationDate();
+    }
+
+private:
+    virtual void read() const override
+    {
+        std::this_thread::sleep_for( m_latency );
+        m_files = m_dir->files();
+        for ( const auto& d : m_dir->dirs() )
+            m_dirs.push_back( std::make_shared<SlowDirectory>( d, m_fsFactory, m_latency ) );
+    }
+
+private:
+    std::shared_ptr<fs::IDirectory> m_dir;
+    std::chrono::milliseconds m_latency;
+};
+
+class SlowFileSystemFactory : public factory::IFileSystem
+{
+public:
+    SlowFileSystemFactory( std::shared_ptr<factory::IFileSystem> fs, std::chrono::milliseconds latency )
+        : m_fs( std::move( fs ) )
+        , m_latency( latency )
+    {
+    }
+
+    virtual std::shared_ptr<fs::IDirectory> createDirectory( const std::string& mrl ) override
+    {
+        auto dir = m_fs->createDirectory( mrl );
+        if ( m_latency == std::chrono::milliseconds::zero() )
+            return dir;
+        return std::make_shared<SlowDirectory>( std::move( dir ), *this, m_latency );
+    }
+
+    virtual std::shared_ptr<fs::IDevice> createDevice( const std::string& uuid ) override
+    {
+        return m_fs->createDevice( uuid );
+    }
+
+    virtual std::shared_ptr<fs::IDevice> createDeviceFromMrl( const std::string& mrl ) override
+    {
+        return m_fs->createDeviceFromMrl( mrl );
+    }
+
+    virtual void refreshDevices() override
+    {
+        m_fs->refreshDevices();
+    }
+
+    virtual bool isMrlSupported( const std::string& mrl ) const override
+    {
+        return m_fs->isMrlSupported( mrl );
+    }
+
+    virtual bool isNetworkFileSystem() const override
+    {
+        return m_fs->isNetworkFileSystem();
+    }
+
+private:
+    std::shared_ptr<factory::IFileSystem> m_fs;
+    std::chrono::milliseconds m_latency;
+};
+
+// Exposes the whole real filesystem as a single device
+class SingleDeviceLister : public IDeviceLister
+{
+public:
+    virtual std::vector<std::tuple<std::string, std::string, bool>> devices() const override
+    {
+        return { std::make_tuple( "{bench-device}", "file:///", false ) };
+    }
+};
+
+// Resets the peak resident set size, so each phase reports its own peak.
+// This requires linux 4.0, otherwise the process peak is reported.
+void resetPeakRss()
+{
+    auto f = fopen( "/proc/self/clear_refs", "w" );
+    if ( f == nullptr )
+        return;
+    fputs( "5", f );
+    fclose( f );
+}
+
+// Returns the peak resident set size, in KiB
+long peakRss()
+{
+    auto f = fopen( "/proc/self/status", "r" );
+    if ( f != nullptr )
+    {
+        char line[128];
+        long hwm = -1;
+        while ( fgets( line, sizeof( line ), f ) != nullptr )
+        {
+            if ( sscanf( line, "VmHWM: %ld", &hwm ) == 1 )
+                break;
+        }
+        fclose( f );
+        if ( hwm >= 0 )
+            return hwm;
+    }
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        return 0;
+    return usage.ru_maxrss;
+}
+
+}
+
+class CrawlBench : public Tests, public testing::WithParamInterface<Scenario>
+{
+protected:
+    std::string root;
+    std::string tmpDir;
+    TreeStats stats{ 0, 0 };
+    std::unique_ptr<FsDiscoverer> discoverer;
+
+    virtual void SetUp() override
+    {
+        unlink( "test.db" );
+        const auto& scenario = GetParam();
+        std::shared_ptr<factory::IFileSystem> fs;
+        if ( scenario.backend == Backend::Mock )
+        {
+            auto fsMock = std::make_shared<mock::FileSystemFactory>();
+            root = mock::FileSystemFactory::Root + "tree/";
+            fsMock->addFolder( root );
+            generate( scenario.tree, root, 0, stats,
+                      [&fsMock]( const std::string& f ) { fsMock->addFolder( f ); },
+                      [&fsMock]( const std::string& f ) { fsMock->addFile( f ); } );
+            fs = std::move( fsMock );
+        }
+        else
+        {
+            // Prefer a tmpfs, so we measure the crawler rather than the disk
+            char tmpl[] = "/dev/shm/mlbenchXXXXXX";
+            char fallbackTmpl[] = "/tmp/mlbenchXXXXXX";
+            auto dir = mkdtemp( tmpl );
+            if ( dir == nullptr )
+                dir = mkdtemp( fallbackTmpl );
+            ASSERT_NE( nullptr, dir );
+            tmpDir = utils::file::toFolderPath( dir );
+            auto success = true;
+            generate( scenario.tree, tmpDir, 0, stats,
+                      [&success]( const std::string& f ) {
+                          success &= mkdir( f.c_str(), 0700 ) == 0;
+                      },
+                      [&success]( const std::string& f ) {
+                          auto fd = open( f.c_str(), O_CREAT | O_WRONLY, 0600 );
+                          success &= fd != -1;
+                          if ( fd != -1 )
+                              close( fd );
+                      } );
+            ASSERT_TRUE( success );
+            root = utils::file::toMrl( tmpDir );
+            fs = std::make_shared<factory::FileSystemFactory>( std::make_shared<SingleDeviceLister>() );
+        }
+        if ( scenario.tree.latency != std::chrono::milliseconds::zero() )
+            fs = std::make_shared<SlowFileSystemFactory>( std::move( fs ), scenario.tree.latency );
+        Reload( fs );
+        auto probe = std::unique_ptr<prober::CrawlerProbe>( new prober::CrawlerProbe{} );
+        discoverer.reset( new FsDiscoverer( fs, ml.get(), nullptr, std::move( probe ),
+                                            scenario.tree.nbCrawlerThreads ) );
+    }
+
+    virtual void TearDown() override
+    {
+        discoverer.reset();
+        Tests::TearDown();
+        if ( tmpDir.empty() == true )
+            return;
+        nftw( tmpDir.c_str(), []( const char* path, const struct stat*, int, struct FTW* ) {
+            return remove( path );
+        }, 16, FTW_DEPTH | FTW_PHYS );
+    }
+
+    // Runs the provided function and reports its throughput
+    template <typename Func>
+    void measure( const char* label, Func&& f )
+    {
+        auto db = ml->getConn()->handle();
+        auto nbChanges = sqlite3_total_changes( db );
+        resetPeakRss();
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto duration = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        auto nbWrites = sqlite3_total_changes( db ) - nbChanges;
+        auto nbEntries = stats.nbFolders + stats.nbFiles;
+        std::cout << "[ BENCH    ] " << GetParam().tree.name
+                  << ( GetParam().backend == Backend::Mock ? "/mock " : "/tmpfs " )
+                  << label << ": " << static_cast<int64_t>( duration * 1000 ) << "ms, "
+                  << static_cast<int64_t>( nbEntries / duration ) << " entries/s, "
+                  << static_cast<int64_t>( nbWrites / duration ) << " DB writes/s, "
+                  << "peak RSS " << peakRss() << "KiB" << std::endl;
+    }
+};
+
+TEST_P( CrawlBench, DiscoverReload )
+{
+    measure( "Discover", [this] {
+        ASSERT_TRUE( discoverer->discover( root ) );
+    });
+    auto folder = ml->folder( root );
+    ASSERT_NE( nullptr, folder );
+    ASSERT_EQ( GetParam().tree.fanOut, folder->folders().size() );
+
+    measure( "Reload", [this] {
+        ASSERT_TRUE( discoverer->reload( root ) );
+    });
+    ASSERT_EQ( GetParam().tree.fanOut, folder->folders().size() );
+}
+
+static std::vector<Scenario> scenarios()
+{
+    std::vector<Scenario> res;
+    for ( const auto& t : Trees )
+    {
+        res.push_back( Scenario{ t, Backend::Mock } );
+        res.push_back( Scenario{ t, Backend::Tmpfs } );
+    }
+    return res;
+}
+
+INSTANTIATE_TEST_CASE_P( SyntheticTrees, CrawlBench, testing::ValuesIn( scenarios() ) );
@@ -0,0 +1,166 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include "filesystem/unix/Directory.h"
+#include "filesystem/IFile.h"
+#include "mocks/FileSystem.h"
+#include "utils/Filename.h"
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace medialibrary;
+
+namespace
+{
+
+const unsigned int NbFolders = 100;
+const unsigned int NbSubfolders = 10;
+const unsigned int NbFiles = 20;
+
+// Lists a folder the way fs::Directory used to: by building the full path of
+// each entry, stat'ing it, and resolving subfolders before converting them
+// to an mrl
+size_t listReference( const std::string& path )
+{
+    std::unique_ptr<DIR, int(*)(DIR*)> dir( opendir( path.c_str() ), closedir );
+    if ( dir == nullptr )
+        return 0;
+    size_t nbEntries = 0;
+    dirent* result;
+    while ( ( result = readdir( dir.get() ) ) != nullptr )
+    {
+        if ( result->d_name[0] == '.' )
+            continue;
+        auto entryPath = path + result->d_name;
+        struct stat s;
+        if ( lstat( entryPath.c_str(), &s ) != 0 )
+            continue;
+        ++nbEntries;
+        if ( S_ISDIR( s.st_mode ) )
+        {
+            char abs[PATH_MAX];
+            if ( realpath( entryPath.c_str(), abs ) == nullptr )
+                continue;
+            auto folderPath = utils::file::toFolderPath( abs );
+            nbEntries += utils::file::toMrl( folderPath ).size() > 0;
+            nbEntries += listReference( folderPath );
+        }
+        else
+            nbEntries += utils::file::toMrl( entryPath ).size() > 0;
+    }
+    return nbEntries;
+}
+
+size_t list( const fs::IDirectory& dir )
+{
+    size_t nbEntries = 0;
+    for ( const auto& f : dir.files() )
+        nbEntries += 1 + ( f->mrl().size() > 0 );
+    for ( const auto& d : dir.dirs() )
+        nbEntries += 1 + ( d->mrl().size() > 0 ) + list( *d );
+    return nbEntries;
+}
+
+// Runs the provided function and reports how long it took
+template <typename Func>
+size_t measure( const char* label, Func&& f )
+{
+    auto start = std::chrono::steady_clock::now();
+    auto res = f();
+    auto duration = std::chrono::steady_clock::now() - start;
+    std::cout << "[ BENCH    ] " << label << ": "
+              << std::chrono::duration_cast<std::chrono::milliseconds>( duration ).count()
+              << "ms" << std::endl;
+    return res;
+}
+
+}
+
+class DirectoryBench : public testing::Test
+{
+protected:
+    std::string root;
+    mock::NoopFsFactory fsFactory;
+
+    virtual void SetUp() override
+    {
+        char tmpl[] = "/tmp/mlbenchXXXXXX";
+        ASSERT_NE( nullptr, mkdtemp( tmpl ) );
+        root = utils::file::toFolderPath( tmpl );
+        for ( auto i = 0u; i < NbFolders; ++i )
+        {
+            auto folder = root + "folder" + std::to_string( i ) + "/";
+            ASSERT_EQ( 0, mkdir( folder.c_str(), 0700 ) );
+            for ( auto j = 0u; j < NbSubfolders; ++j )
+            {
+                auto subfolder = folder + "sub folder " + std::to_string( j ) + "/";
+                ASSERT_EQ( 0, mkdir( subfolder.c_str(), 0700 ) );
+                for ( auto k = 0u; k < NbFiles; ++k )
+                {
+                    auto file = subfolder + "file " + std::to_string( k ) + ".mkv";
+                    auto fd = open( file.c_str(), O_CREAT | O_WRONLY, 0600 );
+                    ASSERT_NE( -1, fd );
+                    close( fd );
+                }
+            }
+        }
+    }
+
+    virtual void TearDown() override
+    {
+        if ( root.empty() == true )
+            return;
+        nftw( root.c_str(), []( const char* path, const struct stat*, int, struct FTW* ) {
+            return remove( path );
+        }, 16, FTW_DEPTH | FTW_PHYS );
+    }
+};
+
+TEST_F( DirectoryBench, ListTree )
+{
+    // Warm the kernel caches up so both listings run in the same conditions
+    listReference( root );
+
+    auto expected = measure( "Reference listing", [this] {
+        return listReference( root );
+    });
+    auto nbEntries = measure( "fs::Directory listing", [this] {
+        fs::Directory dir( utils::file::toMrl( root ), fsFactory );
+        return list( dir );
+    });
+    ASSERT_EQ( expected, nbEntries );
+    ASSERT_EQ( ( NbFolders * ( 1 + NbSubfolders * ( 1 + NbFiles ) ) ) * 2, nbEntries );
+}
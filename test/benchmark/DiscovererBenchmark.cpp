@@ -0,0 +1,227 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "unittest/Tests.h"
+
+#include "Folder.h"
+#include "discoverer/FsDiscoverer.h"
+#include "discoverer/probe/CrawlerProbe.h"
+#include "filesystem/common/CommonDirectory.h"
+#include "mocks/FileSystem.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+
+const unsigned int NbFiles = 50000;
+const unsigned int NbFolders = 5000;
+const unsigned int NbNetworkFolders = 10;
+const std::chrono::milliseconds NetworkLatency{ 10 };
+
+// Runs the provided function and reports how long it took
+template <typename Func>
+int64_t measure( const char* label, Func&& f )
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start ).count();
+    std::cout << "[ BENCH    ] " << label << ": " << duration << "ms" << std::endl;
+    return duration;
+}
+
+// Stands for a network share folder: listing it waits for a round trip to
+// the server, and it doesn't expose any modification date
+class LatencyDirectory : public fs::CommonDirectory
+{
+public:
+    LatencyDirectory( std::shared_ptr<fs::IDirectory> dir, factory::IFileSystem& fsFactory )
+        : CommonDirectory( fsFactory )
+        , m_dir( std::move( dir ) )
+    {
+    }
+
+    virtual const std::string& mrl() const override
+    {
+        return m_dir->mrl();
+    }
+
+    virtual unsigned int lastModificationDate() const override
+    {
+        return 0;
+    }
+
+private:
+    virtual void read() const override
+    {
+        std::this_thread::sleep_for( NetworkLatency );
+        m_files = m_dir->files();
+        for ( const auto& d : m_dir->dirs() )
+            m_dirs.push_back( std::make_shared<LatencyDirectory>( d, m_fsFactory ) );
+    }
+
+private:
+    std::shared_ptr<fs::IDirectory> m_dir;
+};
+
+class LatencyFileSystemFactory : public mock::FileSystemFactory
+{
+public:
+    virtual std::shared_ptr<fs::IDirectory> createDirectory( const std::string& mrl ) override
+    {
+        return std::make_shared<LatencyDirectory>( mock::FileSystemFactory::createDirectory( mrl ), *this );
+    }
+
+    virtual bool isNetworkFileSystem() const override
+    {
+        return true;
+    }
+};
+
+}
+
+class DiscovererBench : public Tests
+{
+protected:
+    static const std::string LargeFolder;
+
+    std::shared_ptr<mock::FileSystemFactory> fsMock;
+    std::unique_ptr<FsDiscoverer> discoverer;
+
+    virtual void SetUp() override
+    {
+        unlink( "test.db" );
+        fsMock.reset( new mock::FileSystemFactory );
+        fsMock->addFolder( LargeFolder );
+        Reload( fsMock );
+        auto probe = std::unique_ptr<prober::CrawlerProbe>( new prober::CrawlerProbe{} );
+        discoverer.reset( new FsDiscoverer( fsMock, ml.get(), nullptr, std::move( probe ) ) );
+    }
+
+    virtual void TearDown() override
+    {
+        discoverer.reset();
+        Tests::TearDown();
+    }
+};
+
+const std::string DiscovererBench::LargeFolder = mock::FileSystemFactory::Root + "large/";
+
+TEST_F( DiscovererBench, LargeFolderFiles )
+{
+    for ( auto i = 0u; i < NbFiles; ++i )
+        fsMock->addFile( LargeFolder + "file" + std::to_string( i ) + ".mkv" );
+
+    measure( "Discover", [this] {
+        ASSERT_TRUE( discoverer->discover( mock::FileSystemFactory::Root ) );
+    });
+    auto folder = ml->folder( LargeFolder );
+    ASSERT_EQ( NbFiles, folder->files().size() );
+
+    // Adding a file updates the folder modification date, so its whole
+    // content gets matched against the database again
+    fsMock->addFile( LargeFolder + "newfile.mkv" );
+    measure( "Reload with a new file", [this] {
+        ASSERT_TRUE( discoverer->reload( mock::FileSystemFactory::Root ) );
+    });
+    ASSERT_EQ( NbFiles + 1, folder->files().size() );
+
+    fsMock->removeFile( LargeFolder + "file0.mkv" );
+    measure( "Reload with a removed file", [this] {
+        ASSERT_TRUE( discoverer->reload( mock::FileSystemFactory::Root ) );
+    });
+    ASSERT_EQ( NbFiles, folder->files().size() );
+}
+
+TEST_F( DiscovererBench, LargeFolderSubfolders )
+{
+    for ( auto i = 0u; i < NbFolders; ++i )
+        fsMock->addFolder( LargeFolder + "folder" + std::to_string( i ) + "/" );
+
+    measure( "Discover", [this] {
+        ASSERT_TRUE( discoverer->discover( mock::FileSystemFactory::Root ) );
+    });
+    auto folder = ml->folder( LargeFolder );
+    ASSERT_EQ( NbFolders, folder->folders().size() );
+
+    fsMock->addFolder( LargeFolder + "newfolder/" );
+    measure( "Reload with a new folder", [this] {
+        ASSERT_TRUE( discoverer->reload( mock::FileSystemFactory::Root ) );
+    });
+    ASSERT_EQ( NbFolders + 1, folder->folders().size() );
+
+    fsMock->removeFolder( LargeFolder + "folder0/" );
+    measure( "Reload with a removed folder", [this] {
+        ASSERT_TRUE( discoverer->reload( mock::FileSystemFactory::Root ) );
+    });
+    ASSERT_EQ( NbFolders, folder->folders().size() );
+}
+
+TEST_F( DiscovererBench, NetworkLatency )
+{
+    auto fs = std::make_shared<LatencyFileSystemFactory>();
+    for ( const auto& share : { "sequential/", "pipelined/" } )
+    {
+        fs->addFolder( mock::FileSystemFactory::Root + share );
+        for ( auto i = 0u; i < NbNetworkFolders; ++i )
+        {
+            auto folder = mock::FileSystemFactory::Root + share + "folder" + std::to_string( i ) + "/";
+            fs->addFolder( folder );
+            for ( auto j = 0u; j < NbNetworkFolders; ++j )
+            {
+                auto subFolder = folder + "subfolder" + std::to_string( j ) + "/";
+                fs->addFolder( subFolder );
+                fs->addFile( subFolder + "file.mkv" );
+            }
+        }
+    }
+    Reload( fs );
+    FsDiscoverer sequential( fs, ml.get(), nullptr,
+                             std::unique_ptr<prober::CrawlerProbe>( new prober::CrawlerProbe{} ), 1 );
+    FsDiscoverer pipelined( fs, ml.get(), nullptr,
+                            std::unique_ptr<prober::CrawlerProbe>( new prober::CrawlerProbe{} ), 8 );
+
+    auto sequentialDuration = measure( "Discover, one listing at a time", [&sequential] {
+        ASSERT_TRUE( sequential.discover( mock::FileSystemFactory::Root + "sequential/" ) );
+    });
+    auto pipelinedDuration = measure( "Discover, 8 listings in flight", [&pipelined] {
+        ASSERT_TRUE( pipelined.discover( mock::FileSystemFactory::Root + "pipelined/" ) );
+    });
+    auto folder = ml->folder( mock::FileSystemFactory::Root + "pipelined/" );
+    ASSERT_EQ( NbNetworkFolders, folder->folders().size() );
+
+    // Network folders are all listed again when reloading
+    auto reloadDuration = measure( "Reload, 8 listings in flight", [&pipelined] {
+        ASSERT_TRUE( pipelined.reload( mock::FileSystemFactory::Root + "pipelined/" ) );
+    });
+    ASSERT_EQ( NbNetworkFolders, folder->folders().size() );
+
+    EXPECT_LT( pipelinedDuration * 2, sequentialDuration );
+    EXPECT_LT( reloadDuration * 2, sequentialDuration );
+}
@@ -0,0 +1,165 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "unittest/Tests.h"
+
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "filesystem/IFile.h"
+#include "filesystem/unix/Directory.h"
+#include "metadata_services/vlc/VLCMetadataService.h"
+#include "mocks/FileSystem.h"
+#include "parser/Parser.h"
+#include "parser/ParserService.h"
+#include "utils/Filename.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+// Points to a folder containing the sample medias
+const char* CorpusEnvVar = "MEDIALIB_BENCH_CORPUS";
+const unsigned int NbThreads[] = { 1, 2, 4, 8 };
+
+// Terminates the pipeline after the metadata extraction
+class CompletionService : public ParserService
+{
+public:
+    virtual const char* name() const override
+    {
+        return "Completion";
+    }
+
+    virtual uint8_t nbThreads() const override
+    {
+        return 1;
+    }
+
+private:
+    virtual parser::Task::Status run( parser::Task& task ) override
+    {
+        task.markStepCompleted( parser::Task::ParserStep::Completed );
+        return parser::Task::Status::Success;
+    }
+
+    virtual bool isCompleted( const parser::Task& ) const override
+    {
+        return false;
+    }
+};
+
+// Reports when all the queued tasks went through the pipeline, including
+// the failed ones
+class ProgressCallback : public mock::NoopCallback
+{
+public:
+    ProgressCallback()
+        : m_done( false )
+    {
+    }
+
+    virtual void onParsingStatsUpdated( uint32_t percent ) override
+    {
+        if ( percent != 100 )
+            return;
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_done = true;
+        m_cond.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        m_cond.wait( lock, [this]() {
+            return m_done == true;
+        });
+        m_done = false;
+    }
+
+private:
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    bool m_done;
+};
+
+void listMedias( const fs::IDirectory& dir, std::vector<std::shared_ptr<fs::IFile>>& medias )
+{
+    for ( const auto& f : dir.files() )
+    {
+        if ( MediaLibrary::isExtensionSupported( f->extension().c_str() ) == true )
+            medias.push_back( f );
+    }
+    for ( const auto& d : dir.dirs() )
+        listMedias( *d, medias );
+}
+
+}
+
+class MetadataExtractionBench : public Tests
+{
+protected:
+    ProgressCallback progress;
+
+    virtual void SetUp() override
+    {
+        unlink( "test.db" );
+        Reload( nullptr, &progress );
+    }
+};
+
+TEST_F( MetadataExtractionBench, Corpus )
+{
+    auto corpus = getenv( CorpusEnvVar );
+    if ( corpus == nullptr )
+    {
+        std::cout << "[ BENCH    ] " << CorpusEnvVar << " isn't set, skipping" << std::endl;
+        return;
+    }
+    mock::NoopFsFactory fsFactory;
+    fs::Directory dir( utils::file::toMrl( utils::file::toFolderPath( corpus ) ), fsFactory );
+    std::vector<std::shared_ptr<fs::IFile>> medias;
+    listMedias( dir, medias );
+    ASSERT_NE( 0u, medias.size() );
+
+    for ( auto nbThreads : NbThreads )
+    {
+        Parser parser( ml.get() );
+        parser.addService( std::unique_ptr<ParserService>( new VLCMetadataService( nbThreads ) ) );
+        parser.addService( std::unique_ptr<ParserService>( new CompletionService ) );
+        auto start = std::chrono::steady_clock::now();
+        for ( const auto& m : medias )
+            parser.parse( std::make_shared<parser::Task>( ml.get(), m, nullptr, nullptr, nullptr, 0 ) );
+        progress.wait();
+        auto duration = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        parser.stop();
+        std::cout << "[ BENCH    ] " << nbThreads << " thread(s): " << medias.size() << " medias in "
+                  << static_cast<int64_t>( duration * 1000 ) << "ms, "
+                  << medias.size() / duration << " medias/s" << std::endl;
+    }
+}
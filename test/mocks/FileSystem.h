@@ -272,6 +272,11 @@ public:
         return m_size;
     }
 
+    virtual uint64_t inode() const
+    {
+        return 0;
+    }
+
     void setLastModificationDate( unsigned int date )
     {
         m_lastModifDate = date;
@@ -342,6 +347,11 @@ class NoopDirectory : public fs::IDirectory
     {
         return std::make_shared<NoopDevice>();
     }
+
+    virtual unsigned int lastModificationDate() const override
+    {
+        abort();
+    }
 };
 
 class NoopFsFactory : public factory::IFileSystem
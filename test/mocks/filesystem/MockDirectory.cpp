@@ -24,6 +24,7 @@
 # include "config.h"
 #endif
 
+#include <atomic>
 #include <cassert>
 #include <system_error>
 
@@ -36,9 +37,17 @@
 namespace mock
 {
 
+namespace
+{
+// Use a global counter so that all directories have different dates, and
+// any modification yields a new date
+std::atomic_uint DirectoryClock{ 1 };
+}
+
 Directory::Directory( const std::string& mrl, std::shared_ptr<Device> device)
     : m_mrl( mrl )
     , m_device( device )
+    , m_lastModificationDate( DirectoryClock++ )
 {
     if ( ( *m_mrl.crbegin() ) != '/' )
         m_mrl += '/';
@@ -75,12 +84,25 @@ std::shared_ptr<fs::IDevice> Directory::device() const
     return std::static_pointer_cast<fs::IDevice>( m_device.lock() );
 }
 
+unsigned int Directory::lastModificationDate() const
+{
+    if ( m_device.lock() == nullptr )
+        throw std::system_error( ENOENT, std::generic_category(), "Failed to open mock directory" );
+    return m_lastModificationDate;
+}
+
+void Directory::markAsModified()
+{
+    m_lastModificationDate = DirectoryClock++;
+}
+
 void Directory::addFile(const std::string& filePath)
 {
     auto subFolder = utils::file::firstFolder( filePath );
     if ( subFolder.empty() == true )
     {
         m_files[filePath] = std::make_shared<File>( m_mrl + filePath );
+        markAsModified();
     }
     else
     {
@@ -99,6 +121,7 @@ void Directory::addFolder(const std::string& folder)
     {
         auto dir = std::make_shared<Directory>( m_mrl + subFolder, m_device.lock() );
         m_dirs[subFolder] = dir;
+        markAsModified();
     }
     else
     {
@@ -116,6 +139,7 @@ void Directory::removeFile(const std::string& filePath)
         auto it = m_files.find( filePath );
         assert( it != end( m_files ) );
         m_files.erase( it );
+        markAsModified();
     }
     else
     {
@@ -172,6 +196,7 @@ void Directory::removeFolder(const std::string& path)
         auto it = m_dirs.find( subFolder );
         assert( it != end( m_dirs ) );
         m_dirs.erase( it );
+        markAsModified();
     }
     else
     {
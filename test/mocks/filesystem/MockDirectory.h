@@ -44,6 +44,7 @@ public:
     virtual const std::vector<std::shared_ptr<fs::IFile>>& files() const override;
     virtual const std::vector<std::shared_ptr<fs::IDirectory>>& dirs() const override;
     virtual std::shared_ptr<fs::IDevice> device() const override;
+    virtual unsigned int lastModificationDate() const override;
     void addFile( const std::string& filePath );
     void addFolder( const std::string& folder );
     void removeFile( const std::string& filePath  );
@@ -52,6 +53,7 @@ public:
     void removeFolder( const std::string& path );
     void setMountpointRoot( const std::string& path, std::shared_ptr<Directory> root );
     void invalidateMountpoint( const std::string& path );
+    void markAsModified();
 
 private:
     std::string m_mrl;
@@ -60,6 +62,7 @@ private:
     mutable std::vector<std::shared_ptr<fs::IFile>> m_filePathes;
     mutable std::vector<std::shared_ptr<fs::IDirectory>> m_dirPathes;
     std::weak_ptr<Device> m_device;
+    unsigned int m_lastModificationDate;
 };
 
 }
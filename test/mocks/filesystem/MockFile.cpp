@@ -35,6 +35,8 @@ File::File(const std::string& mrl )
     : m_name( utils::file::fileName( mrl ) )
     , m_extension( utils::file::extension( mrl ) )
     , m_lastModification( 0 )
+    , m_size( 0 )
+    , m_inode( 0 )
     , m_mrl( mrl )
 {
 }
@@ -54,6 +56,16 @@ void File::markAsModified()
     m_lastModification++;
 }
 
+void File::setSize( unsigned int size )
+{
+    m_size = size;
+}
+
+void File::setInode( uint64_t inode )
+{
+    m_inode = inode;
+}
+
 const std::string& File::mrl() const
 {
     return m_mrl;
@@ -66,7 +78,12 @@ unsigned int File::lastModificationDate() const
 
 unsigned int File::size() const
 {
-    return 0;
+    return m_size;
+}
+
+uint64_t File::inode() const
+{
+    return m_inode;
 }
 
 }
@@ -41,13 +41,18 @@ public:
     virtual const std::string& extension() const override;
     virtual unsigned int lastModificationDate() const override;
     virtual unsigned int size() const override;
+    virtual uint64_t inode() const override;
     void markAsModified();
+    void setSize( unsigned int size );
+    void setInode( uint64_t inode );
     virtual const std::string& mrl() const override;
 
 private:
     std::string m_name;
     std::string m_extension;
     unsigned int m_lastModification;
+    unsigned int m_size;
+    uint64_t m_inode;
     std::string m_mrl;
 };
 
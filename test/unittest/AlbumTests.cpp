@@ -331,6 +331,25 @@ TEST_F( Albums, SearchAfterArtistUpdate )
     ASSERT_EQ( 1u, albums.size() );
 }
 
+TEST_F( Albums, SearchPaged )
+{
+    for ( auto i = 0u; i < 5u; ++i )
+        ml->createAlbum( "sea otters " + std::to_string( i ) );
+
+    auto albums = ml->searchAlbums( "otters", 0, 2 );
+    ASSERT_EQ( 2u, albums.size() );
+    ASSERT_EQ( "sea otters 0", albums[0]->title() );
+    ASSERT_EQ( "sea otters 1", albums[1]->title() );
+
+    albums = ml->searchAlbums( "otters", 4, 2 );
+    ASSERT_EQ( 1u, albums.size() );
+    ASSERT_EQ( "sea otters 4", albums[0]->title() );
+
+    auto count = ml->searchCount( "otters" );
+    ASSERT_EQ( 5u, count.albums );
+    ASSERT_EQ( 0u, count.artists );
+}
+
 TEST_F( Albums, AutoDelete )
 {
     auto a = ml->createAlbum( "album" );
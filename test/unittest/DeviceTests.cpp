@@ -34,6 +34,10 @@
 #include "mocks/FileSystem.h"
 #include "mocks/DiscovererCbMock.h"
 
+#if defined(__linux__) && !defined(__ANDROID__)
+# include "filesystem/unix/DeviceLister.h"
+#endif
+
 class DeviceEntity : public Tests
 {
 };
@@ -368,3 +372,40 @@ TEST_F( DeviceFs, UnknownMountpoint )
     bool discovered = cbMock->waitDiscovery();
     ASSERT_TRUE( discovered );
 }
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+TEST( DeviceLister, DiffDevices )
+{
+    using DeviceList = fs::DeviceLister::DeviceList;
+    DeviceList previous{
+        std::make_tuple( "{uuid-1}", "file:///", false ),
+        std::make_tuple( "{uuid-2}", "file:///mnt/usb/", true ),
+    };
+    // Unchanged devices aren't reported, even when their mountpoint changed
+    auto changes = fs::DeviceLister::diffDevices( previous, DeviceList{
+        std::make_tuple( "{uuid-2}", "file:///media/usb/", true ),
+        std::make_tuple( "{uuid-1}", "file:///", false ),
+    } );
+    ASSERT_EQ( 0u, changes.first.size() );
+    ASSERT_EQ( 0u, changes.second.size() );
+
+    DeviceList current{
+        std::make_tuple( "{uuid-1}", "file:///", false ),
+        std::make_tuple( "{uuid-3}", "file:///mnt/sd/", true ),
+    };
+    changes = fs::DeviceLister::diffDevices( previous, current );
+    ASSERT_EQ( 1u, changes.first.size() );
+    ASSERT_EQ( "{uuid-2}", std::get<0>( changes.first[0] ) );
+    ASSERT_EQ( "file:///mnt/usb/", std::get<1>( changes.first[0] ) );
+    ASSERT_EQ( 1u, changes.second.size() );
+    ASSERT_EQ( "{uuid-3}", std::get<0>( changes.second[0] ) );
+    ASSERT_EQ( "file:///mnt/sd/", std::get<1>( changes.second[0] ) );
+
+    // Everything is mounted when starting from scratch
+    changes = fs::DeviceLister::diffDevices( DeviceList{}, current );
+    ASSERT_EQ( 0u, changes.first.size() );
+    ASSERT_EQ( current, changes.second );
+}
+
+#endif
@@ -0,0 +1,406 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Tests.h"
+
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
+#include "discoverer/DiscovererWorker.h"
+#include "mocks/NoopCallback.h"
+
+namespace
+{
+
+// Records the operations it's asked to run. The first one blocks until it
+// gets released or interrupted, so the following tasks get queued meanwhile.
+class MockDiscoverer : public IDiscoverer
+{
+public:
+    explicit MockDiscoverer( const std::string& scheme = "file://", bool blocking = true )
+        : m_scheme( scheme )
+        , m_started( !blocking )
+        , m_released( false )
+        , m_interrupted( false )
+    {
+    }
+
+    virtual bool discover( const std::string& entryPoint ) override
+    {
+        return record( "discover " + entryPoint );
+    }
+
+    virtual bool reload() override
+    {
+        return record( "reload" );
+    }
+
+    virtual bool reload( const std::string& entryPoint ) override
+    {
+        return record( "reload " + entryPoint );
+    }
+
+    virtual bool refresh( const std::string& folder ) override
+    {
+        return record( "refresh " + folder );
+    }
+
+    virtual bool isMrlSupported( const std::string& mrl ) const override
+    {
+        return mrl.compare( 0, m_scheme.length(), m_scheme ) == 0;
+    }
+
+    virtual void setInterrupted( bool interrupted ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_interrupted = interrupted;
+        m_cond.notify_all();
+    }
+
+    bool waitStarted()
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        return m_cond.wait_for( lock, std::chrono::seconds( 5 ), [this]() {
+            return m_started;
+        });
+    }
+
+    void release()
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_released = true;
+        m_cond.notify_all();
+    }
+
+    // The blocking discoverers wait for their first call to be released
+    std::vector<std::string> waitCalls( size_t nbCalls )
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        m_cond.wait_for( lock, std::chrono::seconds( 5 ), [this, nbCalls]() {
+            return m_calls.size() >= nbCalls;
+        });
+        return m_calls;
+    }
+
+private:
+    bool record( const std::string& call )
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        m_calls.push_back( call );
+        if ( m_started == false )
+        {
+            m_started = true;
+            m_cond.notify_all();
+            m_cond.wait( lock, [this]() {
+                return m_released == true || m_interrupted == true;
+            });
+        }
+        m_cond.notify_all();
+        return true;
+    }
+
+private:
+    const std::string m_scheme;
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    std::vector<std::string> m_calls;
+    bool m_started;
+    bool m_released;
+    bool m_interrupted;
+};
+
+// Records the reload notifications of the folders, ignoring the global
+// reload the media library runs on startup
+class ReloadCallback : public mock::NoopCallback
+{
+public:
+    virtual void onReloadStarted( const std::string& entryPoint ) override
+    {
+        if ( entryPoint.empty() == true )
+            return;
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_started.push_back( entryPoint );
+    }
+
+    virtual void onReloadCompleted( const std::string& entryPoint ) override
+    {
+        if ( entryPoint.empty() == true )
+            return;
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_completed.push_back( entryPoint );
+        m_cond.notify_all();
+    }
+
+    std::vector<std::string> started()
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        return m_started;
+    }
+
+    std::vector<std::string> waitCompleted( size_t nbCompleted )
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        m_cond.wait_for( lock, std::chrono::seconds( 5 ), [this, nbCompleted]() {
+            return m_completed.size() >= nbCompleted;
+        });
+        return m_completed;
+    }
+
+private:
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    std::vector<std::string> m_started;
+    std::vector<std::string> m_completed;
+};
+
+// Keeps track of the number of notifications it handles at once
+class ConcurrencyCallback : public mock::NoopCallback
+{
+public:
+    ConcurrencyCallback()
+        : m_nbRunning( 0 )
+        , m_maxRunning( 0 )
+        , m_nbCompleted( 0 )
+    {
+    }
+
+    virtual void onReloadStarted( const std::string& ) override
+    {
+        notify( false );
+    }
+
+    virtual void onReloadCompleted( const std::string& entryPoint ) override
+    {
+        notify( entryPoint.empty() == false );
+    }
+
+    unsigned int waitCompleted( unsigned int nbCompleted )
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        m_cond.wait_for( lock, std::chrono::seconds( 5 ), [this, nbCompleted]() {
+            return m_nbCompleted >= nbCompleted;
+        });
+        return m_maxRunning;
+    }
+
+private:
+    void notify( bool completed )
+    {
+        {
+            std::lock_guard<compat::Mutex> lock( m_mutex );
+            ++m_nbRunning;
+            m_maxRunning = std::max( m_maxRunning, m_nbRunning );
+        }
+        compat::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        --m_nbRunning;
+        if ( completed == true )
+            ++m_nbCompleted;
+        m_cond.notify_all();
+    }
+
+private:
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    unsigned int m_nbRunning;
+    unsigned int m_maxRunning;
+    unsigned int m_nbCompleted;
+};
+
+}
+
+class DiscovererWorkerTests : public Tests
+{
+protected:
+    std::unique_ptr<DiscovererWorker> worker;
+    MockDiscoverer* discoverer;
+    std::unique_ptr<ReloadCallback> reloadCb;
+    std::unique_ptr<ConcurrencyCallback> concurrencyCb;
+
+    virtual void SetUp() override
+    {
+        Tests::SetUp();
+        worker.reset( new DiscovererWorker( ml.get() ) );
+        discoverer = new MockDiscoverer;
+        worker->addDiscoverer( std::unique_ptr<IDiscoverer>( discoverer ) );
+    }
+
+    virtual void TearDown() override
+    {
+        worker.reset();
+        Tests::TearDown();
+    }
+};
+
+TEST_F( DiscovererWorkerTests, CoalesceReloads )
+{
+    worker->reload( "file:///a/" );
+    ASSERT_TRUE( discoverer->waitStarted() );
+    worker->reload( "file:///b/c/" );
+    // Covers the reload of its subfolder, which gets dropped
+    worker->reload( "file:///b/" );
+    // Covered by the queued reload of its parent
+    worker->reload( "file:///b/d/" );
+    worker->reload( "file:///b/" );
+    // A reload doesn't cover a refresh
+    worker->refresh( "file:///b/c/" );
+    worker->refresh( "file:///b/c/" );
+    discoverer->release();
+
+    // Queued last, so everything else already ran when it gets called
+    worker->reload( "file:///z/" );
+    auto calls = discoverer->waitCalls( 4 );
+    std::vector<std::string> expected{
+        "reload file:///a/",
+        "reload file:///b/",
+        "refresh file:///b/c/",
+        "reload file:///z/",
+    };
+    ASSERT_EQ( expected, calls );
+}
+
+TEST_F( DiscovererWorkerTests, Priorities )
+{
+    worker->reload( "file:///a/" );
+    ASSERT_TRUE( discoverer->waitStarted() );
+    worker->reload( "file:///b/", DiscovererWorker::Priority::Background );
+    worker->reload( "file:///c/", DiscovererWorker::Priority::Device );
+    worker->refresh( "file:///d/", DiscovererWorker::Priority::Background );
+    // Raises the priority of the queued background refresh
+    worker->refresh( "file:///d/" );
+    discoverer->release();
+
+    auto calls = discoverer->waitCalls( 4 );
+    std::vector<std::string> expected{
+        "reload file:///a/",
+        "refresh file:///d/",
+        "reload file:///c/",
+        "reload file:///b/",
+    };
+    ASSERT_EQ( expected, calls );
+}
+
+TEST_F( DiscovererWorkerTests, Preemption )
+{
+    worker->reload( "file:///a/", DiscovererWorker::Priority::Background );
+    ASSERT_TRUE( discoverer->waitStarted() );
+    worker->refresh( "file:///b/", DiscovererWorker::Priority::Background );
+    worker->refresh( "file:///c/" );
+
+    // The running background reload gets interrupted, and resumed before the
+    // tasks of the same priority once the more important ones are done
+    auto calls = discoverer->waitCalls( 4 );
+    std::vector<std::string> expected{
+        "reload file:///a/",
+        "refresh file:///c/",
+        "reload file:///a/",
+        "refresh file:///b/",
+    };
+    ASSERT_EQ( expected, calls );
+}
+
+TEST_F( DiscovererWorkerTests, ConcurrentDiscoverers )
+{
+    auto localDiscoverer = new MockDiscoverer( "file://", false );
+    worker.reset( new DiscovererWorker( ml.get() ) );
+    discoverer = new MockDiscoverer( "smb://" );
+    worker->addDiscoverer( std::unique_ptr<IDiscoverer>( discoverer ) );
+    worker->addDiscoverer( std::unique_ptr<IDiscoverer>( localDiscoverer ) );
+
+    worker->reload( "smb://server/share/" );
+    ASSERT_TRUE( discoverer->waitStarted() );
+    // The blocked network discoverer doesn't hold back the local one
+    worker->refresh( "file:///a/" );
+    worker->reload();
+    auto calls = localDiscoverer->waitCalls( 2 );
+    std::vector<std::string> expected{
+        "refresh file:///a/",
+        "reload",
+    };
+    ASSERT_EQ( expected, calls );
+
+    discoverer->release();
+    calls = discoverer->waitCalls( 2 );
+    expected = {
+        "reload smb://server/share/",
+        "reload",
+    };
+    ASSERT_EQ( expected, calls );
+}
+
+TEST_F( DiscovererWorkerTests, CoalescedReloadCallbacks )
+{
+    reloadCb.reset( new ReloadCallback );
+    worker.reset();
+    Reload( nullptr, reloadCb.get() );
+    worker.reset( new DiscovererWorker( ml.get() ) );
+    discoverer = new MockDiscoverer;
+    worker->addDiscoverer( std::unique_ptr<IDiscoverer>( discoverer ) );
+
+    worker->reload( "file:///a/" );
+    ASSERT_TRUE( discoverer->waitStarted() );
+    worker->reload( "file:///b/c/" );
+    // Merges the reload of its subfolder
+    worker->reload( "file:///b/" );
+    // Merged into the queued reload of its parent
+    worker->reload( "file:///b/d/" );
+    discoverer->release();
+
+    // The merged reloads are notified along with the one which ran
+    auto completed = reloadCb->waitCompleted( 4 );
+    std::vector<std::string> expected{
+        "file:///a/",
+        "file:///b/",
+        "file:///b/c/",
+        "file:///b/d/",
+    };
+    ASSERT_EQ( expected, reloadCb->started() );
+    ASSERT_EQ( expected, completed );
+    std::vector<std::string> expectedCalls{
+        "reload file:///a/",
+        "reload file:///b/",
+    };
+    ASSERT_EQ( expectedCalls, discoverer->waitCalls( 2 ) );
+}
+
+TEST_F( DiscovererWorkerTests, SerializedCallbacks )
+{
+    concurrencyCb.reset( new ConcurrencyCallback );
+    worker.reset();
+    Reload( nullptr, concurrencyCb.get() );
+    worker.reset( new DiscovererWorker( ml.get() ) );
+    worker->addDiscoverer( std::unique_ptr<IDiscoverer>( new MockDiscoverer( "file://", false ) ) );
+    worker->addDiscoverer( std::unique_ptr<IDiscoverer>( new MockDiscoverer( "smb://", false ) ) );
+
+    const auto NbReloads = 5u;
+    for ( auto i = 0u; i < NbReloads; ++i )
+    {
+        worker->reload( "file:///folder" + std::to_string( i ) + "/" );
+        worker->reload( "smb://server/folder" + std::to_string( i ) + "/" );
+    }
+    // Both lanes notify their reloads, but never at the same time
+    ASSERT_EQ( 1u, concurrencyCb->waitCompleted( NbReloads * 2 ) );
+}
@@ -29,13 +29,27 @@
 #include "Media.h"
 #include "File.h"
 #include "Folder.h"
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
+#include "discoverer/DiscoveryTask.h"
+#include "discoverer/FsDiscoverer.h"
+#include "discoverer/probe/CrawlerProbe.h"
+#include "factory/FileSystemFactory.h"
 #include "medialibrary/IMediaLibrary.h"
 #include "utils/Filename.h"
+#include "utils/ModificationsNotifier.h"
 #include "mocks/FileSystem.h"
 #include "mocks/DiscovererCbMock.h"
 
+#include <cstdio>
+#include <cstdlib>
 #include <memory>
 
+#ifdef __linux__
+# include <sys/stat.h>
+#endif
+
 
 class FoldersNoDiscover : public Tests
 {
@@ -244,6 +258,7 @@ TEST_F( Folders, UpdateFile )
 
     ml.reset();
     fsMock->file( filePath )->markAsModified();
+    fsMock->directory( mock::FileSystemFactory::SubFolder )->markAsModified();
 
     Reload();
 
@@ -254,6 +269,25 @@ TEST_F( Folders, UpdateFile )
     ASSERT_NE( id, f->id() );
 }
 
+TEST_F( Folders, UpdateFileInUnchangedFolder )
+{
+    auto filePath = mock::FileSystemFactory::SubFolder + "subfile.mp4";
+    auto f = ml->media( filePath );
+    ASSERT_NE( f, nullptr );
+    auto id = f->id();
+
+    ml.reset();
+    // Rewriting a file doesn't change its folder modification date. Since the
+    // folder isn't listed again, the modification isn't noticed.
+    fsMock->file( filePath )->markAsModified();
+
+    Reload();
+
+    f = ml->media( filePath );
+    ASSERT_NE( nullptr, f );
+    ASSERT_EQ( id, f->id() );
+}
+
 TEST_F( FoldersNoDiscover, Blacklist )
 {
     ml->banFolder( mock::FileSystemFactory::SubFolder );
@@ -462,3 +496,480 @@ TEST_F( Folders, RemoveNonExistantEntryPoint )
     auto res = cbMock->waitEntryPointRemoved();
     ASSERT_TRUE( res );
 }
+
+class FoldersParallelCrawl : public FoldersNoDiscover
+{
+protected:
+    virtual void InstantiateMediaLibrary() override
+    {
+        ml.reset( new MediaLibraryWithDiscoverer );
+        ml->setDiscoveryThreads( 4 );
+    }
+};
+
+TEST_F( FoldersParallelCrawl, Discover )
+{
+    for ( auto i = 0u; i < 10; ++i )
+    {
+        auto folder = mock::FileSystemFactory::Root + "folder" + std::to_string( i ) + "/";
+        fsMock->addFolder( folder );
+        fsMock->addFile( folder + "file.mkv" );
+        for ( auto j = 0u; j < 5; ++j )
+        {
+            auto subFolder = folder + "sub" + std::to_string( j ) + "/";
+            fsMock->addFolder( subFolder );
+            fsMock->addFile( subFolder + "file.mkv" );
+        }
+    }
+    auto hidden = mock::FileSystemFactory::Root + "hidden/";
+    fsMock->addFolder( hidden );
+    fsMock->addFile( hidden + ".nomedia" );
+    fsMock->addFile( hidden + "file.mkv" );
+
+    ml->discover( mock::FileSystemFactory::Root );
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+
+    auto files = ml->files();
+    ASSERT_EQ( 3u + 10u * 6u, files.size() );
+    ASSERT_EQ( nullptr, ml->folder( hidden ) );
+
+    // Files are inserted in the same order as a sequential discovery would:
+    // subfolders first, then the folder's own files
+    auto f = ml->folder( mock::FileSystemFactory::Root + "folder0/sub0/" );
+    ASSERT_NE( nullptr, f );
+    auto sub0Files = f->files();
+    ASSERT_EQ( 1u, sub0Files.size() );
+    f = ml->folder( mock::FileSystemFactory::Root + "folder0/" );
+    ASSERT_NE( nullptr, f );
+    auto folder0Files = f->files();
+    ASSERT_EQ( 1u, folder0Files.size() );
+    ASSERT_LT( sub0Files[0]->id(), folder0Files[0]->id() );
+
+    fsMock->addFile( mock::FileSystemFactory::Root + "folder9/sub4/newfile.mkv" );
+    fsMock->removeFolder( mock::FileSystemFactory::Root + "folder3/" );
+    ml->reload();
+    auto res = cbMock->waitReload();
+    ASSERT_TRUE( res );
+
+    files = ml->files();
+    ASSERT_EQ( 3u + 9u * 6u + 1u, files.size() );
+    ASSERT_EQ( nullptr, ml->folder( mock::FileSystemFactory::Root + "folder3/" ) );
+}
+
+TEST_F( Folders, Refresh )
+{
+    fsMock->addFile( mock::FileSystemFactory::Root + "newmedia.mkv" );
+    fsMock->addFile( mock::FileSystemFactory::SubFolder + "newmedia.mkv" );
+    auto newFolder = mock::FileSystemFactory::Root + "newfolder/";
+    fsMock->addFolder( newFolder );
+    fsMock->addFile( newFolder + "newmedia.mkv" );
+
+    auto probe = std::unique_ptr<prober::CrawlerProbe>( new prober::CrawlerProbe{} );
+    FsDiscoverer discoverer( fsMock, ml.get(), nullptr, std::move( probe ) );
+    auto res = discoverer.refresh( mock::FileSystemFactory::Root );
+    ASSERT_TRUE( res );
+
+    // The known subfolder isn't checked, but the new one is fully discovered
+    auto files = ml->files();
+    ASSERT_EQ( 5u, files.size() );
+    auto f = ml->folder( newFolder );
+    ASSERT_NE( nullptr, f );
+    ASSERT_EQ( 1u, f->files().size() );
+    f = ml->folder( mock::FileSystemFactory::SubFolder );
+    ASSERT_EQ( 1u, f->files().size() );
+
+    res = discoverer.refresh( mock::FileSystemFactory::SubFolder );
+    ASSERT_TRUE( res );
+    ASSERT_EQ( 2u, f->files().size() );
+
+    res = discoverer.refresh( mock::FileSystemFactory::Root + "unknown/" );
+    ASSERT_FALSE( res );
+}
+
+class FoldersWatched : public Folders
+{
+protected:
+    virtual void InstantiateMediaLibrary() override
+    {
+        ml.reset( new MediaLibraryWithDiscoverer );
+        ml->setFsWatcherEnabled( true );
+    }
+};
+
+TEST_F( FoldersWatched, Reload )
+{
+    // The mock filesystem can't be monitored, this ensures the watcher
+    // doesn't interfere with the regular discovery
+    fsMock->addFile( mock::FileSystemFactory::Root + "newmedia.mkv" );
+    ml->reload();
+    auto res = cbMock->waitReload();
+    ASSERT_TRUE( res );
+
+    auto files = ml->files();
+    ASSERT_EQ( 4u, files.size() );
+}
+
+#ifdef __linux__
+
+namespace
+{
+
+class RootDeviceLister : public IDeviceLister
+{
+public:
+    virtual std::vector<std::tuple<std::string, std::string, bool>> devices() const override
+    {
+        return { std::make_tuple( "{dummy-device}", "file:///", false ) };
+    }
+};
+
+// Notifies the media added by the discoverer, as the parser would
+class MediaLibraryWithWatcher : public MediaLibraryWithDiscoverer
+{
+    virtual void startDeletionNotifier() override
+    {
+        MediaLibrary::startDeletionNotifier();
+    }
+
+    virtual void addDiscoveredFile( std::shared_ptr<fs::IFile> fileFs,
+                                    std::shared_ptr<Folder> parentFolder,
+                                    std::shared_ptr<fs::IDirectory> parentFolderFs,
+                                    std::pair<std::shared_ptr<Playlist>, unsigned int> ) override
+    {
+        auto media = addFile( std::move( fileFs ), std::move( parentFolder ),
+                              std::move( parentFolderFs ) );
+        if ( media != nullptr )
+            getNotifier()->notifyMediaCreation( media );
+    }
+};
+
+class WaitForMediaAdded : public mock::WaitForDiscoveryComplete
+{
+public:
+    virtual void onMediaAdded( std::vector<MediaPtr> media ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mediaMutex );
+        for ( const auto& m : media )
+            m_titles.push_back( m->title() );
+        m_mediaCond.notify_all();
+    }
+
+    bool waitMedia( const std::string& title )
+    {
+        std::unique_lock<compat::Mutex> lock( m_mediaMutex );
+        return m_mediaCond.wait_for( lock, std::chrono::seconds( 10 ), [this, &title]() {
+            return std::find( begin( m_titles ), end( m_titles ), title ) != end( m_titles );
+        });
+    }
+
+private:
+    compat::Mutex m_mediaMutex;
+    compat::ConditionVariable m_mediaCond;
+    std::vector<std::string> m_titles;
+};
+
+}
+
+class FoldersInotify : public Tests
+{
+protected:
+    std::unique_ptr<WaitForMediaAdded> cbMock;
+    std::string root;
+    // The created files & folders, to remove in reverse order
+    std::vector<std::string> paths;
+
+    virtual void SetUp() override
+    {
+        char tmpl[] = "/tmp/ml_watcher_XXXXXX";
+        ASSERT_NE( nullptr, mkdtemp( tmpl ) );
+        root = std::string{ tmpl } + '/';
+        paths.push_back( root );
+        unlink( "test.db" );
+        cbMock.reset( new WaitForMediaAdded );
+        Reload( std::make_shared<factory::FileSystemFactory>(
+                    std::make_shared<RootDeviceLister>() ), cbMock.get() );
+    }
+
+    virtual void TearDown() override
+    {
+        Tests::TearDown();
+        for ( auto it = paths.rbegin(); it != paths.rend(); ++it )
+            remove( it->c_str() );
+    }
+
+    virtual void InstantiateMediaLibrary() override
+    {
+        ml.reset( new MediaLibraryWithWatcher );
+        ml->setFsWatcherEnabled( true );
+    }
+
+    void createFile( const std::string& path )
+    {
+        auto f = fopen( path.c_str(), "w" );
+        ASSERT_NE( nullptr, f );
+        fputs( "media", f );
+        fclose( f );
+        paths.push_back( path );
+    }
+
+    // Leaves time to the discoverer to update the watches once idle
+    void waitWatches()
+    {
+        compat::this_thread::sleep_for( std::chrono::milliseconds( 300 ) );
+    }
+};
+
+TEST_F( FoldersInotify, RefreshOnChange )
+{
+    ml->discover( utils::file::toMrl( root ) );
+    ASSERT_TRUE( cbMock->waitDiscovery() );
+    waitWatches();
+
+    createFile( root + "first.mkv" );
+    ASSERT_TRUE( cbMock->waitMedia( "first" ) );
+
+    // The folder created meanwhile is discovered by the refresh, and watched
+    // as well
+    ASSERT_EQ( 0, mkdir( ( root + "sub" ).c_str(), 0700 ) );
+    paths.push_back( root + "sub" );
+    createFile( root + "sub/second.mkv" );
+    ASSERT_TRUE( cbMock->waitMedia( "second" ) );
+    waitWatches();
+
+    createFile( root + "sub/third.mkv" );
+    ASSERT_TRUE( cbMock->waitMedia( "third" ) );
+}
+
+#endif
+
+TEST_F( Folders, ModificationInfo )
+{
+    auto f = std::static_pointer_cast<Folder>( ml->folder( mock::FileSystemFactory::Root ) );
+    ASSERT_NE( 0u, f->lastModificationDate() );
+    ASSERT_EQ( 1u, f->nbSubfolders() );
+
+    auto dir = fsMock->directory( mock::FileSystemFactory::Root );
+    ASSERT_EQ( dir->lastModificationDate(), f->lastModificationDate() );
+
+    fsMock->addFile( mock::FileSystemFactory::SubFolder + "newfile.mkv" );
+    ml->reload();
+    auto res = cbMock->waitReload();
+    ASSERT_TRUE( res );
+
+    // The root folder is unchanged, but the new file must still be found
+    ASSERT_EQ( 4u, ml->files().size() );
+    Reload();
+    f = std::static_pointer_cast<Folder>( ml->folder( mock::FileSystemFactory::Root ) );
+    ASSERT_EQ( dir->lastModificationDate(), f->lastModificationDate() );
+}
+
+TEST_F( FoldersNoDiscover, UnhideUnchangedParent )
+{
+    auto newFolder = mock::FileSystemFactory::Root + "newfolder/";
+    fsMock->addFolder( newFolder );
+    fsMock->addFile( newFolder + "newfile.avi" );
+    fsMock->addFile( newFolder + ".nomedia" );
+
+    ml->discover( mock::FileSystemFactory::Root );
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+    ASSERT_EQ( 3u, ml->files().size() );
+
+    // Only the hidden folder itself is modified, but the root folder must
+    // still be listed to find it again
+    fsMock->removeFile( newFolder + ".nomedia" );
+    ml->reload();
+    auto res = cbMock->waitReload();
+    ASSERT_TRUE( res );
+
+    ASSERT_EQ( 4u, ml->files().size() );
+}
+
+TEST_F( FoldersNoDiscover, MoveFile )
+{
+    auto from = mock::FileSystemFactory::Root + "video.avi";
+    auto to = mock::FileSystemFactory::SubFolder + "video.avi";
+    fsMock->file( from )->setSize( 1234 );
+    fsMock->file( from )->setInode( 42 );
+    ml->discover( mock::FileSystemFactory::Root );
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+    auto m = ml->media( from );
+    ASSERT_NE( nullptr, m );
+    auto id = m->id();
+
+    ml.reset();
+    fsMock->removeFile( from );
+    fsMock->addFile( to );
+    fsMock->file( to )->setSize( 1234 );
+    fsMock->file( to )->setInode( 42 );
+    Reload();
+
+    ASSERT_EQ( nullptr, ml->media( from ) );
+    m = ml->media( to );
+    ASSERT_NE( nullptr, m );
+    ASSERT_EQ( id, m->id() );
+    ASSERT_EQ( 3u, ml->files().size() );
+    auto f = ml->folder( mock::FileSystemFactory::SubFolder );
+    ASSERT_EQ( 2u, f->files().size() );
+
+    // And back to its original folder, which is checked after the folder it
+    // disappeared from
+    ml.reset();
+    fsMock->removeFile( to );
+    fsMock->addFile( from );
+    fsMock->file( from )->setSize( 1234 );
+    fsMock->file( from )->setInode( 42 );
+    Reload();
+
+    ASSERT_EQ( nullptr, ml->media( to ) );
+    m = ml->media( from );
+    ASSERT_NE( nullptr, m );
+    ASSERT_EQ( id, m->id() );
+    ASSERT_EQ( 3u, ml->files().size() );
+}
+
+TEST_F( FoldersNoDiscover, RenameFile )
+{
+    auto from = mock::FileSystemFactory::Root + "video.avi";
+    auto to = mock::FileSystemFactory::Root + "movie.avi";
+    fsMock->file( from )->setSize( 1234 );
+    fsMock->file( from )->setInode( 42 );
+    ml->discover( mock::FileSystemFactory::Root );
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+    auto m = ml->media( from );
+    ASSERT_NE( nullptr, m );
+    auto id = m->id();
+
+    ml.reset();
+    fsMock->removeFile( from );
+    fsMock->addFile( to );
+    fsMock->file( to )->setSize( 1234 );
+    fsMock->file( to )->setInode( 42 );
+    Reload();
+
+    m = ml->media( to );
+    ASSERT_NE( nullptr, m );
+    ASSERT_EQ( id, m->id() );
+    // The title was the default one, so it follows the file name
+    ASSERT_EQ( "movie.avi", m->title() );
+}
+
+TEST_F( FoldersNoDiscover, MoveFolder )
+{
+    auto from = mock::FileSystemFactory::SubFolder + "subfile.mp4";
+    auto newFolder = mock::FileSystemFactory::Root + "newfolder/";
+    auto to = newFolder + "subfile.mp4";
+    fsMock->file( from )->setSize( 1234 );
+    fsMock->file( from )->setInode( 42 );
+    ml->discover( mock::FileSystemFactory::Root );
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+    auto m = ml->media( from );
+    ASSERT_NE( nullptr, m );
+    auto id = m->id();
+
+    ml.reset();
+    fsMock->removeFolder( mock::FileSystemFactory::SubFolder );
+    fsMock->addFolder( newFolder );
+    fsMock->addFile( to );
+    fsMock->file( to )->setSize( 1234 );
+    fsMock->file( to )->setInode( 42 );
+    Reload();
+
+    ASSERT_EQ( nullptr, ml->folder( mock::FileSystemFactory::SubFolder ) );
+    m = ml->media( to );
+    ASSERT_NE( nullptr, m );
+    ASSERT_EQ( id, m->id() );
+    ASSERT_EQ( 3u, ml->files().size() );
+}
+
+TEST_F( FoldersNoDiscover, CopyFile )
+{
+    auto from = mock::FileSystemFactory::Root + "video.avi";
+    auto to = mock::FileSystemFactory::SubFolder + "video.avi";
+    fsMock->file( from )->setSize( 1234 );
+    fsMock->file( from )->setInode( 42 );
+    ml->discover( mock::FileSystemFactory::Root );
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+    auto m = ml->media( from );
+    ASSERT_NE( nullptr, m );
+    auto id = m->id();
+
+    // A copy looks like a moved file, but its source still exists
+    ml.reset();
+    fsMock->addFile( to );
+    fsMock->file( to )->setSize( 1234 );
+    fsMock->file( to )->setInode( 43 );
+    Reload();
+
+    m = ml->media( from );
+    ASSERT_NE( nullptr, m );
+    ASSERT_EQ( id, m->id() );
+    ASSERT_NE( nullptr, ml->media( to ) );
+    ASSERT_EQ( 4u, ml->files().size() );
+}
+
+TEST_F( FoldersNoDiscover, MoveCollision )
+{
+    auto from = mock::FileSystemFactory::Root + "video.avi";
+    auto other = mock::FileSystemFactory::SubFolder + "other.avi";
+    fsMock->file( from )->setSize( 1234 );
+    fsMock->file( from )->setInode( 42 );
+    ml->discover( mock::FileSystemFactory::Root );
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+    auto m = ml->media( from );
+    ASSERT_NE( nullptr, m );
+    auto id = m->id();
+
+    // A different file with the same size & modification date replaces the
+    // deleted one
+    ml.reset();
+    fsMock->removeFile( from );
+    fsMock->addFile( other );
+    fsMock->file( other )->setSize( 1234 );
+    fsMock->file( other )->setInode( 43 );
+    Reload();
+
+    ASSERT_EQ( nullptr, ml->media( from ) );
+    m = ml->media( other );
+    ASSERT_NE( nullptr, m );
+    ASSERT_NE( id, m->id() );
+    ASSERT_EQ( 3u, ml->files().size() );
+}
+
+TEST_F( FoldersNoDiscover, ResumeDiscovery )
+{
+    // Simulate a discovery which was still queued when the media library
+    // was stopped
+    DiscoveryTask::add( ml.get(), mock::FileSystemFactory::Root );
+    Reload();
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+    ASSERT_EQ( 3u, ml->files().size() );
+
+    auto tasks = DiscoveryTask::fetchAll<DiscoveryTask>( ml.get() );
+    ASSERT_EQ( 0u, tasks.size() );
+}
+
+TEST_F( Folders, ResumeInterruptedDiscovery )
+{
+    // Simulate a discovery which was interrupted after the subfolder was
+    // added, but before its content was checked
+    auto root = ml->folder( mock::FileSystemFactory::Root );
+    auto subFolder = ml->folder( mock::FileSystemFactory::SubFolder );
+    for ( const auto& f : subFolder->files() )
+        f->media()->destroy();
+    root->setModificationInfo( 0, 0 );
+    subFolder->setModificationInfo( 0, 0 );
+    ASSERT_EQ( 2u, ml->files().size() );
+
+    ml->discover( mock::FileSystemFactory::Root );
+    bool discovered = cbMock->waitDiscovery();
+    ASSERT_TRUE( discovered );
+    ASSERT_EQ( 3u, ml->files().size() );
+}
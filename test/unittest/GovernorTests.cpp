@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include "compat/Thread.h"
+#include "utils/Governor.h"
+
+using namespace medialibrary;
+
+namespace
+{
+
+int64_t acquireDuration( utils::Governor& governor, const std::atomic_bool* interrupted = nullptr )
+{
+    auto start = std::chrono::steady_clock::now();
+    governor.acquire( interrupted );
+    auto duration = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::milliseconds>( duration ).count();
+}
+
+}
+
+TEST( Governor, Unlimited )
+{
+    utils::Governor governor;
+    governor.charge( 1000000 );
+    ASSERT_LT( acquireDuration( governor ), 50 );
+}
+
+TEST( Governor, Budget )
+{
+    utils::Governor governor;
+    governor.setBudget( 1000, 0 );
+    // The first 1000 operations put the bucket in debt for 200ms
+    governor.charge( 1200 );
+    auto duration = acquireDuration( governor );
+    ASSERT_GE( duration, 150 );
+    ASSERT_LT( duration, 1000 );
+    // The debt is now paid off
+    ASSERT_LT( acquireDuration( governor ), 50 );
+}
+
+TEST( Governor, Playback )
+{
+    utils::Governor governor;
+    governor.setPlaybackActive( true );
+    ASSERT_TRUE( governor.isPlaybackActive() );
+    // This would block for more than 10 seconds, unless the playback stops
+    governor.charge( utils::Governor::PlaybackOperationsPerSec * 10 );
+    struct Stopper
+    {
+        void run()
+        {
+            compat::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+            governor->setPlaybackActive( false );
+        }
+        utils::Governor* governor;
+    } stopper{ &governor };
+    compat::Thread t( &Stopper::run, &stopper );
+    auto duration = acquireDuration( governor );
+    t.join();
+    ASSERT_GE( duration, 150 );
+    ASSERT_LT( duration, 5000 );
+    ASSERT_FALSE( governor.isPlaybackActive() );
+}
+
+TEST( Governor, Interrupted )
+{
+    utils::Governor governor;
+    governor.setBudget( 1, 0 );
+    governor.charge( 100 );
+    std::atomic_bool interrupted( true );
+    ASSERT_FALSE( governor.acquire( &interrupted ) );
+    governor.stop();
+    ASSERT_TRUE( governor.acquire() );
+}
@@ -151,3 +151,65 @@ TEST_F( Labels, Delete )
     ASSERT_FALSE( res );
 }
 
+
+TEST_F( Labels, OverlappingNames )
+{
+    auto m = ml->addMedia( "media.avi" );
+    auto l1 = ml->createLabel( "otter" );
+    auto l2 = ml->createLabel( "sea otter" );
+
+    m->addLabel( l2 );
+    m->addLabel( l1 );
+
+    // Removing "otter" must not damage "sea otter"
+    m->removeLabel( l1 );
+    auto media = ml->searchMedia( "sea otter" );
+    ASSERT_EQ( 1u, media.others.size() );
+
+    ml->deleteLabel( l2 );
+    media = ml->searchMedia( "otter" );
+    ASSERT_EQ( 0u, media.others.size() );
+}
+
+TEST_F( Labels, BulkAdd )
+{
+    std::vector<MediaPtr> media;
+    for ( auto i = 0u; i < 10; ++i )
+        media.push_back( ml->addMedia( "media" + std::to_string( i ) + ".avi" ) );
+    auto l = ml->createLabel( "holidays" );
+
+    ASSERT_TRUE( l->addMedia( media ) );
+    ASSERT_EQ( 10u, l->files().size() );
+    auto res = ml->searchMedia( "holidays" );
+    ASSERT_EQ( 10u, res.others.size() );
+
+    // Adding again is a no-op
+    ASSERT_TRUE( l->addMedia( media ) );
+    ASSERT_EQ( 10u, l->files().size() );
+
+    media.resize( 4 );
+    ASSERT_TRUE( l->removeMedia( media ) );
+    ASSERT_EQ( 6u, l->files().size() );
+    res = ml->searchMedia( "holidays" );
+    ASSERT_EQ( 6u, res.others.size() );
+}
+
+TEST_F( Labels, BulkInvalidMedia )
+{
+    auto m = ml->addMedia( "media.avi" );
+    auto l = ml->createLabel( "holidays" );
+
+    std::vector<MediaPtr> media{ m, nullptr };
+    ASSERT_FALSE( l->addMedia( media ) );
+    ASSERT_EQ( 0u, l->files().size() );
+
+    media = { m, std::make_shared<Media>( ml.get(), "unsaved.avi", IMedia::Type::Video ) };
+    ASSERT_FALSE( l->addMedia( media ) );
+    ASSERT_EQ( 0u, l->files().size() );
+
+    ASSERT_TRUE( l->addMedia( { m } ) );
+    ASSERT_FALSE( l->removeMedia( media ) );
+    media = { m, nullptr };
+    ASSERT_FALSE( l->removeMedia( media ) );
+    ASSERT_EQ( 1u, l->files().size() );
+}
@@ -173,6 +173,63 @@ TEST_F( Medias, Search )
     ASSERT_EQ( 0u, media.size() );
 }
 
+TEST_F( Medias, SearchPaged )
+{
+    for ( auto i = 1u; i <= 10u; ++i )
+    {
+        ml->addMedia( "track " + std::to_string( i ) + ".mp3" );
+    }
+    auto media = ml->searchMedia( "tra", 0, 4 ).others;
+    ASSERT_EQ( 4u, media.size() );
+
+    media = ml->searchMedia( "tra", 8, 4 ).others;
+    ASSERT_EQ( 2u, media.size() );
+
+    auto count = ml->searchCount( "tra" );
+    ASSERT_EQ( 10u, count.media.others );
+    ASSERT_EQ( 0u, count.media.tracks );
+
+    count = ml->searchCount( "grouik" );
+    ASSERT_EQ( 0u, count.media.others );
+}
+
+TEST_F( Medias, SearchP2P )
+{
+    auto parent = std::static_pointer_cast<Media>( ml->addMedia( "sea otters.torrent" ) );
+    parent->setType( IMedia::Type::TransportFile );
+    parent->save();
+
+    auto child = ml->addP2PMedia( parent->id(), static_cast<uint8_t>( IMedia::Type::Video ),
+                                  "pangolin", "acestream:?infohash=0123abcd&index=0" );
+    ASSERT_NE( nullptr, child );
+    auto m = std::static_pointer_cast<Media>( child );
+    m->setP2PInfo( "0123ABCD", 0 );
+    m->setP2PLive( 0 );
+    m->save();
+
+    // Infohash prefix, case insensitive
+    auto media = ml->searchP2PMedia( "0123a", -1, 0, 0, 0 );
+    ASSERT_EQ( 1u, media.size() );
+    ASSERT_EQ( child->id(), media[0]->id() );
+    media = ml->searchP2PMedia( "123a", -1, 0, 0, 0 );
+    ASSERT_EQ( 0u, media.size() );
+
+    // Own title, or transport file name
+    media = ml->searchP2PMedia( "pangolin", -1, 0, 0, 0 );
+    ASSERT_EQ( 1u, media.size() );
+    media = ml->searchP2PMedia( "otters", -1, 0, 0, 0 );
+    ASSERT_EQ( 1u, media.size() );
+    ASSERT_EQ( child->id(), media[0]->id() );
+
+    // Scoping
+    media = ml->searchP2PMedia( "otters", 1, 0, 0, 0 );
+    ASSERT_EQ( 0u, media.size() );
+    media = ml->searchP2PMedia( "otters", 0, parent->id(), 0, 0 );
+    ASSERT_EQ( 1u, media.size() );
+    media = ml->searchP2PMedia( "otters", -1, parent->id() + 100, 0, 0 );
+    ASSERT_EQ( 0u, media.size() );
+}
+
 TEST_F( Medias, SearchAfterEdit )
 {
     auto m = std::static_pointer_cast<Media>( ml->addMedia( "media.mp3" ) );
@@ -257,6 +314,7 @@ TEST_F( Medias, SearchTracks )
     {
        auto m = std::static_pointer_cast<Media>( ml->addMedia( "track " + std::to_string( i ) + ".mp3" ) );
        a->addTrack( m, i, 1, 0, 0 );
+       m->save();
     }
     auto tracks = ml->searchMedia( "tra" ).tracks;
     ASSERT_EQ( 10u, tracks.size() );
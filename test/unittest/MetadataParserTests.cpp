@@ -0,0 +1,187 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Tests.h"
+
+#include "Album.h"
+#include "AlbumTrack.h"
+#include "Artist.h"
+#include "File.h"
+#include "Genre.h"
+#include "Media.h"
+#include "metadata_services/MetadataParser.h"
+#include "mocks/filesystem/MockFile.h"
+#include "parser/ParseCache.h"
+#include "parser/Task.h"
+
+namespace
+{
+
+// Exposes the entities matching, which doesn't need libvlc
+class MetadataParserTester : public MetadataParser
+{
+public:
+    using MetadataParser::findAlbum;
+    using MetadataParser::findOrCreateArtist;
+    using MetadataParser::handleGenre;
+    using MetadataParser::restart;
+    using ParserService::initialize;
+
+    // Provides the media library without building the indexes
+    void setMediaLibrary( MediaLibrary* ml )
+    {
+        m_ml = ml;
+        m_cb = ml->getCb();
+        m_notifier = ml->getNotifier();
+    }
+};
+
+}
+
+class MetadataParserTests : public Tests
+{
+protected:
+    std::unique_ptr<MetadataParserTester> parser;
+
+    // The parser notifies the entities it creates
+    virtual void InstantiateMediaLibrary() override
+    {
+        ml.reset( new MediaLibraryWithNotifier );
+    }
+
+    virtual void SetUp() override
+    {
+        Tests::SetUp();
+        parser.reset( new MetadataParserTester );
+    }
+
+    std::shared_ptr<parser::Task> task( const std::string& album, const std::string& albumArtist,
+                                        const std::string& genre )
+    {
+        auto fileFs = std::make_shared<mock::File>( "file:///music/track.mp3" );
+        auto t = std::make_shared<parser::Task>( ml.get(), fileFs, nullptr, nullptr, nullptr, 0 );
+        t->media = ml->addFile( fileFs );
+        t->file = std::static_pointer_cast<File>( t->media->files()[0] );
+        t->metadata.reset( new parser::ExtractedMetadata );
+        t->metadata->metas[libvlc_meta_Album] = album;
+        t->metadata->metas[libvlc_meta_AlbumArtist] = albumArtist;
+        t->metadata->metas[libvlc_meta_Genre] = genre;
+        return t;
+    }
+
+    std::shared_ptr<Album> createAlbum( const std::string& title, std::shared_ptr<Artist> artist )
+    {
+        auto album = ml->createAlbum( title );
+        album->setAlbumArtist( artist );
+        return album;
+    }
+};
+
+TEST_F( MetadataParserTests, CaseInsensitiveMatch )
+{
+    auto artist = ml->createArtist( "Russian Otters" );
+    auto album = createAlbum( "Sea Otters Anthems", artist );
+    auto genre = ml->createGenre( "Otter Rock" );
+    parser->initialize( ml.get() );
+
+    auto t = task( "SEA OTTERS ANTHEMS", "russian otters", "otter ROCK" );
+    auto artists = parser->findOrCreateArtist( *t );
+    ASSERT_NE( nullptr, artists.first );
+    ASSERT_EQ( artist->id(), artists.first->id() );
+    ASSERT_EQ( nullptr, artists.second );
+
+    auto a = parser->findAlbum( *t, artists.first, nullptr );
+    ASSERT_NE( nullptr, a );
+    ASSERT_EQ( album->id(), a->id() );
+
+    auto g = parser->handleGenre( *t );
+    ASSERT_NE( nullptr, g );
+    ASSERT_EQ( genre->id(), g->id() );
+}
+
+TEST_F( MetadataParserTests, StaleIds )
+{
+    auto artist = ml->createArtist( "Russian Otters" );
+    auto album = createAlbum( "Sea Otters Anthems", artist );
+    auto media = std::static_pointer_cast<Media>( ml->addMedia( "track.mp3" ) );
+    auto track = album->addTrack( media, 1, 1, artist->id(), nullptr );
+    ASSERT_NE( nullptr, track );
+    artist->updateNbTrack( 1 );
+    parser->initialize( ml.get() );
+
+    // Removing the last track deletes the album, and then its artist
+    ml->deleteTrack( track->id() );
+    ASSERT_EQ( nullptr, ml->album( album->id() ) );
+    ASSERT_EQ( nullptr, ml->artist( artist->id() ) );
+
+    auto t = task( "Sea Otters Anthems", "Russian Otters", "" );
+    ASSERT_EQ( nullptr, parser->findAlbum( *t, nullptr, nullptr ) );
+    auto artists = parser->findOrCreateArtist( *t );
+    ASSERT_NE( nullptr, artists.first );
+    ASSERT_EQ( "Russian Otters", artists.first->name() );
+    ASSERT_NE( artist->id(), artists.first->id() );
+    // The newly created artist is indexed
+    ASSERT_EQ( artists.first->id(), parser->findOrCreateArtist( *t ).first->id() );
+}
+
+TEST_F( MetadataParserTests, RebuildAfterRescan )
+{
+    auto artist = ml->createArtist( "Russian Otters" );
+    createAlbum( "Sea Otters Anthems", artist );
+    parser->initialize( ml.get() );
+
+    ml->forceRescan();
+    // forceRescan() restarts the parser services once the entities are
+    // deleted, so the index only contains the albums existing from then on
+    artist = ml->createArtist( "Russian Otters" );
+    auto album = createAlbum( "Sea Otters Anthems", artist );
+    parser->restart();
+
+    auto t = task( "sea otters anthems", "", "" );
+    auto a = parser->findAlbum( *t, nullptr, nullptr );
+    ASSERT_NE( nullptr, a );
+    ASSERT_EQ( album->id(), a->id() );
+}
+
+TEST_F( MetadataParserTests, DatabaseFallback )
+{
+    // Without any index, the entities are matched through the database
+    parser->setMediaLibrary( ml.get() );
+    auto artist = ml->createArtist( "Russian Otters" );
+    auto album = createAlbum( "Sea Otters Anthems", artist );
+    auto genre = ml->createGenre( "Otter Rock" );
+
+    auto t = task( "Sea Otters Anthems", "Russian Otters", "Otter Rock" );
+    auto artists = parser->findOrCreateArtist( *t );
+    ASSERT_NE( nullptr, artists.first );
+    ASSERT_EQ( artist->id(), artists.first->id() );
+    auto a = parser->findAlbum( *t, artists.first, nullptr );
+    ASSERT_NE( nullptr, a );
+    ASSERT_EQ( album->id(), a->id() );
+    auto g = parser->handleGenre( *t );
+    ASSERT_NE( nullptr, g );
+    ASSERT_EQ( genre->id(), g->id() );
+}
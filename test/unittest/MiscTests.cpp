@@ -173,5 +173,5 @@ TEST_F( DbModel, Upgrade12to13 )
     auto albums = ml->albums( SortingCriteria::Default, false );
     ASSERT_EQ( 1u, albums.size() );
 
-    CheckNbTriggers( 31 );
+    CheckNbTriggers( 32 );
 }
@@ -0,0 +1,464 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Tests.h"
+
+#include <functional>
+#include <future>
+
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
+#include "database/SqliteTools.h"
+#include "mocks/FileSystem.h"
+#include "mocks/filesystem/MockFile.h"
+#include "parser/Parser.h"
+#include "parser/ParserService.h"
+
+namespace
+{
+
+// Completes its parser step after a while, and keeps track of the number of
+// tasks it ran concurrently
+class MockService : public ParserService
+{
+public:
+    MockService( parser::Task::ParserStep step, uint8_t nbThreads, unsigned int durationMs )
+        : m_step( step )
+        , m_nbThreads( nbThreads )
+        , m_duration( durationMs )
+        , m_nbRunning( 0 )
+        , m_maxRunning( 0 )
+        , m_nbRun( 0 )
+    {
+    }
+
+    virtual const char* name() const override
+    {
+        return "Mock";
+    }
+
+    virtual uint8_t nbThreads() const override
+    {
+        return m_nbThreads;
+    }
+
+    unsigned int maxRunning()
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        return m_maxRunning;
+    }
+
+    unsigned int nbRun()
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        return m_nbRun;
+    }
+
+    std::vector<std::string> started()
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        return m_started;
+    }
+
+    // Called from the worker thread, before running each task
+    void setHook( std::function<void( parser::Task& )> hook )
+    {
+        m_hook = std::move( hook );
+    }
+
+    void wait( unsigned int nbRun )
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        m_cond.wait( lock, [this, nbRun]() {
+            return m_nbRun >= nbRun;
+        });
+    }
+
+private:
+    virtual parser::Task::Status run( parser::Task& task ) override
+    {
+        if ( m_hook != nullptr )
+            m_hook( task );
+        {
+            std::lock_guard<compat::Mutex> lock( m_mutex );
+            ++m_nbRunning;
+            m_maxRunning = std::max( m_maxRunning, m_nbRunning );
+            m_started.push_back( task.mrl );
+        }
+        compat::this_thread::sleep_for( std::chrono::milliseconds( m_duration ) );
+        auto failed = task.mrl.find( "fail" ) != std::string::npos;
+        if ( failed == false )
+            task.markStepCompleted( m_step );
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        --m_nbRunning;
+        ++m_nbRun;
+        m_cond.notify_all();
+        return failed ? parser::Task::Status::Fatal : parser::Task::Status::Success;
+    }
+
+    virtual bool isCompleted( const parser::Task& task ) const override
+    {
+        return task.isStepCompleted( m_step );
+    }
+
+private:
+    parser::Task::ParserStep m_step;
+    uint8_t m_nbThreads;
+    unsigned int m_duration;
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    unsigned int m_nbRunning;
+    unsigned int m_maxRunning;
+    unsigned int m_nbRun;
+    std::vector<std::string> m_started;
+    std::function<void( parser::Task& )> m_hook;
+};
+
+}
+
+class ParserTests : public Tests
+{
+protected:
+    std::unique_ptr<Parser> parser;
+    std::shared_ptr<mock::FileSystemFactory> fsMock;
+    MockService* extraction;
+    MockService* analysis;
+    MockService* thumbnailer;
+
+    virtual void SetUp() override
+    {
+        unlink( "test.db" );
+        // Allows the restored tasks to find their files
+        fsMock.reset( new mock::FileSystemFactory );
+        Reload( fsMock );
+        parser.reset( new Parser( ml.get() ) );
+        extraction = new MockService( parser::Task::ParserStep::MetadataExtraction, 3, 5 );
+        analysis = new MockService( parser::Task::ParserStep::MetadataAnalysis, 1, 1 );
+        thumbnailer = new MockService( parser::Task::ParserStep::Thumbnailer, 1, 2 );
+        parser->addService( std::unique_ptr<ParserService>( extraction ) );
+        parser->addService( std::unique_ptr<ParserService>( analysis ) );
+        parser->addService( std::unique_ptr<ParserService>( thumbnailer ) );
+    }
+
+    virtual void TearDown() override
+    {
+        parser.reset();
+        Tests::TearDown();
+    }
+
+    void parse( const std::string& mrl )
+    {
+        auto file = std::make_shared<mock::File>( mrl );
+        parser->parse( std::make_shared<parser::Task>( ml.get(), file, nullptr, nullptr, nullptr, 0 ) );
+    }
+};
+
+TEST_F( ParserTests, Pipeline )
+{
+    const auto NbTasks = 30u;
+    for ( auto i = 0u; i < NbTasks; ++i )
+        parse( "file:///media" + std::to_string( i ) + ".mkv" );
+    thumbnailer->wait( NbTasks );
+
+    ASSERT_EQ( NbTasks, extraction->nbRun() );
+    ASSERT_EQ( NbTasks, analysis->nbRun() );
+    ASSERT_EQ( NbTasks, thumbnailer->nbRun() );
+    // The services never run more tasks than they allow
+    ASSERT_LE( extraction->maxRunning(), 3u );
+    ASSERT_EQ( 1u, analysis->maxRunning() );
+    ASSERT_EQ( 1u, thumbnailer->maxRunning() );
+}
+
+TEST_F( ParserTests, Failure )
+{
+    parse( "file:///fail.mkv" );
+    parse( "file:///media.mkv" );
+    thumbnailer->wait( 1 );
+    // Give the failed task a chance to reach the next services, should it be
+    // wrongly forwarded
+    extraction->wait( 2 );
+    parse( "file:///media2.mkv" );
+    thumbnailer->wait( 2 );
+
+    ASSERT_EQ( 3u, extraction->nbRun() );
+    ASSERT_EQ( 2u, analysis->nbRun() );
+    ASSERT_EQ( 2u, thumbnailer->nbRun() );
+}
+
+TEST_F( ParserTests, PauseFlush )
+{
+    parser->pause();
+    for ( auto i = 0u; i < 10; ++i )
+        parse( "file:///media" + std::to_string( i ) + ".mkv" );
+    compat::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+    ASSERT_EQ( 0u, extraction->nbRun() );
+
+    parser->flush();
+    parser->resume();
+    parse( "file:///other.mkv" );
+    thumbnailer->wait( 1 );
+    ASSERT_EQ( 1u, extraction->nbRun() );
+}
+
+TEST_F( ParserTests, Priorities )
+{
+    parser->pause();
+    for ( auto i = 0u; i < 10; ++i )
+        parse( "file:///media" + std::to_string( i ) + ".mkv" );
+    for ( auto i = 0u; i < 2; ++i )
+        parse( "file:///folder/media" + std::to_string( i ) + ".mkv" );
+    ASSERT_TRUE( parser->prioritize( "file:///folder/", ParsingPriority::Visible ) );
+    ASSERT_TRUE( parser->prioritize( "file:///media9.mkv", ParsingPriority::Interactive ) );
+    ASSERT_FALSE( parser->prioritize( "file:///unknown.mkv", ParsingPriority::Interactive ) );
+    parser->resume();
+    thumbnailer->wait( 12 );
+
+    // The extraction runs 3 tasks at once, so the prioritized tasks are the
+    // first ones to be started
+    auto started = extraction->started();
+    ASSERT_EQ( 12u, started.size() );
+    std::sort( begin( started ), begin( started ) + 3 );
+    ASSERT_EQ( "file:///folder/media0.mkv", started[0] );
+    ASSERT_EQ( "file:///folder/media1.mkv", started[1] );
+    ASSERT_EQ( "file:///media9.mkv", started[2] );
+    // And they keep their priority for the next services
+    started = thumbnailer->started();
+    ASSERT_NE( begin( started ) + 3, std::find( begin( started ), begin( started ) + 3,
+                                                "file:///media9.mkv" ) );
+}
+
+TEST_F( ParserTests, Backpressure )
+{
+    std::atomic_bool interrupted( true );
+    parser->pause();
+    for ( auto i = 0u; i < Parser::MaxQueuedTasks - 1; ++i )
+        parse( "file:///media" + std::to_string( i ) + ".mkv" );
+    ASSERT_TRUE( parser->waitForCapacity( &interrupted ) );
+
+    parse( "file:///full.mkv" );
+    // The queue is full, so only an interruption can end the wait
+    ASSERT_FALSE( parser->waitForCapacity( &interrupted ) );
+
+    // Once resumed, the producers are unblocked when the queue has drained
+    parser->resume();
+    ASSERT_TRUE( parser->waitForCapacity() );
+    ASSERT_TRUE( parser->waitForCapacity( &interrupted ) );
+
+    parser->pause();
+    for ( auto i = 0u; i < Parser::MaxQueuedTasks; ++i )
+        parse( "file:///other" + std::to_string( i ) + ".mkv" );
+    ASSERT_FALSE( parser->waitForCapacity( &interrupted ) );
+    parser->flush();
+    ASSERT_TRUE( parser->waitForCapacity( &interrupted ) );
+}
+
+TEST_F( ParserTests, BackpressureFromWorker )
+{
+    // Importing a playlist runs a discoverer from the metadata analysis
+    // worker. It must not wait for the queue to drain, since the tasks it
+    // would wait for are queued for the service it's blocking.
+    std::atomic_bool interrupted( true );
+    std::promise<bool> hasCapacity;
+    auto res = hasCapacity.get_future();
+    analysis->setHook( [this, &interrupted, &hasCapacity]( parser::Task& task ) {
+        if ( task.mrl == "file:///playlist.m3u" )
+            hasCapacity.set_value( parser->waitForCapacity( &interrupted ) );
+    });
+    parser->pause();
+    for ( auto i = 0u; i < Parser::MaxQueuedTasks * 2; ++i )
+        parse( "file:///media" + std::to_string( i ) + ".mkv" );
+    parse( "file:///playlist.m3u" );
+    ASSERT_FALSE( parser->waitForCapacity( &interrupted ) );
+
+    parser->resume();
+    ASSERT_TRUE( res.get() );
+    parser->pause();
+    parser->flush();
+}
+
+TEST_F( ParserTests, FetchUncompletedPages )
+{
+    const std::string req = "INSERT INTO " + policy::TaskTable::Name +
+            "(mrl, step) VALUES(?, ?)";
+    for ( auto i = 0u; i < 250; ++i )
+    {
+        // Every 10th task is completed already
+        auto step = i % 10 == 0 ? parser::Task::ParserStep::Completed :
+                                  parser::Task::ParserStep::None;
+        sqlite::Tools::executeInsert( ml->getDbConn(), req,
+                                      "file:///media" + std::to_string( i ) + ".mkv", step );
+    }
+    auto nbTasks = 0u;
+    auto cursor = int64_t{ 0 };
+    auto lastId = parser::Task::lastId( ml.get() );
+    ASSERT_EQ( 250, lastId );
+    while ( true )
+    {
+        auto tasks = parser::Task::fetchUncompleted( ml.get(), cursor, lastId, 100 );
+        ASSERT_LE( tasks.size(), 100u );
+        for ( const auto& t : tasks )
+        {
+            ASSERT_LT( cursor, t->id() );
+            ASSERT_FALSE( t->isRestored() );
+            cursor = t->id();
+        }
+        nbTasks += tasks.size();
+        if ( tasks.size() < 100 )
+            break;
+    }
+    ASSERT_EQ( 225u, nbTasks );
+}
+
+TEST_F( ParserTests, RetryCount )
+{
+    const std::string req = "INSERT INTO " + policy::TaskTable::Name + "(mrl) VALUES(?)";
+    sqlite::Tools::executeInsert( ml->getDbConn(), req, "file:///media.mkv" );
+    auto retryCount = [this]() {
+        medialibrary::sqlite::Statement stmt{ ml->getDbConn()->handle(),
+                "SELECT retry_count FROM " + policy::TaskTable::Name };
+        stmt.execute();
+        auto row = stmt.row();
+        int count;
+        row >> count;
+        return count;
+    };
+    auto tasks = parser::Task::fetchUncompleted( ml.get(), 0, 1, 10 );
+    ASSERT_EQ( 1u, tasks.size() );
+    auto task = tasks[0];
+    task->startParserStep();
+    ASSERT_EQ( 1, retryCount() );
+    // Only the first step of a session is accounted for
+    task->startParserStep();
+    ASSERT_EQ( 1, retryCount() );
+    task->markStepCompleted( parser::Task::ParserStep::MetadataAnalysis );
+    ASSERT_TRUE( task->saveParserStep() );
+    ASSERT_EQ( 0, retryCount() );
+    task->startParserStep();
+    ASSERT_EQ( 0, retryCount() );
+
+    // A restarted task is accounted for again
+    tasks = parser::Task::fetchUncompleted( ml.get(), 0, 1, 10 );
+    ASSERT_EQ( 1u, tasks.size() );
+    tasks[0]->startParserStep();
+    ASSERT_EQ( 1, retryCount() );
+}
+
+TEST_F( ParserTests, ParseCache )
+{
+    const std::string req = "INSERT INTO " + policy::TaskTable::Name + "(mrl) VALUES(?)";
+    sqlite::Tools::executeInsert( ml->getDbConn(), req, "file:///media.mkv" );
+    auto tasks = parser::Task::fetchUncompleted( ml.get(), 0, 1, 10 );
+    ASSERT_EQ( 1u, tasks.size() );
+    auto task = tasks[0];
+    auto file = std::make_shared<mock::File>( "file:///media.mkv" );
+    file->setSize( 1234 );
+    task->fileFs = file;
+    ASSERT_EQ( nullptr, parser::ParseCache::fetch( ml.get(), *task ) );
+
+    parser::ExtractedMetadata metadata;
+    metadata.duration = 42000;
+    metadata.metas[libvlc_meta_Title] = "title";
+    metadata.metas[libvlc_meta_TrackNumber] = "3";
+    metadata.tracks.push_back( parser::ExtractedMetadata::Track{
+                VLC::MediaTrack::Type::Audio, "mp4a", 0, 0, 0, 0, 128, 44100, 2, "en", "" } );
+    ASSERT_TRUE( parser::ParseCache::insert( ml.get(), *task, metadata ) );
+    // Replacing an entry replaces its tracks
+    ASSERT_TRUE( parser::ParseCache::insert( ml.get(), *task, metadata ) );
+
+    auto cached = parser::ParseCache::fetch( ml.get(), *task );
+    ASSERT_NE( nullptr, cached );
+    ASSERT_TRUE( cached->fromCache );
+    ASSERT_EQ( 42000, cached->duration );
+    ASSERT_EQ( "title", cached->meta( libvlc_meta_Title ) );
+    ASSERT_EQ( "3", cached->meta( libvlc_meta_TrackNumber ) );
+    ASSERT_EQ( "", cached->meta( libvlc_meta_Album ) );
+    ASSERT_EQ( 1u, cached->tracks.size() );
+    ASSERT_EQ( VLC::MediaTrack::Type::Audio, cached->tracks[0].type );
+    ASSERT_EQ( "mp4a", cached->tracks[0].codec );
+    ASSERT_EQ( 44100u, cached->tracks[0].rate );
+    ASSERT_EQ( 2u, cached->tracks[0].channels );
+    ASSERT_EQ( "en", cached->tracks[0].language );
+
+    // A modified file is parsed again
+    file->setSize( 4321 );
+    ASSERT_EQ( nullptr, parser::ParseCache::fetch( ml.get(), *task ) );
+    file->setSize( 1234 );
+
+    // The cache is deleted along with its task
+    parser::Task::destroy( ml.get(), task->id() );
+    ASSERT_EQ( nullptr, parser::ParseCache::fetch( ml.get(), *task ) );
+}
+
+TEST_F( ParserTests, TransportFiles )
+{
+    parse( "file:///media.mkv" );
+    parse( "file:///stream.acelive" );
+    parse( "file:///content.TORRENT" );
+    analysis->wait( 3 );
+    thumbnailer->wait( 3 );
+
+    // The transport files skip the metadata extraction altogether
+    auto started = extraction->started();
+    ASSERT_EQ( 1u, started.size() );
+    ASSERT_EQ( "file:///media.mkv", started[0] );
+    ASSERT_EQ( 3u, analysis->nbRun() );
+}
+
+TEST_F( ParserTests, RestoreParsedTasks )
+{
+    const std::string req = "INSERT INTO " + policy::TaskTable::Name + "(mrl) VALUES(?)";
+    const auto restoredMrl = mock::FileSystemFactory::Root + "video.avi";
+    const auto parsedMrl = mock::FileSystemFactory::Root + "audio.mp3";
+    const auto discoveredMrl = mock::FileSystemFactory::Root + "not_a_media.something";
+    auto parseTask = [this, &req]( const std::string& mrl ) {
+        auto id = sqlite::Tools::executeInsert( ml->getDbConn(), req, mrl );
+        auto tasks = parser::Task::fetchUncompleted( ml.get(), id - 1, id, 1 );
+        ASSERT_EQ( 1u, tasks.size() );
+        ASSERT_TRUE( tasks[0]->restoreLinkedEntities() );
+        parser->parse( tasks[0] );
+    };
+
+    sqlite::Tools::executeInsert( ml->getDbConn(), req, restoredMrl );
+    parser->pause();
+    // Queued before the restoration starts
+    parseTask( parsedMrl );
+    parser->restore();
+    // Queued while the restoration is pending
+    parseTask( discoveredMrl );
+    parser->resume();
+    thumbnailer->wait( 3 );
+    // Leave a chance to a duplicated task to be run
+    compat::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+
+    for ( auto s : { extraction, analysis, thumbnailer } )
+    {
+        auto started = s->started();
+        ASSERT_EQ( 3u, started.size() );
+        for ( const auto& mrl : { restoredMrl, parsedMrl, discoveredMrl } )
+            ASSERT_EQ( 1, std::count( begin( started ), end( started ), mrl ) );
+    }
+}